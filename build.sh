@@ -4,6 +4,8 @@ PROTOBUF_PATH="${PROJ_ROOT}/3rd/protobuf"
 LLBC_PATH="${PROJ_ROOT}/3rd/llbc"
 PROTO_SRC_PATH="${PROTOBUF_PATH}/src"
 PROTOC_PATH="${PROTO_SRC_PATH}/protoc"
+PLUGIN_PATH="${PROJ_ROOT}/plugin"
+PROTOC_GEN_RPC="${PLUGIN_PATH}/protoc-gen-rpc"
 
 # build protobuf lib function
 build_protobuf() {
@@ -27,14 +29,25 @@ build_llbc() {
     cd -
 }
 
+# build protoc plugin function
+build_plugin() {
+    echo "Building protoc-gen-rpc"
+    g++ -std=c++20 -O2 -I${PROTO_SRC_PATH} ${PLUGIN_PATH}/protoc_gen_rpc.cpp \
+        ${PROTO_SRC_PATH}/.libs/libprotoc.a ${PROTO_SRC_PATH}/.libs/libprotobuf.a \
+        -pthread -o ${PROTOC_GEN_RPC}
+    echo "Building protoc-gen-rpc done"
+}
+
 # build proto
 build_proto() {
+    build_plugin
     echo "Building proto"
     cd $PROTO_PATH 
     if [ ! -d "stub" ]; then
         mkdir stub
     fi
-    ( $PROTOC_PATH  *.proto --cpp_out=./stub )
+    ( $PROTOC_PATH  *.proto --cpp_out=./stub \
+        --plugin=protoc-gen-rpc=${PROTOC_GEN_RPC} --rpc_out=./stub )
     echo "Building proto done"
 }
 
@@ -1,9 +1,11 @@
 #include <memory>
+#include <vector>
 
 #include "echo.pb.h"
-#include "echo_service_stub.h"
+#include "echo.rpc.h"
 #include "rpc_client.h"
 #include "rpc_controller.h"
+#include "rpc_fan_out.h"
 
 class EchoClient : public RpcClient {
    public:
@@ -17,15 +19,12 @@ class EchoClient : public RpcClient {
             co_return;
         }
 
-        auto cntl = std::make_unique<RpcController>(true);
-
-        cntl->SetCoroHandle(co_await GetHandleAwaiter{});
-
-        EchoServiceStub stub(channel);
+        auto cntl = RpcController::New(true);
+        echo::EchoServiceRpcStub stub(channel);
 
         req.set_msg("Hello, Echo.");
         LLOG_INFO("EchoClient rpc echo call: msg:%s", req.msg().c_str());
-        co_await stub.Echo(cntl.get(), &req, &rsp, nullptr);
+        co_await stub.Echo(cntl.get(), &req, &rsp);
         LLOG_INFO("Recv Echo Rsp, status:%s, rsp:%s",
                   cntl->Failed() ? cntl->ErrorText().c_str() : "success",
                   rsp.msg().c_str());
@@ -33,6 +32,32 @@ class EchoClient : public RpcClient {
         co_return;
     }
 
+    // send several echoes at once and resume when all of them are back
+    RpcCoro FanOutCallMethod(int n) {
+        RpcChannel *channel = RegisterRpcChannel("EchoService.Echo");
+        if (!channel) {
+            done_ = true;
+            co_return;
+        }
+
+        echo::EchoServiceRpcStub stub(channel);
+        echo::EchoRequest req;
+        req.set_msg("Hello, Echo.");
+        std::vector<RpcController::Ptr> cntls;
+        std::vector<echo::EchoResponse> rsps(n);
+        std::vector<RpcChannel::CallAwaiter> calls;
+        for (int i = 0; i < n; ++i) {
+            cntls.push_back(RpcController::New(true));
+            calls.push_back(stub.Echo(cntls.back().get(), &req, &rsps[i]));
+        }
+
+        auto succeeded = co_await WhenAll(std::move(calls));
+        LLOG_INFO("Recv %ld/%d Echo Rsps", succeeded, n);
+        done_ = true;
+    }
+
+    bool Done() const { return done_; }
+
     virtual void BlockingCallMethod() override {
         // create rpc req & resp
         echo::EchoRequest req;
@@ -43,8 +68,8 @@ class EchoClient : public RpcClient {
             return;
         }
 
-        auto cntl = std::make_unique<RpcController>(false);
-        EchoServiceStub stub(channel);
+        auto cntl = RpcController::New(false);
+        echo::EchoService_Stub stub(channel);
 
         req.set_msg("Hello, Echo.");
         LLOG_INFO("EchoClient rpc echo call: msg:%s", req.msg().c_str());
@@ -53,6 +78,9 @@ class EchoClient : public RpcClient {
                   cntl->Failed() ? cntl->ErrorText().c_str() : "success",
                   rsp.msg().c_str());
     }
+
+   private:
+    bool done_ = false;
 };
 
 int main() {
@@ -71,6 +99,12 @@ int main() {
         client.Update();
     }
 
+    LLOG_TRACE("FanOutCallMethod Start");
+    client.FanOutCallMethod(8);
+    while (!client.Done()) {
+        client.Update();
+    }
+
     // LLOG_TRACE("BlockingCallMethod Start");
     // client.BlockingCallMethod();
     // LLOG_TRACE("BlockingCallMethod return");
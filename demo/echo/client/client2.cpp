@@ -1,7 +1,7 @@
 #include <memory>
 
 #include "echo.pb.h"
-#include "echo_service_stub.h"
+#include "echo.rpc.h"
 #include "rpc_client.h"
 #include "rpc_controller.h"
 
@@ -17,15 +17,12 @@ class EchoClient : public RpcClient {
             co_return;
         }
 
-        std::unique_ptr<RpcController> cntl = std::make_unique<RpcController>(true);
-
-        cntl->SetCoroHandle(co_await GetHandleAwaiter{});
-
-        EchoServiceStub stub(channel);
+        auto cntl = RpcController::New(true);
+        echo::EchoServiceRpcStub stub(channel);
 
         req.set_msg("Hello, Echo.");
         LLOG_INFO("EchoClient rpc echo call: msg:%s", req.msg().c_str());
-        co_await stub.RelayEcho(cntl.get(), &req, &rsp, nullptr);
+        co_await stub.RelayEcho(cntl.get(), &req, &rsp);
         LLOG_INFO("Recv Echo Rsp, status:%s, rsp:%s",
                   cntl->Failed() ? cntl->ErrorText().c_str() : "success",
                   rsp.msg().c_str());
@@ -43,8 +40,8 @@ class EchoClient : public RpcClient {
             return;
         }
 
-        std::unique_ptr<RpcController> cntl = std::make_unique<RpcController>(false);
-        EchoServiceStub stub(channel);
+        auto cntl = RpcController::New(false);
+        echo::EchoService_Stub stub(channel);
 
         req.set_msg("Hello, Echo.");
         LLOG_INFO("EchoClient rpc echo call: msg:%s", req.msg().c_str());
@@ -4,7 +4,6 @@
 
 #include <memory>
 
-#include "echo_service_stub.h"
 #include "rpc_channel.h"
 #include "rpc_controller.h"
 #include "rpc_coro.h"
@@ -12,8 +11,7 @@
 
 using namespace llbc;
 
-void EchoServiceImpl::Echo(::google::protobuf::RpcController *controller,
-                           const ::echo::EchoRequest *request,
+void EchoServiceImpl::Echo(RpcController *controller, const ::echo::EchoRequest *request,
                            ::echo::EchoResponse *response,
                            ::google::protobuf::Closure *done) {
     // LLBC_Sleep(11000);  // timeout test
@@ -22,9 +20,12 @@ void EchoServiceImpl::Echo(::google::protobuf::RpcController *controller,
     done->Run();
 }
 
-RpcCoro InnerCallEcho(::google::protobuf::RpcController *controller,
-                      const ::echo::EchoRequest *req, ::echo::EchoResponse *rsp,
-                      ::google::protobuf::Closure *done) {
+RpcCoro EchoServiceImpl::RelayEcho(RpcController *controller,
+                                   const ::echo::EchoRequest *req,
+                                   ::echo::EchoResponse *rsp,
+                                   ::google::protobuf::Closure *done) {
+    LLOG_INFO("received, msg:%s", req->msg().c_str());
+
     // init inner rpc req & rsp
     echo::EchoRequest innerReq;
     innerReq.set_msg("Relay Call >>>>>>" + req->msg());
@@ -33,20 +34,20 @@ RpcCoro InnerCallEcho(::google::protobuf::RpcController *controller,
 
     RpcChannel *channel = RpcServiceMgr::GetInst().RegisterRpcChannel("EchoService.Echo");
     if (!channel) {
-        LLOG_ERROR("InnerCallEcho: CreateRpcChannel for ReplayEcho failed.");
+        LLOG_ERROR("RelayEcho: CreateRpcChannel for ReplayEcho failed.");
         controller->SetFailed("CreateRpcChannel for ReplayEcho Fail");
         done->Run();
         co_return;
     }
 
-    EchoServiceStub stub(channel);
-    std::unique_ptr<RpcController> inner_controller =
-        std::make_unique<RpcController>(true);
-    inner_controller->SetCoroHandle(co_await GetHandleAwaiter{});
-    co_await stub.Echo(inner_controller.get(), &innerReq, &innerRsp, nullptr);
+    echo::EchoServiceRpcStub stub(channel);
+    auto inner_controller = RpcController::New(true);
+    // the inner call shares the deadline of the relayed request
+    inner_controller->SetDeadline(controller->GetDeadline());
+    co_await stub.Echo(inner_controller.get(), &innerReq, &innerRsp);
 
     LLOG_INFO(
-        "InnerCallEcho: recv rsp. status:%s, rsp:%s\n",
+        "RelayEcho: recv rsp. status:%s, rsp:%s\n",
         inner_controller->Failed() ? inner_controller->ErrorText().c_str() : "success",
         innerRsp.msg().c_str());
     if (inner_controller->Failed()) {
@@ -56,11 +57,3 @@ RpcCoro InnerCallEcho(::google::protobuf::RpcController *controller,
     done->Run();
     co_return;
 }
-
-void EchoServiceImpl::RelayEcho(::google::protobuf::RpcController *controller,
-                                const ::echo::EchoRequest *req, ::echo::EchoResponse *rsp,
-                                ::google::protobuf::Closure *done) {
-    LLOG_INFO("received, msg:%s", req->msg().c_str());
-
-    InnerCallEcho(controller, req, rsp, done);
-}
\ No newline at end of file
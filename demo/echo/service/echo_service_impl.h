@@ -1,13 +1,12 @@
 #pragma once
 
-#include "echo.pb.h"
+#include "echo.rpc.h"
+#include "rpc_coro.h"
 
-class EchoServiceImpl : public echo::EchoService {
+class EchoServiceImpl : public echo::EchoServiceRpcBase<EchoServiceImpl> {
    public:
-    void Echo(::google::protobuf::RpcController *controller,
-              const ::echo::EchoRequest *request, ::echo::EchoResponse *response,
-              ::google::protobuf::Closure *done) override;
-    void RelayEcho(::google::protobuf::RpcController *controller,
-                   const ::echo::EchoRequest *request, ::echo::EchoResponse *response,
-                   ::google::protobuf::Closure *done) override;
-};
\ No newline at end of file
+    void Echo(RpcController *controller, const ::echo::EchoRequest *request,
+              ::echo::EchoResponse *response, ::google::protobuf::Closure *done);
+    RpcCoro RelayEcho(RpcController *controller, const ::echo::EchoRequest *request,
+                      ::echo::EchoResponse *response, ::google::protobuf::Closure *done);
+};
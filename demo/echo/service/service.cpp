@@ -15,6 +15,8 @@ int main() {
 
     EchoServiceImpl echoService;
     RpcServer::AddService(&echoService);
+    // shed requests once latency shows the server is saturated
+    RpcServer::SetConcurrencyLimiter("", RpcConcurrencyLimiter::Options{});
 
     server->Serve();
     return 0;
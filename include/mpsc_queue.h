@@ -0,0 +1,132 @@
+#ifndef _MPSC_QUEUE_H
+#define _MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free multi-producer single-consumer queue.
+// Producers claim a slot with a CAS on the tail and publish it through the slot's sequence
+// number, so a full queue fails emplace() instead of blocking. The consumer needs no
+// atomic read-modify-write at all. With Capacity == 0 the capacity is chosen at run time
+// by the constructor instead.
+// A published slot's sequence number equals the next lap's claim of a single slot, so
+// the queue needs at least 2 slots; smaller run-time capacities are rounded up to 2.
+template <typename T, size_t Capacity = 0>
+class MPSCQueue : private std::allocator<T> {
+    static_assert(Capacity != 1, "MPSCQueue needs at least 2 slots");
+
+   public:
+    MPSCQueue() requires(Capacity > 0) : capacity_(Capacity) { init(); }
+
+    explicit MPSCQueue(size_t capacity) requires(Capacity == 0)
+        : capacity_(capacity > 2 ? capacity : 2) {
+        init();
+    }
+
+    // non-copyable
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    ~MPSCQueue() {
+        size_t h = head_.load(std::memory_order_relaxed);
+        for (; h != tail_.load(std::memory_order_relaxed); ++h) {
+            std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + h % slots());
+        }
+        std::allocator_traits<std::allocator<T>>::deallocate(*this, data_, slots());
+        delete[] seq_;
+    }
+
+    // may be called from any number of threads at once
+    template <typename... Args>
+    bool emplace(Args &&...args) noexcept(
+        std::is_nothrow_constructible<T, Args &&...>::value) {
+        static_assert(std::is_constructible<T, Args &&...>::value,
+                      "T must be constructible with Args&&...");
+
+        size_t t = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t seq = seq_[t % slots()].load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq - t);
+            if (diff == 0) {
+                // slot is free in this lap, claim it
+                if (tail_.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;  // the consumer hasn't freed it yet: full
+            } else {
+                t = tail_.load(std::memory_order_relaxed);  // another producer won
+            }
+        }
+
+        std::allocator_traits<std::allocator<T>>::construct(*this, data_ + t % slots(),
+                                                            std::forward<Args>(args)...);
+        // (1) synchronizes with (2)
+        seq_[t % slots()].store(t + 1, std::memory_order_release);  // (1)
+        return true;
+    }
+
+    // consumer only
+    bool pop(T &result) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
+
+        size_t h = head_.load(std::memory_order_relaxed);
+        size_t id = h % slots();
+        if (seq_[id].load(std::memory_order_acquire) != h + 1) {  // (2)
+            return false;  // empty, or the producer of this slot hasn't published yet
+        }
+        result = std::move(data_[id]);
+        std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + id);
+        seq_[id].store(h + slots(), std::memory_order_release);  // free for the next lap
+        head_.store(h + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Pop up to n items into `out`, consumer only.
+    // @return number of items popped
+    size_t pop_n(T *out, size_t n) noexcept {
+        size_t i = 0;
+        while (i < n && pop(out[i])) {
+            ++i;
+        }
+        return i;
+    }
+
+    // items claimed by producers and not yet popped, approximate while producers run
+    size_t size() const noexcept {
+        size_t h = head_.load(std::memory_order_acquire);
+        size_t t = tail_.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    // maximum number of items
+    size_t capacity() const noexcept { return slots(); }
+
+   private:
+    void init() {
+        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, slots());
+        seq_ = new std::atomic<size_t>[slots()];
+        for (size_t i = 0; i < slots(); ++i) {
+            seq_[i].store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // a constant when fixed at compile time
+    size_t slots() const noexcept {
+        if constexpr (Capacity > 0) {
+            return Capacity;
+        } else {
+            return capacity_;
+        }
+    }
+
+    size_t capacity_;                  // Capacity, or the one chosen at run time
+    T *data_;                          // queue data
+    std::atomic<size_t> *seq_;         // per slot: lap * slots + index, +1 once published
+    alignas(64) std::atomic<size_t> head_{0};  // only written by the consumer
+    alignas(64) std::atomic<size_t> tail_{0};  // claimed by producers
+};
+
+#endif  // _MPSC_QUEUE_H
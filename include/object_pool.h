@@ -0,0 +1,65 @@
+#ifndef _OBJECT_POOL_H
+#define _OBJECT_POOL_H
+
+#include <memory>
+#include <vector>
+
+// Slab-backed object pool, not thread-safe.
+// Objects are carved out of fixed-size chunks and stay constructed while idle, so
+// anything they own (string capacity, buffers) is reused by the next acquire().
+// Destroying the pool destroys every object it constructed, in use or not.
+template <typename T, size_t ChunkSize = 64>
+class ObjectPool : private std::allocator<T> {
+   public:
+    ObjectPool() = default;
+
+    // non-copyable
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() {
+        for (size_t i = 0; i < chunks_.size(); ++i) {
+            size_t constructed = i + 1 == chunks_.size() ? used_ : ChunkSize;
+            std::destroy(chunks_[i], chunks_[i] + constructed);
+            std::allocator_traits<std::allocator<T>>::deallocate(*this, chunks_[i],
+                                                                 ChunkSize);
+        }
+    }
+
+    // Get an idle object, or construct a new one from args if there is none.
+    // A recycled object is returned as it was released; args are not applied.
+    template <typename... Args>
+    T *acquire(Args &&...args) {
+        if (!free_.empty()) {
+            T *obj = free_.back();
+            free_.pop_back();
+            return obj;
+        }
+        if (chunks_.empty() || used_ == ChunkSize) {
+            chunks_.push_back(
+                std::allocator_traits<std::allocator<T>>::allocate(*this, ChunkSize));
+            used_ = 0;
+        }
+        T *obj = std::construct_at(chunks_.back() + used_, std::forward<Args>(args)...);
+        ++used_;
+        return obj;
+    }
+
+    // Return an object obtained from acquire().
+    void release(T *obj) { free_.push_back(obj); }
+
+    // number of objects constructed so far
+    size_t size() const noexcept {
+        return chunks_.empty() ? 0 : (chunks_.size() - 1) * ChunkSize + used_;
+    }
+
+    // number of idle objects
+    size_t idle() const noexcept { return free_.size(); }
+
+   private:
+    std::vector<T *> chunks_;  // chunks of ChunkSize objects
+    std::vector<T *> free_;    // released objects
+    size_t used_ = 0;          // constructed objects in the last chunk
+};
+
+#endif  // _OBJECT_POOL_H
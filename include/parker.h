@@ -0,0 +1,104 @@
+#ifndef _PARKER_H
+#define _PARKER_H
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Lets one consumer thread sleep until producers signal new work or a timeout expires.
+// unpark() is a fence and a load while the consumer is running; it only makes a syscall
+// (an eventfd write on Linux, a condition variable elsewhere) when the consumer is parked.
+class Parker {
+   public:
+    Parker() noexcept {
+#ifdef __linux__
+        fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    }
+
+    ~Parker() {
+#ifdef __linux__
+        if (fd_ >= 0) close(fd_);
+#endif
+    }
+
+    // non-copyable
+    Parker(const Parker &) = delete;
+    Parker &operator=(const Parker &) = delete;
+
+    // Wake the consumer if it is parked. Call after publishing the work.
+    // On Linux this is async-signal-safe.
+    void unpark() noexcept {
+        // pairs with the fence in park(): either we see parked_ or it sees the work
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed)) signal();
+    }
+
+    // Sleep for at most timeout_ms milliseconds (forever if negative) unless ready().
+    // ready() is checked after the park is announced, so work published before a
+    // concurrent unpark() is never missed.
+    // @return false if the wait timed out
+    template <typename Ready>
+    bool park(Ready &&ready, int64_t timeout_ms) {
+        parked_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool woken = ready() || wait(timeout_ms);
+        parked_.store(false, std::memory_order_relaxed);
+        return woken;
+    }
+
+   private:
+#ifdef __linux__
+    void signal() noexcept {
+        uint64_t one = 1;
+        [[maybe_unused]] auto n = write(fd_, &one, sizeof(one));
+    }
+
+    bool wait(int64_t timeout_ms) noexcept {
+        pollfd pfd{fd_, POLLIN, 0};
+        int timeout = timeout_ms < 0 ? -1
+                      : timeout_ms > INT32_MAX ? INT32_MAX
+                                               : static_cast<int>(timeout_ms);
+        if (poll(&pfd, 1, timeout) <= 0) return false;
+        uint64_t count;
+        [[maybe_unused]] auto n = read(fd_, &count, sizeof(count));  // reset the counter
+        return true;
+    }
+
+    int fd_ = -1;
+#else
+    void signal() noexcept {
+        std::lock_guard<std::mutex> lock(mutex_);
+        signaled_ = true;
+        cond_.notify_one();
+    }
+
+    bool wait(int64_t timeout_ms) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto signaled = [this]() { return signaled_; };
+        if (timeout_ms < 0) {
+            cond_.wait(lock, signaled);
+        } else if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), signaled)) {
+            return false;
+        }
+        signaled_ = false;
+        return true;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool signaled_ = false;
+#endif
+    std::atomic<bool> parked_{false};
+};
+
+#endif  // _PARKER_H
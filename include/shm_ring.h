@@ -0,0 +1,181 @@
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// Single-producer single-consumer ring of variable-sized records in memory the caller
+// provides, e.g. a shared memory segment mapped by two processes. All the state the two
+// ends share lives in that memory; each end attaches a ShmRing of its own to it.
+//
+// A record is its 8-byte length followed by its bytes, padded to RECORD_ALIGN. Records
+// never wrap: one that doesn't fit before the end of the buffer starts over at its
+// beginning and the rest is skipped. The consumer announces when it is about to sleep,
+// so the producer only wakes it (an eventfd write, say) when it has to.
+class ShmRing {
+   public:
+    static constexpr std::size_t RECORD_ALIGN = 16;
+
+    ShmRing() = default;
+
+    // bytes of memory a ring with capacity bytes for records takes
+    static constexpr std::size_t region_size(std::size_t capacity) noexcept {
+        return sizeof(Header) + capacity;
+    }
+
+    // Lay out an empty ring in region_size(capacity) bytes at mem, aligned to 64.
+    // capacity must be a power of two and at least 4 * RECORD_ALIGN.
+    static ShmRing create(void *mem, std::size_t capacity) noexcept {
+        auto *header = new (mem) Header;
+        header->magic = MAGIC;
+        header->capacity = capacity;
+        header->head.store(0, std::memory_order_relaxed);
+        header->tail.store(0, std::memory_order_relaxed);
+        header->waiting.store(0, std::memory_order_release);
+        return ShmRing(header, capacity);
+    }
+
+    // Attach to a ring laid out by create() in the size bytes at mem. The other end may
+    // be another process, so nothing in the memory is trusted.
+    // @return an invalid ring if mem holds none that fits
+    static ShmRing attach(void *mem, std::size_t size) noexcept {
+        if (size < sizeof(Header)) return {};
+        auto *header = std::launder(static_cast<Header *>(mem));
+        std::uint64_t capacity = header->capacity;
+        if (header->magic != MAGIC || capacity < 4 * RECORD_ALIGN ||
+            (capacity & (capacity - 1)) != 0 || capacity > size - sizeof(Header)) {
+            return {};
+        }
+        return ShmRing(header, capacity);
+    }
+
+    bool valid() const noexcept { return header_ != nullptr; }
+    // the producer broke the layout, nothing more can be read
+    bool broken() const noexcept { return broken_; }
+    // largest record that fits
+    std::size_t max_record() const noexcept { return capacity_ / 2 - RECORD_HEAD; }
+
+    // --- producer ---
+
+    // Room for a record of len bytes, to be filled and then published with commit().
+    // @return nullptr if the ring is too full or len > max_record()
+    void *reserve(std::size_t len) noexcept {
+        if (len > max_record()) return nullptr;
+        auto size = padded(len);
+        auto tail = header_->tail.load(std::memory_order_relaxed);
+        auto offset = tail & (capacity_ - 1);
+        auto to_end = capacity_ - offset;
+        auto need = size <= to_end ? size : to_end + size;
+        if (tail + need - cached_ > capacity_) {
+            cached_ = header_->head.load(std::memory_order_acquire);
+            if (tail + need - cached_ > capacity_) return nullptr;
+        }
+        if (size > to_end) {
+            // to_end is a multiple of RECORD_ALIGN, so the marker fits
+            std::memcpy(data_ + offset, &SKIP, RECORD_HEAD);
+            tail += to_end;
+            offset = 0;
+        }
+        std::uint64_t length = len;
+        std::memcpy(data_ + offset, &length, RECORD_HEAD);
+        next_ = tail + size;
+        return data_ + offset + RECORD_HEAD;
+    }
+
+    // Publish the record reserved last.
+    // @return true if the consumer sleeps and must be woken
+    bool commit() noexcept {
+        header_->tail.store(next_, std::memory_order_release);
+        // pairs with the fence in prepare_wait(): either we see waiting or it sees tail
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return header_->waiting.load(std::memory_order_relaxed) != 0 &&
+               header_->waiting.exchange(0, std::memory_order_relaxed) != 0;
+    }
+
+    // --- consumer ---
+
+    // The oldest record and its length, valid until pop().
+    // @return nullptr if the ring is empty or broken()
+    const void *front(std::size_t &len) noexcept {
+        if (broken_) return nullptr;
+        auto head = header_->head.load(std::memory_order_relaxed);
+        for (;;) {
+            if (head == cached_) {
+                cached_ = header_->tail.load(std::memory_order_acquire);
+                if (head == cached_) return nullptr;
+            }
+            auto offset = head & (capacity_ - 1);
+            std::uint64_t length;
+            std::memcpy(&length, data_ + offset, RECORD_HEAD);
+            if (length == SKIP) {
+                head += capacity_ - offset;
+                header_->head.store(head, std::memory_order_release);
+                continue;
+            }
+            if (cached_ - head > capacity_ || length > max_record() ||
+                padded(length) > capacity_ - offset || head + padded(length) > cached_) {
+                broken_ = true;
+                return nullptr;
+            }
+            len = static_cast<std::size_t>(length);
+            next_ = head + padded(length);
+            return data_ + offset + RECORD_HEAD;
+        }
+    }
+
+    // drop the record returned by front()
+    void pop() noexcept { header_->head.store(next_, std::memory_order_release); }
+
+    bool empty() const noexcept {
+        return header_->head.load(std::memory_order_relaxed) ==
+               header_->tail.load(std::memory_order_acquire);
+    }
+
+    // Announce the consumer is about to sleep, the next commit() asks for a wake-up.
+    // @return false if records arrived meanwhile, don't sleep then
+    bool prepare_wait() noexcept {
+        header_->waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return empty();
+    }
+
+    // the consumer runs again, wake-ups are not needed
+    void finish_wait() noexcept { header_->waiting.store(0, std::memory_order_relaxed); }
+
+   private:
+    static constexpr std::uint64_t MAGIC = 0x31474e49524d4853ULL;  // "SHMRING1"
+    static constexpr std::uint64_t SKIP = ~std::uint64_t(0);  // rest of the buffer unused
+    static constexpr std::size_t RECORD_HEAD = sizeof(std::uint64_t);
+
+    struct Header {
+        std::uint64_t magic;
+        std::uint64_t capacity;
+        alignas(64) std::atomic<std::uint64_t> head;     // consumer position, in bytes
+        alignas(64) std::atomic<std::uint64_t> tail;     // producer position, in bytes
+        alignas(64) std::atomic<std::uint32_t> waiting;  // consumer is about to sleep
+    };
+    // shared by processes, so no lock may hide in them
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+    ShmRing(Header *header, std::size_t capacity) noexcept
+        : header_(header),
+          data_(reinterpret_cast<std::byte *>(header + 1)),
+          capacity_(capacity) {}
+
+    static constexpr std::uint64_t padded(std::uint64_t len) noexcept {
+        return (RECORD_HEAD + len + RECORD_ALIGN - 1) & ~std::uint64_t(RECORD_ALIGN - 1);
+    }
+
+    Header *header_ = nullptr;
+    std::byte *data_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::uint64_t next_ = 0;    // position after the reserved or front() record
+    std::uint64_t cached_ = 0;  // producer: head seen last, consumer: tail seen last
+    bool broken_ = false;
+};
+
+#endif  // _SHM_RING_H
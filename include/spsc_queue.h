@@ -4,12 +4,19 @@
 #include <atomic>
 #include <memory>
 
-// Simple lock-free single-producer single-consumer queue
-template <typename T, size_t Capacity>
+// Simple lock-free single-producer single-consumer queue.
+// It holds up to Capacity - 1 items. With Capacity == 0 the number of items is chosen at
+// run time by the constructor instead.
+template <typename T, size_t Capacity = 0>
 class SPSCQueue : private std::allocator<T> {
    public:
-    SPSCQueue() {
-        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, Capacity);
+    SPSCQueue() requires(Capacity > 0) : capacity_(Capacity) {
+        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, capacity_);
+    }
+
+    explicit SPSCQueue(size_t capacity) requires(Capacity == 0)
+        : capacity_(capacity + 1) {
+        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, capacity_);
     }
 
     // non-copyable
@@ -18,10 +25,10 @@ class SPSCQueue : private std::allocator<T> {
 
     ~SPSCQueue() {
         for (size_t i = head_.load(std::memory_order_acquire);
-             i != tail_.load(std::memory_order_acquire); i = (i + 1) % Capacity) {
+             i != tail_.load(std::memory_order_acquire); i = (i + 1) % slots()) {
             std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + i);
         }
-        std::allocator_traits<std::allocator<T>>::deallocate(*this, data_, Capacity);
+        std::allocator_traits<std::allocator<T>>::deallocate(*this, data_, slots());
     }
 
     template <typename... Args>
@@ -31,14 +38,14 @@ class SPSCQueue : private std::allocator<T> {
                       "T must be constructible with Args&&...");
 
         size_t t = tail_.load(std::memory_order_relaxed);
-        if ((t + 1) % Capacity == head_.load(std::memory_order_acquire)) {  // (1)
+        if ((t + 1) % slots() == head_.load(std::memory_order_acquire)) {  // (1)
             return false;
         }
 
         std::allocator_traits<std::allocator<T>>::construct(*this, data_ + t,
                                                             std::forward<Args>(args)...);
         // (2) synchronizes with (3)
-        tail_.store((t + 1) % Capacity, std::memory_order_release);  // (2)
+        tail_.store((t + 1) % slots(), std::memory_order_release);  // (2)
         return true;
     }
 
@@ -52,26 +59,71 @@ class SPSCQueue : private std::allocator<T> {
         }
         result = std::move(data_[h]);
         std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + h);
-        head_.store((h + 1) % Capacity, std::memory_order_release);  // (4)
+        head_.store((h + 1) % slots(), std::memory_order_release);  // (4)
         return true;
     }
 
-    size_t size() const noexcept {
-        size_t diff =
-            tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
-        if (diff < 0) {
-            diff += Capacity;
+    // Move up to n items from `items` into the queue with a single publish.
+    // @return number of items pushed, the first ones of `items`
+    size_t push_n(T *items, size_t n) noexcept(
+        std::is_nothrow_move_constructible<T>::value) {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        size_t h = head_.load(std::memory_order_acquire);
+        size_t free = (h + slots() - t - 1) % slots();
+        if (n > free) n = free;
+        for (size_t i = 0; i < n; ++i) {
+            std::allocator_traits<std::allocator<T>>::construct(
+                *this, data_ + (t + i) % slots(), std::move(items[i]));
+        }
+        if (n > 0) tail_.store((t + n) % slots(), std::memory_order_release);
+        return n;
+    }
+
+    // Pop up to n items into `out` with a single publish.
+    // @return number of items popped
+    size_t pop_n(T *out, size_t n) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
+
+        size_t h = head_.load(std::memory_order_relaxed);
+        size_t t = tail_.load(std::memory_order_acquire);
+        size_t used = (t + slots() - h) % slots();
+        if (n > used) n = used;
+        for (size_t i = 0; i < n; ++i) {
+            size_t idx = (h + i) % slots();
+            out[i] = std::move(data_[idx]);
+            std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + idx);
         }
-        return diff;
+        if (n > 0) head_.store((h + n) % slots(), std::memory_order_release);
+        return n;
+    }
+
+    size_t size() const noexcept {
+        size_t h = head_.load(std::memory_order_acquire);
+        size_t t = tail_.load(std::memory_order_acquire);
+        return (t + slots() - h) % slots();
     }
 
+    // maximum number of items
+    size_t capacity() const noexcept { return slots() - 1; }
+
     bool empty() const noexcept {
         return head_.load(std::memory_order_acquire) ==
                tail_.load(std::memory_order_acquire);
     }
 
    private:
-    T *data_;  // queue data
+    // number of slots, one is always left empty; a constant when fixed at compile time
+    size_t slots() const noexcept {
+        if constexpr (Capacity > 0) {
+            return Capacity;
+        } else {
+            return capacity_;
+        }
+    }
+
+    size_t capacity_;  // number of slots, Capacity or the one chosen at run time
+    T *data_;          // queue data
     std::atomic<size_t> head_{0};
     std::atomic<size_t> tail_{0};
 };
@@ -0,0 +1,178 @@
+#ifndef _TIMING_WHEEL_H
+#define _TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Link of an intrusive timer. Embed it (usually as a base) in the object to time.
+struct TimerNode {
+    TimerNode *prev = nullptr;
+    TimerNode *next = nullptr;
+    int64_t expire = 0;
+
+    bool linked() const noexcept { return next != nullptr; }
+};
+
+/**
+ * Intrusive hierarchical timing wheel, not thread-safe.
+ * The root wheel has 256 one-tick slots; each of the 4 upper wheels has 64 slots covering
+ * a full turn of the wheel below, so timers up to 2^32 ticks ahead are exact and longer
+ * ones are clamped. add() and cancel() are O(1), advance() is O(1) per elapsed tick plus
+ * the timers it expires or cascades. The wheel never allocates; nodes are owned by the
+ * caller and must stay alive while linked.
+ */
+class TimingWheel {
+   public:
+    static constexpr int ROOT_BITS = 8;
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr int LEVELS = 4;
+    static constexpr size_t ROOT_SIZE = size_t(1) << ROOT_BITS;
+    static constexpr size_t LEVEL_SIZE = size_t(1) << LEVEL_BITS;
+    static constexpr int64_t MAX_SPAN = int64_t(1) << (ROOT_BITS + LEVEL_BITS * LEVELS);
+
+    explicit TimingWheel(int64_t now = 0) noexcept : current_(now) {
+        for (auto &slot : root_) init(slot);
+        for (auto &level : levels_) {
+            for (auto &slot : level) init(slot);
+        }
+    }
+
+    // non-copyable: slots are list heads that nodes point to
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    // Schedule node to expire at tick `expire`. A linked node is rescheduled.
+    void add(TimerNode *node, int64_t expire) noexcept {
+        if (node->linked()) cancel(node);
+        if (expire < current_) expire = current_;
+        if (expire - current_ >= MAX_SPAN) expire = current_ + MAX_SPAN - 1;
+        node->expire = expire;
+        place(node);
+        ++size_;
+    }
+
+    // Unschedule node. Does nothing if it is not linked.
+    void cancel(TimerNode *node) noexcept {
+        if (!node->linked()) return;
+        unlink(node);
+        --size_;
+    }
+
+    // Expire every timer due at or before `now`, calling on_expire(TimerNode *) for each.
+    // Expired nodes are unlinked before the callback, which may add or cancel timers.
+    template <typename F>
+    void advance(int64_t now, F &&on_expire) {
+        while (current_ <= now) {
+            if (size_ == 0) {
+                current_ = now + 1;
+                return;
+            }
+            auto idx = static_cast<size_t>(current_) & (ROOT_SIZE - 1);
+            if (idx == 0) cascade();
+
+            // detach the due slot first, so timers added by callbacks land elsewhere
+            TimerNode due;
+            init(due);
+            splice(root_[idx], due);
+            ++current_;
+            while (due.next != &due) {
+                TimerNode *node = due.next;
+                unlink(node);
+                --size_;
+                on_expire(node);
+            }
+        }
+    }
+
+    // Earliest tick at which advance() may expire a timer, INT64_MAX if there is none.
+    // Exact for timers in the root wheel; timers in upper wheels are bounded by the next
+    // cascade, so this is never later than the real next expiry.
+    int64_t next_expire() const noexcept {
+        if (size_ == 0) return INT64_MAX;
+        // the next tick that cascades the upper wheels
+        int64_t next = current_;
+        if ((current_ & (ROOT_SIZE - 1)) != 0) next = (current_ | (ROOT_SIZE - 1)) + 1;
+        // a root slot holds the timers of the single tick in [current_, next) mapping to
+        // it, anything else expires at or after `next`
+        for (int64_t tick = current_; tick < next; ++tick) {
+            const auto &slot = root_[static_cast<size_t>(tick) & (ROOT_SIZE - 1)];
+            if (slot.next != &slot) return tick;
+        }
+        return next;
+    }
+
+    // number of linked timers
+    size_t size() const noexcept { return size_; }
+
+    bool empty() const noexcept { return size_ == 0; }
+
+    // next tick advance() will process
+    int64_t current() const noexcept { return current_; }
+
+   private:
+    static void init(TimerNode &head) noexcept { head.prev = head.next = &head; }
+
+    static void link(TimerNode &head, TimerNode *node) noexcept {
+        node->prev = head.prev;
+        node->next = &head;
+        head.prev->next = node;
+        head.prev = node;
+    }
+
+    static void unlink(TimerNode *node) noexcept {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+    }
+
+    // move all nodes of `from` to the empty list `to`
+    static void splice(TimerNode &from, TimerNode &to) noexcept {
+        if (from.next == &from) return;
+        to.next = from.next;
+        to.prev = from.prev;
+        to.next->prev = &to;
+        to.prev->next = &to;
+        init(from);
+    }
+
+    void place(TimerNode *node) noexcept {
+        int64_t delta = node->expire - current_;
+        if (delta < static_cast<int64_t>(ROOT_SIZE)) {
+            link(root_[static_cast<size_t>(node->expire) & (ROOT_SIZE - 1)], node);
+            return;
+        }
+        for (int i = 0; i < LEVELS; ++i) {
+            int shift = ROOT_BITS + LEVEL_BITS * i;
+            if (delta < (int64_t(1) << (shift + LEVEL_BITS)) || i == LEVELS - 1) {
+                link(levels_[i][static_cast<size_t>(node->expire >> shift) &
+                                (LEVEL_SIZE - 1)],
+                     node);
+                return;
+            }
+        }
+    }
+
+    // refill lower wheels from the upper slot that the current tick has reached
+    void cascade() noexcept {
+        for (int i = 0; i < LEVELS; ++i) {
+            auto idx = static_cast<size_t>(current_ >> (ROOT_BITS + LEVEL_BITS * i)) &
+                       (LEVEL_SIZE - 1);
+            TimerNode moved;
+            init(moved);
+            splice(levels_[i][idx], moved);
+            while (moved.next != &moved) {
+                TimerNode *node = moved.next;
+                unlink(node);
+                place(node);
+            }
+            if (idx != 0) break;
+        }
+    }
+
+    TimerNode root_[ROOT_SIZE];
+    TimerNode levels_[LEVELS][LEVEL_SIZE];
+    int64_t current_ = 0;  // next tick to process
+    size_t size_ = 0;      // linked timers
+};
+
+#endif  // _TIMING_WHEEL_H
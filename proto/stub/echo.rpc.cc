@@ -0,0 +1,41 @@
+// Generated by protoc-gen-rpc. DO NOT EDIT!
+// source: echo.proto
+
+#include "echo.rpc.h"
+
+#include <google/protobuf/descriptor.h>
+
+#include "rpc_stats.h"
+
+namespace echo {
+
+const ::google::protobuf::ServiceDescriptor *EchoService_RpcDescriptor() {
+    static const auto *descriptor =
+        ::google::protobuf::DescriptorPool::generated_pool()->FindServiceByName(
+            "echo.EchoService");
+    return descriptor;
+}
+
+RpcChannel::CallAwaiter EchoServiceRpcStub::Echo(RpcController *controller,
+    const ::echo::EchoRequest *request,
+    ::echo::EchoResponse *response) const noexcept {
+    static constexpr std::uint32_t method_id =
+        RpcChannel::MethodID("echo.EchoService.Echo");
+    // names the method in the client stats, once
+    [[maybe_unused]] static const auto *stats =
+        RpcStats::GetInst().Get(RpcStats::Client, method_id, "echo.EchoService.Echo");
+    return channel_->Call(method_id, controller, request, response);
+}
+
+RpcChannel::CallAwaiter EchoServiceRpcStub::RelayEcho(RpcController *controller,
+    const ::echo::EchoRequest *request,
+    ::echo::EchoResponse *response) const noexcept {
+    static constexpr std::uint32_t method_id =
+        RpcChannel::MethodID("echo.EchoService.RelayEcho");
+    // names the method in the client stats, once
+    [[maybe_unused]] static const auto *stats =
+        RpcStats::GetInst().Get(RpcStats::Client, method_id, "echo.EchoService.RelayEcho");
+    return channel_->Call(method_id, controller, request, response);
+}
+
+}  // namespace echo
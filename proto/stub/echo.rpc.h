@@ -0,0 +1,87 @@
+// Generated by protoc-gen-rpc. DO NOT EDIT!
+// source: echo.proto
+
+#ifndef _ECHO_RPC_H_
+#define _ECHO_RPC_H_
+
+#include <span>
+
+#include "echo.pb.h"
+#include "rpc_channel.h"
+#include "rpc_service.h"
+
+namespace echo {
+
+const ::google::protobuf::ServiceDescriptor *EchoService_RpcDescriptor();
+
+// Coroutine client stub of echo.EchoService.
+// co_await stub.Method(cntl, &req, &rsp) yields LLBC_OK, or LLBC_FAILED with the
+// reason in cntl->ErrorText().
+class EchoServiceRpcStub {
+   public:
+    explicit EchoServiceRpcStub(RpcChannel *channel) noexcept : channel_(channel) {}
+
+    RpcChannel::CallAwaiter Echo(RpcController *controller,
+        const ::echo::EchoRequest *request,
+        ::echo::EchoResponse *response) const noexcept;
+    RpcChannel::CallAwaiter RelayEcho(RpcController *controller,
+        const ::echo::EchoRequest *request,
+        ::echo::EchoResponse *response) const noexcept;
+
+   private:
+    RpcChannel *channel_;
+};
+
+// Server skeleton of echo.EchoService. Implement it as
+//
+//   class Impl : public EchoServiceRpcBase<Impl> {
+//      public:
+//       R Echo(RpcController *controller, const ::echo::EchoRequest *request,
+//           ::echo::EchoResponse *response, ::google::protobuf::Closure *done);
+//       R RelayEcho(RpcController *controller, const ::echo::EchoRequest *request,
+//           ::echo::EchoResponse *response, ::google::protobuf::Closure *done);
+//   };
+//
+// where R is void or RpcCoro, and register it with RpcServer::AddService(&impl).
+// Every method must run `done` once the response is filled in.
+template <typename Impl>
+class EchoServiceRpcBase : public RpcService {
+   public:
+    const ::google::protobuf::ServiceDescriptor *GetDescriptor() const noexcept override {
+        return EchoService_RpcDescriptor();
+    }
+
+    std::span<const RpcService::Method> GetMethods() const noexcept override {
+        static const RpcService::Method methods[] = {
+            {EchoService_RpcDescriptor()->method(0),
+             &::echo::EchoRequest::default_instance(),
+             &::echo::EchoResponse::default_instance(), &InvokeEcho},
+            {EchoService_RpcDescriptor()->method(1),
+             &::echo::EchoRequest::default_instance(),
+             &::echo::EchoResponse::default_instance(), &InvokeRelayEcho},
+        };
+        return methods;
+    }
+
+   private:
+    static void InvokeEcho(RpcService *service, RpcController *controller,
+        const ::google::protobuf::Message *request,
+        ::google::protobuf::Message *response,
+        ::google::protobuf::Closure *done) {
+        static_cast<Impl *>(service)->Echo(controller,
+            static_cast<const ::echo::EchoRequest *>(request),
+            static_cast<::echo::EchoResponse *>(response), done);
+    }
+    static void InvokeRelayEcho(RpcService *service, RpcController *controller,
+        const ::google::protobuf::Message *request,
+        ::google::protobuf::Message *response,
+        ::google::protobuf::Closure *done) {
+        static_cast<Impl *>(service)->RelayEcho(controller,
+            static_cast<const ::echo::EchoRequest *>(request),
+            static_cast<::echo::EchoResponse *>(response), done);
+    }
+};
+
+}  // namespace echo
+
+#endif  // _ECHO_RPC_H_
@@ -1,56 +1,265 @@
 #include "rpc_channel.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "rpc_conn_mgr.h"
 #include "rpc_controller.h"
 #include "rpc_coro.h"
 #include "rpc_coro_mgr.h"
+#include "rpc_endpoint.h"
 #include "rpc_macros.h"
+#include "rpc_stats.h"
+#include "rpc_sync_call_mgr.h"
+
+RpcChannel::RpcChannel(RpcConnMgr *conn_mgr, int session_ID, const std::string &ip,
+                       int port, std::size_t max_sessions, bool shm)
+    : conn_mgr_(conn_mgr),
+      ip_(ip),
+      port_(port),
+      sessions_(new Session[std::max<std::size_t>(max_sessions, 1)]),
+      slot_num_(1),
+      session_num_(1),
+      max_sessions_(ip.empty() || shm ? 1 : std::max<std::size_t>(max_sessions, 1)),
+      shm_(shm && !ip.empty()) {
+    sessions_[0].id = session_ID;
+}
+
+RpcChannel::~RpcChannel() {
+    if (connecting_ != 0) conn_mgr_->AbandonConnect(connecting_);
+    for (std::size_t i = 0; i < slot_num_; ++i) {
+        if (sessions_[i].id != 0) conn_mgr_->CloseSession(sessions_[i].id);
+    }
+}
+
+std::uint32_t RpcChannel::InFlight() const noexcept {
+    std::uint32_t inflight = 0;
+    for (std::size_t i = 0; i < slot_num_.load(std::memory_order_acquire); ++i) {
+        inflight += sessions_[i].inflight.load(std::memory_order_relaxed);
+    }
+    return inflight;
+}
 
-RpcChannel::~RpcChannel() { conn_mgr_->CloseSession(session_ID_); }
+RpcChannel::Session &RpcChannel::PickSession() noexcept {
+    // shared memory links are dialed again by Redial() instead
+    if (!shm_ &&
+        conn_mgr_->ClosedSessions() != closed_seen_.load(std::memory_order_relaxed)) {
+        PruneSessions();
+    }
+    auto slots = slot_num_.load(std::memory_order_acquire);
+    Session *best = nullptr;
+    std::uint32_t least = 0;
+    for (std::size_t i = 0; i < slots && (!best || least > 0); ++i) {
+        if (sessions_[i].id.load(std::memory_order_relaxed) == 0) continue;
+        auto inflight = sessions_[i].inflight.load(std::memory_order_relaxed);
+        if (!best || inflight < least) {
+            best = &sessions_[i];
+            least = inflight;
+        }
+    }
+    if ((!best || least > 0) && SessionCount() < max_sessions_) {
+        if (auto *session = AddSession()) {
+            return *session;
+        }
+    }
+    return best ? *best : sessions_[0];
+}
+
+RpcChannel::Session *RpcChannel::AddSession() noexcept {
+    // another call is at it, this one goes to an open session
+    std::unique_lock<std::mutex> lock(grow_mutex_, std::try_to_lock);
+    COND_RET(!lock.owns_lock(), nullptr);
+    auto num = session_num_.load(std::memory_order_relaxed);
+    COND_RET(num >= max_sessions_ || ip_.empty(), nullptr);
+
+    auto now = llbc::LLBC_GetMilliSeconds();
+    auto backoff = [&]() -> Session * {
+        grow_at_ = now + grow_backoff_ms_;
+        grow_backoff_ms_ = std::min(grow_backoff_ms_ * 2, MAX_GROW_BACKOFF_MS);
+        return nullptr;
+    };
+    if (connecting_ == 0) {
+        COND_RET(now < grow_at_, nullptr);
+        connecting_ = conn_mgr_->AsyncConnect(ip_.c_str(), port_);
+        COND_RET(connecting_ == 0, backoff());
+        return nullptr;
+    }
+
+    auto state = conn_mgr_->TakeConnResult(connecting_);
+    COND_RET(state == RpcConnComp::ConnState::Connecting, nullptr);
+    auto sessionID = std::exchange(connecting_, 0);
+    COND_RET_WLOG(state == RpcConnComp::ConnState::Failed, backoff(),
+                  "AddSession: connect failed, retrying in %lld ms|%s:%d|sessions: %lu",
+                  grow_backoff_ms_, ip_.c_str(), port_, num);
+
+    grow_backoff_ms_ = MIN_GROW_BACKOFF_MS;
+    // a slot freed by PruneSessions(), or a new one
+    auto slots = slot_num_.load(std::memory_order_relaxed);
+    std::size_t slot = 0;
+    while (slot < slots && sessions_[slot].id.load(std::memory_order_relaxed) != 0) {
+        ++slot;
+    }
+    sessions_[slot].id.store(sessionID, std::memory_order_release);
+    if (slot == slots) slot_num_.store(slots + 1, std::memory_order_release);
+    session_num_.store(num + 1, std::memory_order_release);
+    LLOG_TRACE("AddSession: session %d added|%s:%d|sessions: %lu", sessionID,
+               ip_.c_str(), port_, num + 1);
+    return &sessions_[slot];
+}
+
+void RpcChannel::PruneSessions() noexcept {
+    // another call is growing or pruning, a later one prunes
+    std::unique_lock<std::mutex> lock(grow_mutex_, std::try_to_lock);
+    COND_RET(!lock.owns_lock());
+    // read first: sessions closed after this are pruned next time
+    auto closed = conn_mgr_->ClosedSessions();
+    auto num = session_num_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < slot_num_.load(std::memory_order_relaxed); ++i) {
+        auto sessionID = sessions_[i].id.load(std::memory_order_relaxed);
+        if (sessionID == 0 || conn_mgr_->IsSessionOpen(sessionID)) continue;
+        sessions_[i].id.store(0, std::memory_order_release);
+        --num;
+        LLOG_INFO("PruneSessions: session %d closed|%s:%d|sessions: %lu", sessionID,
+                  ip_.c_str(), port_, num);
+    }
+    session_num_.store(num, std::memory_order_release);
+    closed_seen_.store(closed, std::memory_order_relaxed);
+}
+
+int RpcChannel::Send(Session &session, llbc::LLBC_Packet *packet) noexcept {
+    int ret = conn_mgr_->SendPacket(packet);
+    COND_RET(ret != LLBC_FAILED || !shm_, ret);
+
+    auto sessionID = Redial(session, packet->GetSessionId());
+    COND_RET(sessionID == 0, LLBC_FAILED);
+    packet->SetSessionId(sessionID);
+    return conn_mgr_->SendPacket(packet);
+}
+
+int RpcChannel::Redial(Session &session, int closed_id) noexcept {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    auto sessionID = session.id.load(std::memory_order_relaxed);
+    // another call has dialed already
+    COND_RET(sessionID != closed_id, sessionID);
+    // a tcp session, or the send failed for another reason than a closed link
+    COND_RET(!RpcShmTransport::IsShmSession(sessionID) ||
+                 conn_mgr_->IsShmLinkOpen(sessionID),
+             0);
+
+    auto unix_socket = RpcEndpoint::IsUnix(ip_);
+    sessionID = unix_socket ? conn_mgr_->Connect(ip_.c_str(), port_)
+                            : conn_mgr_->ConnectShm(ip_.c_str(), port_);
+    if (sessionID == 0 && !unix_socket) {
+        sessionID = conn_mgr_->Connect(ip_.c_str(), port_);
+    }
+    COND_RET_WLOG(sessionID == 0, 0, "Redial: link closed, dialing again failed|%s:%d",
+                  ip_.c_str(), port_);
+
+    session.id.store(sessionID, std::memory_order_release);
+    LLOG_INFO("Redial: link %d closed, now session %d|%s:%d", closed_id, sessionID,
+              ip_.c_str(), port_);
+    return sessionID;
+}
+
+int RpcChannel::CallAwaiter::await_resume() const noexcept {
+    return controller_->Failed() ? LLBC_FAILED : LLBC_OK;
+}
 
 int RpcChannel::PkgHead::FromPacket(llbc::LLBC_Packet &packet) noexcept {
-    int ret = packet.Read(seq);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "read pkg_head.seq failed|ret: %d", ret);
-    ret = packet.Read(service_name);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "read pkg_head.service_name failed|ret: %d", ret);
-    ret = packet.Read(method_name);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "read pkg_head.method_name failed|ret: %d", ret);
-
-    LLOG_TRACE("read net packet done|%s|session_id: %d", ToString().c_str(),
-               packet.GetSessionId());
+    COND_RET_ELOG(packet.GetPayloadLength() < SIZE, LLBC_FAILED,
+                  "read pkg_head failed, packet too short|len: %lu",
+                  packet.GetPayloadLength());
+    packet.Read(magic);
+    packet.Read(version);
+    packet.Read(flags);
+    packet.Read(method_id);
+    packet.Read(seq);
+    packet.Read(timeout);
+    int ret = packet.Read(body_len);
+    COND_RET_ELOG(ret != LLBC_OK, ret, "read pkg_head failed|ret: %d", ret);
+    COND_RET_ELOG(magic != MAGIC || version != VERSION, LLBC_FAILED,
+                  "read pkg_head failed, bad magic or version|magic: %#x|version: %u",
+                  magic, version);
+
+    LAZY_TLOG("read net packet done|%s|session_id: %d", ToString().c_str(),
+              packet.GetSessionId());
     return 0;
 }
 
+int RpcChannel::PkgHead::PeekSeq(const llbc::LLBC_Packet &packet,
+                                  std::uint64_t &seq) noexcept {
+    COND_RET(packet.GetPayloadLength() < SIZE, LLBC_FAILED);
+    // LLBC_Packet writes integers in network byte order
+    const auto *bytes =
+        static_cast<const std::uint8_t *>(packet.GetPayload()) + SEQ_OFFSET;
+    seq = 0;
+    for (std::size_t i = 0; i < sizeof(seq); ++i) {
+        seq = (seq << 8) | bytes[i];
+    }
+    return LLBC_OK;
+}
+
 int RpcChannel::PkgHead::ToPacket(llbc::LLBC_Packet &packet) const noexcept {
-    int ret = packet.Write(seq);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "write pkg_head.seq failed|ret: %d", ret);
-    ret = packet.Write(service_name);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "write pkg_head.service_name failed|ret: %d", ret);
-    ret = packet.Write(method_name);
-    COND_RET_ELOG(ret != LLBC_OK, ret, "write pkg_head.method_name failed|ret: %d", ret);
-
-    LLOG_TRACE("write net packet done|%s|sessond_id: %d", ToString().c_str(),
-               packet.GetSessionId());
+    packet.Write(magic);
+    packet.Write(version);
+    packet.Write(flags);
+    packet.Write(method_id);
+    packet.Write(seq);
+    packet.Write(timeout);
+    int ret = packet.Write(body_len);
+    COND_RET_ELOG(ret != LLBC_OK, ret, "write pkg_head failed|ret: %d", ret);
+
+    LAZY_TLOG("write net packet done|%s|sessond_id: %d", ToString().c_str(),
+              packet.GetSessionId());
     return 0;
 }
 
-const std::string &RpcChannel::PkgHead::ToString() const noexcept {
-    static std::string buffer;
-    std::string().swap(buffer);
-    ::snprintf(buffer.data(), MAX_BUFFER_SIZE,
-               "seq: %lu|service_name: %s|method_name: %s", seq, service_name.c_str(),
-               method_name.c_str());
+std::string RpcChannel::PkgHead::ToString() const noexcept {
+    char buffer[MAX_BUFFER_SIZE];
+    ::snprintf(buffer, sizeof(buffer),
+               "seq: %lu|method_id: %u|flags: %u|timeout: %u|body_len: %u", seq,
+               method_id, flags, timeout, body_len);
     return buffer;
 }
 
+int RpcChannel::WriteMessage(llbc::LLBC_Packet &packet, PkgHead &pkg_head,
+                             const ::google::protobuf::Message &msg) noexcept {
+    // caches the size for SerializeWithCachedSizesToArray below
+    pkg_head.body_len = static_cast<std::uint32_t>(msg.ByteSizeLong());
+    int ret = pkg_head.ToPacket(packet);
+    COND_RET(ret != LLBC_OK, ret);
+
+    // grow the payload at most once, then serialize in place
+    auto *payload = packet.GetMutablePayload();
+    if (payload->GetWritableSize() < pkg_head.body_len) {
+        payload->Resize(payload->GetWritePos() + pkg_head.body_len);
+    }
+    auto *begin = static_cast<std::uint8_t *>(payload->GetDataStartWithWritePos());
+    auto *end = msg.SerializeWithCachedSizesToArray(begin);
+    return payload->ShiftWritePos(static_cast<long>(end - begin));
+}
+
+int RpcChannel::ReadMessage(llbc::LLBC_Packet &packet, const PkgHead &pkg_head,
+                            ::google::protobuf::Message &msg) noexcept {
+    auto *payload = packet.GetMutablePayload();
+    COND_RET_ELOG(!payload || payload->GetReadableSize() < pkg_head.body_len,
+                  LLBC_FAILED, "read message failed, body truncated|body_len: %u",
+                  pkg_head.body_len);
+    COND_RET_ELOG(!msg.ParseFromArray(payload->GetDataStartWithReadPos(),
+                                      static_cast<int>(pkg_head.body_len)),
+                  LLBC_FAILED, "read message failed, parse error|body_len: %u",
+                  pkg_head.body_len);
+    return payload->ShiftReadPos(static_cast<long>(pkg_head.body_len));
+}
+
 void RpcChannel::CallMethod(
     const ::google::protobuf::MethodDescriptor *method,
     ::google::protobuf::RpcController *controller,
     const ::google::protobuf::Message *request,
     ::google::protobuf::Message *response,  // handled by coroutine context
     ::google::protobuf::Closure *) {
-    LLOG_TRACE("CallMethod|service: %s|method: %s", method->service()->name().c_str(),
-               method->name().c_str());
+    LAZY_TLOG("CallMethod|service: %s|method: %s", method->service()->name().c_str(),
+              method->name().c_str());
 
     auto rpcController = static_cast<RpcController *>(controller);
     COND_RET_ELOG(rpcController == nullptr, ,
@@ -61,105 +270,209 @@ void RpcChannel::CallMethod(
         return;
     }
 
-    auto seq = RpcCoroMgr::NewCoroUid();
+    auto handle = std::coroutine_handle<>::from_address(rpcController->GetCoroHandle());
+    COND_RET_ELOG(!handle, rpcController->SetFailed("no coro handle"),
+                  "CallMethod: coro controller without a coro handle");
 
-    // store coroutine context
-    RpcCoroMgr::GetInst().AddCoroContext({
-        .coro_uid = seq,
-        .timeout_time = llbc::LLBC_GetMilliSeconds() + RpcCoroMgr::CORO_TIME_OUT,
-        .handle = std::coroutine_handle<RpcCoro::promise_type>::from_address(
-            rpcController->GetCoroHandle()),
+    // name the method in the client stats, SendRequest() only knows its id
+    RpcStats::GetInst().Get(RpcStats::Client, MethodID(method), method->full_name());
+    // the caller suspends once this returns, nothing else would resume it
+    if (SendRequest(MethodID(method), rpcController, request, response, handle) !=
+        LLBC_OK) {
+        RpcCoroMgr::GetInst().ResumeLater(handle);
+    }
+}
+
+int RpcChannel::SendRequest(std::uint32_t method_id, RpcController *controller,
+                            const ::google::protobuf::Message *request,
+                            ::google::protobuf::Message *response,
+                            std::coroutine_handle<> handle, std::uint64_t *seq) noexcept {
+    auto now = llbc::LLBC_GetMilliSeconds();
+    auto timeout = controller->CallTimeout(now, RpcCoroMgr::CORO_TIME_OUT);
+    COND_RET_ELOG(timeout <= 0, (controller->SetFailed("deadline exceeded"), LLBC_FAILED),
+                  "SendRequest: deadline exceeded before sending");
+
+    // store coroutine context, its slot in the in-flight table becomes the seq. The
+    // session's in-flight count drops when the context is removed, however the call ends.
+    auto &session = PickSession();
+    session.inflight.fetch_add(1, std::memory_order_relaxed);
+    auto *stats = RpcStats::GetInst().Get(RpcStats::Client, method_id);
+    stats->Begin();
+    auto coro_uid = RpcCoroMgr::GetInst().AddCoroContext({
+        .timeout_time = now + timeout,
+        .handle = handle,
         .rsp = response,
-        .controller = rpcController,
+        .controller = controller,
+        .inflight = {sessions_, &session.inflight},
+        .stats = stats,
+        .start_us = llbc::LLBC_GetMicroSeconds(),
     });
+    COND_RET_ELOG(coro_uid == 0UL,
+                  (session.inflight.fetch_sub(1, std::memory_order_relaxed),
+                   stats->End(-1, true), controller->SetFailed("too many pending calls"),
+                   LLBC_FAILED),
+                  "SendRequest: add coro context failed");
+
+    // the coro won't be resumed by a response, take its context back; no reason means the
+    // send backlog was full
+    auto fail = [&](const char *reason) {
+        RpcCoroMgr::GetInst().PopCoroContext(coro_uid);
+        stats->End(-1, true);
+        if (reason) {
+            controller->SetFailed(reason);
+        } else {
+            controller->SetOverloaded("send backlog full");
+        }
+        return LLBC_FAILED;
+    };
 
     llbc::LLBC_Packet *sendPacket =
         llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
-    COND_RET_ELOG(sendPacket == nullptr, , "CallMethod: acquire LLBC_Packet failed");
+    COND_RET_ELOG(sendPacket == nullptr, fail("acquire LLBC_Packet failed"),
+                  "SendRequest: acquire LLBC_Packet failed");
 
-    sendPacket->SetHeader(session_ID_, RpcOpCode::RpcReq, LLBC_OK);
+    sendPacket->SetHeader(session.id, RpcOpCode::RpcReq, LLBC_OK);
 
     // set pkg_head
     RpcChannel::PkgHead pkgHead;
-    pkgHead.service_name = method->service()->name();
-    pkgHead.method_name = method->name();
-    pkgHead.seq = seq;
+    pkgHead.method_id = method_id;
+    pkgHead.seq = coro_uid;
+    pkgHead.timeout = static_cast<std::uint32_t>(timeout);
 
-    int ret = pkgHead.ToPacket(*sendPacket);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
-                  "CallMethod: pkg_head.ToPacket failed|ret: %d", ret);
+    int ret = WriteMessage(*sendPacket, pkgHead, *request);
+    COND_RET_ELOG(ret != LLBC_OK,
+                  (LLBC_Recycle(sendPacket), fail("write message failed")),
+                  "SendRequest: write message failed|ret: %d", ret);
 
-    ret = sendPacket->Write(*request);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
-                  "CallMethod: packet.Write message failed|ret: %d", ret);
-
-    LLOG_DEBUG("CallMethod: send data|message: %s|packet: %s",
-               request->ShortDebugString().c_str(), sendPacket->ToString().c_str());
+    LAZY_DLOG("SendRequest: send data|message: %s|packet: %s",
+              request->ShortDebugString().c_str(), sendPacket->ToString().c_str());
     // send packet via conn_mgr
-    ret = RpcConnMgr::GetInst().SendPacket(sendPacket);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
-                  "CallMethod: sendPacket failed, ret: %s", llbc::LLBC_FormatLastError());
-    LLOG_TRACE("Packet sent. Waiting!");
+    ret = Send(session, sendPacket);
+    COND_RET_WLOG(ret == RpcOverloaded,
+                  (LLBC_Recycle(sendPacket), fail(nullptr)),
+                  "SendRequest: send backlog full, call failed|method_id: %u", method_id);
+    COND_RET_ELOG(ret != LLBC_OK, (LLBC_Recycle(sendPacket), fail("send packet failed")),
+                  "SendRequest: sendPacket failed, ret: %s",
+                  llbc::LLBC_FormatLastError());
+    LAZY_TLOG("Packet sent. Waiting!");
+    if (seq) *seq = coro_uid;
+    return LLBC_OK;
 }
 
 void RpcChannel::BlockingCallMethod(const ::google::protobuf::MethodDescriptor *method,
                                     RpcController *controller,
                                     const ::google::protobuf::Message *request,
                                     ::google::protobuf::Message *response) {
+    auto timeout = controller->CallTimeout(llbc::LLBC_GetMilliSeconds(),
+                                           RpcConnMgr::RECEIVE_TIME_OUT);
+    COND_RET_ELOG(timeout <= 0, controller->SetFailed("deadline exceeded"),
+                  "BlockingCallMethod: deadline exceeded before sending");
+
+    // the response is handed to this slot by the service thread, see RpcSyncCallMgr
+    auto &syncCallMgr = RpcSyncCallMgr::GetInst();
+    auto seq = syncCallMgr.Acquire();
+    COND_RET_ELOG(seq == 0UL, controller->SetFailed("too many pending calls"),
+                  "BlockingCallMethod: acquire completion slot failed");
+
+    // the call is in flight on its session until this returns
+    auto &session = PickSession();
+    session.inflight.fetch_add(1, std::memory_order_relaxed);
+    struct InflightGuard {
+        std::atomic<std::uint32_t> &inflight;
+        ~InflightGuard() { inflight.fetch_sub(1, std::memory_order_relaxed); }
+    } inflightGuard{session.inflight};
+
+    // and in the client stats, failed unless the response is read
+    struct StatsGuard {
+        RpcMethodStats *stats;
+        RpcController *controller;
+        llbc::sint64 start_us = llbc::LLBC_GetMicroSeconds();
+        ~StatsGuard() {
+            stats->End(llbc::LLBC_GetMicroSeconds() - start_us, controller->Failed());
+        }
+    } statsGuard{RpcStats::GetInst().Get(RpcStats::Client, MethodID(method),
+                                         method->full_name()),
+                 controller};
+    statsGuard.stats->Begin();
+
+    // no reason means the send backlog was full
+    auto fail = [&](const char *reason) {
+        syncCallMgr.Release(seq);
+        if (reason) {
+            controller->SetFailed(reason);
+        } else {
+            controller->SetOverloaded("send backlog full");
+        }
+    };
+
     llbc::LLBC_Packet *sendPacket =
         llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
-    COND_RET_ELOG(sendPacket == nullptr,
-                  controller->SetFailed("acquire LLBC_Packet failed"),
+    COND_RET_ELOG(sendPacket == nullptr, fail("acquire LLBC_Packet failed"),
                   "BlockingCallMethod: acquire LLBC_Packet failed");
 
-    sendPacket->SetHeader(session_ID_, RpcOpCode::RpcReq, LLBC_OK);
+    sendPacket->SetHeader(session.id, RpcOpCode::RpcReq, LLBC_OK);
 
     // set pkg_head
     RpcChannel::PkgHead pkgHead;
-    pkgHead.service_name = method->service()->name();
-    pkgHead.method_name = method->name();
-    pkgHead.seq = 0;
-
-    int ret = pkgHead.ToPacket(*sendPacket);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
-                  "BlockingCallMethod: pkg_head.ToPacket failed|ret: %d", ret);
-
-    ret = sendPacket->Write(*request);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
-                  "BlockingCallMethod: packet.Write message failed|ret: %d", ret);
-
-    LLOG_DEBUG("BlockingCallMethod: send data|message: %s",
-               request->ShortDebugString().c_str());
-    LLOG_DEBUG("BlockingCallMethod: send data|packet: %s",
-               sendPacket->ToString().c_str());
+    pkgHead.method_id = MethodID(method);
+    pkgHead.seq = seq;
+    pkgHead.timeout = static_cast<std::uint32_t>(timeout);
+
+    int ret = WriteMessage(*sendPacket, pkgHead, *request);
+    COND_RET_ELOG(ret != LLBC_OK,
+                  (LLBC_Recycle(sendPacket), fail("write message failed")),
+                  "BlockingCallMethod: write message failed|ret: %d", ret);
+
+    LAZY_DLOG("BlockingCallMethod: send data|message: %s",
+              request->ShortDebugString().c_str());
+    LAZY_DLOG("BlockingCallMethod: send data|packet: %s",
+              sendPacket->ToString().c_str());
     // send packet via conn_mgr
-    ret = RpcConnMgr::GetInst().SendPacket(sendPacket);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(sendPacket),
+    ret = Send(session, sendPacket);
+    COND_RET_WLOG(ret == RpcOverloaded,
+                  (LLBC_Recycle(sendPacket), fail(nullptr)),
+                  "BlockingCallMethod: send backlog full, call failed|method: %s",
+                  method->full_name().c_str());
+    COND_RET_ELOG(ret != LLBC_OK, (LLBC_Recycle(sendPacket), fail("send packet failed")),
                   "BlockingCallMethod: sendPacket failed, ret: %s",
                   llbc::LLBC_FormatLastError());
 
-    LLOG_TRACE("BlockingCallMethod: Packet sent. Waiting!");
+    LAZY_TLOG("BlockingCallMethod: Packet sent. Waiting!");
 
-    llbc::LLBC_Packet *recvPacket = nullptr;
-    if (conn_mgr_->BlockingRecvPacket(recvPacket) == LLBC_FAILED) {
-        LLOG_ERROR("BlockingCallMethod: receive packet timeout!");
-        controller->SetFailed("receive packet timeout");
-        return;
+    // No reactor loop may be running on this thread to flush a send backlog, so flush
+    // it here until the request is out.
+    auto deadline = llbc::LLBC_GetMilliSeconds() + timeout;
+    while (conn_mgr_->FlushSendBacklog() > 0 && llbc::LLBC_GetMilliSeconds() < deadline) {
+        llbc::LLBC_Sleep(1);
     }
 
-    LLOG_TRACE("BlockingCallMethod: payload info|length:%lu|info: %s",
-               recvPacket->GetPayloadLength(), recvPacket->ToString().c_str());
+    auto left = std::max<llbc::sint64>(deadline - llbc::LLBC_GetMilliSeconds(), 0);
+    auto *recvPacket = syncCallMgr.Wait(seq, left);
+    COND_RET_ELOG(recvPacket == nullptr, controller->SetFailed("receive packet timeout"),
+                  "BlockingCallMethod: receive packet timeout|seq: %lu", seq);
 
-    PkgHead pkg_head;
-    ret = pkg_head.FromPacket(*recvPacket);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(recvPacket);
-                  , "BlockingCallMethod: parse net packet failed|ret:%d", ret);
-    ret = recvPacket->Read(*response);
-    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(recvPacket);
-                  , "BlockingCallMethod: read recv_packet failed|ret:%d", ret);
+    LAZY_TLOG("BlockingCallMethod: payload info|length:%lu|info: %s",
+              recvPacket->GetPayloadLength(), recvPacket->ToString().c_str());
 
-    LLOG_TRACE("BlockingCallMethod: recved: %s|extdata:%lu",
-               response->ShortDebugString().c_str(), pkg_head.seq);
+    if (recvPacket->GetStatus() != LLBC_OK) {
+        if (recvPacket->GetStatus() == RpcOverloaded) {
+            controller->SetOverloaded();
+        } else {
+            controller->SetFailed("rpc failed");
+        }
+        LLBC_Recycle(recvPacket);
+        return;
+    }
 
+    PkgHead pkg_head;
+    ret = pkg_head.FromPacket(*recvPacket);
+    if (ret == LLBC_OK) {
+        ret = ReadMessage(*recvPacket, pkg_head, *response);
+    }
     LLBC_Recycle(recvPacket);
+    COND_RET_ELOG(ret != LLBC_OK, controller->SetFailed("read message failed"),
+                  "BlockingCallMethod: read recv_packet failed|ret:%d", ret);
+
+    LAZY_TLOG("BlockingCallMethod: recved: %s|extdata:%lu",
+              response->ShortDebugString().c_str(), pkg_head.seq);
 }
\ No newline at end of file
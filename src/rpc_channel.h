@@ -1,12 +1,20 @@
 #ifndef _RPC_CHANNEL_H
 #define _RPC_CHANNEL_H
 
+#include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/service.h>
 #include <google/protobuf/stubs/common.h>
 #include <llbc.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
 class RpcConnMgr;
 class RpcController;
 
@@ -17,33 +25,153 @@ class RpcChannel : public ::google::protobuf::RpcChannel {
         RpcRsp = 2,
     };
 
+    // status of a response packet besides LLBC_OK and LLBC_FAILED
+    enum RpcStatus {
+        // shed by the server's concurrency limiter without being handled, a retry on
+        // another backend is safe, see RpcController::Overloaded()
+        RpcOverloaded = 2,
+    };
+
     // LLBC_Packet:
     //
-    //   0                         32                        64
-    //   +-------------------------+-------------------------+
-    //   |                        seq                        |
-    //   +---------------------------------------------------+
-    //   |                    service_name                   |
-    //   +---------------------------------------------------+
-    //   |                    method_name                    |
-    //   +---------------------------------------------------+
-    //   |                    body(message)                  |
-    //   +---------------------------------------------------+
+    //   0               16      24      32                              64
+    //   +---------------+-------+-------+-------------------------------+
+    //   |     magic     |version| flags |           method_id           |
+    //   +---------------+-------+-------+-------------------------------+
+    //   |                              seq                              |
+    //   +-------------------------------+-------------------------------+
+    //   |            timeout            |           body_len            |
+    //   +-------------------------------+-------------------------------+
+    //   |                         body(message)                         |
+    //   +---------------------------------------------------------------+
     //
     struct PkgHead {
-        std::uint64_t seq = 0UL;  // coro_uid
-        std::string service_name;
-        std::string method_name;
+        std::uint16_t magic = MAGIC;
+        std::uint8_t version = VERSION;
+        std::uint8_t flags = 0;
+        std::uint32_t method_id = 0;  // MethodID(method->full_name())
+        std::uint64_t seq = 0UL;      // coro_uid
+        std::uint32_t timeout = 0;    // caller's remaining budget in ms, 0 for none
+        std::uint32_t body_len = 0;   // serialized size of the message
 
         int FromPacket(llbc::LLBC_Packet &packet) noexcept;
         int ToPacket(llbc::LLBC_Packet &packet) const noexcept;
-        const std::string &ToString() const noexcept;
+        std::string ToString() const noexcept;
+
+        // read seq of the head at the packet's read position, without consuming it
+        static int PeekSeq(const llbc::LLBC_Packet &packet, std::uint64_t &seq) noexcept;
+
+        static constexpr std::uint16_t MAGIC = 0x5250;  // "RP"
+        static constexpr std::uint8_t VERSION = 2;
+        static constexpr std::size_t SIZE = 24;      // encoded size in bytes
+        static constexpr std::size_t SEQ_OFFSET = 8;  // offset of seq in bytes
     };
 
-    RpcChannel(RpcConnMgr *conn_mgr, int session_ID)
-        : conn_mgr_(conn_mgr), session_ID_(session_ID) {}
+    // 32-bit FNV-1a of the method's full name, e.g. "echo.EchoService.Echo".
+    // Both ends derive the same id, so requests never carry the names on the wire.
+    static constexpr std::uint32_t MethodID(std::string_view full_name) noexcept {
+        std::uint32_t hash = 2166136261U;
+        for (char c : full_name) {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 16777619U;
+        }
+        return hash;
+    }
+    static std::uint32_t MethodID(const ::google::protobuf::MethodDescriptor *method) {
+        return MethodID(method->full_name());
+    }
+
+    // Write pkg_head followed by msg. msg is sized once with ByteSizeLong() and
+    // serialized straight into the packet payload, without an intermediate stream.
+    static int WriteMessage(llbc::LLBC_Packet &packet, PkgHead &pkg_head,
+                            const ::google::protobuf::Message &msg) noexcept;
+    // Parse the body described by pkg_head in place from the packet payload.
+    static int ReadMessage(llbc::LLBC_Packet &packet, const PkgHead &pkg_head,
+                           ::google::protobuf::Message &msg) noexcept;
+
+    /**
+     * Awaiter of a coroutine call, returned by Call().
+     * await_suspend registers the suspended coro and sends the request in one step; if
+     * sending fails the coro is not suspended at all. co_await yields LLBC_OK, or
+     * LLBC_FAILED with the reason in controller->ErrorText(); a call that found the send
+     * backlog full fails with controller->Overloaded() set.
+     */
+    class CallAwaiter {
+       public:
+        CallAwaiter(RpcChannel *channel, std::uint32_t method_id,
+                    RpcController *controller,
+                    const ::google::protobuf::Message *request,
+                    ::google::protobuf::Message *response) noexcept
+            : channel_(channel),
+              method_id_(method_id),
+              controller_(controller),
+              request_(request),
+              response_(response) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) noexcept {
+            return channel_->SendRequest(method_id_, controller_, request_, response_,
+                                         handle, &seq_) == LLBC_OK;
+        }
+        int await_resume() const noexcept;
+
+        RpcController *controller() const noexcept { return controller_; }
+        // coro_uid of the call while it is suspended, see RpcCoroMgr
+        std::uint64_t seq() const noexcept { return seq_; }
+
+       private:
+        RpcChannel *channel_;
+        std::uint32_t method_id_;
+        RpcController *controller_;
+        const ::google::protobuf::Message *request_;
+        ::google::protobuf::Message *response_;
+        std::uint64_t seq_ = 0;
+    };
+
+    /**
+     * A channel to one endpoint, backed by a pool of sessions to it. session_ID is the
+     * first session; up to max_sessions - 1 more are connected to ip:port on demand,
+     * whenever every open session has a call in flight. They connect in the background,
+     * calls keep going to the open sessions meanwhile, and failed connects are retried
+     * with backoff. Each call goes to the session with the fewest calls in flight, so a
+     * slow call doesn't hold up the others and the sessions spread over the llbc
+     * pollers. A session that closes leaves the pool, and the pool grows back on demand.
+     * Without ip the pool stays at one session, and is empty once that one closes.
+     * With shm, session_ID is a shared memory link to ip:port, or to the unix socket of
+     * ip "unix:/path". One link carries any number of calls, so the pool stays at it;
+     * if the link closes, e.g. as the server restarts, the next call dials it again,
+     * falling back to tcp unless ip is a unix socket.
+     */
+    RpcChannel(RpcConnMgr *conn_mgr, int session_ID, const std::string &ip = "",
+               int port = 0, std::size_t max_sessions = 1, bool shm = false);
     virtual ~RpcChannel();
 
+    /**
+     * Call a method from a coroutine:
+     *
+     *  auto cntl = RpcController::New(true);
+     *  if (co_await channel->Call(md, cntl.get(), &req, &rsp) != LLBC_OK) {
+     *      handle cntl->ErrorText()
+     *  }
+     */
+    CallAwaiter Call(const ::google::protobuf::MethodDescriptor *method,
+                     RpcController *controller,
+                     const ::google::protobuf::Message *request,
+                     ::google::protobuf::Message *response) noexcept {
+        return CallAwaiter(this, MethodID(method), controller, request, response);
+    }
+
+    // Same as above with a precomputed MethodID(), as generated stubs do.
+    CallAwaiter Call(std::uint32_t method_id, RpcController *controller,
+                     const ::google::protobuf::Message *request,
+                     ::google::protobuf::Message *response) noexcept {
+        return CallAwaiter(this, method_id, controller, request, response);
+    }
+
+    // Generic-service entry point. Coroutine controllers must carry the coro handle
+    // (SetCoroHandle) and the caller suspends afterwards; prefer Call(). A call that
+    // fails before it is sent, e.g. with no session to send it over, resumes the caller
+    // from the next RpcCoroMgr::HandleCoroTimeout(), with the controller failed.
     virtual void CallMethod(const ::google::protobuf::MethodDescriptor *method,
                             ::google::protobuf::RpcController *controller,
                             const ::google::protobuf::Message *request,
@@ -58,11 +186,66 @@ class RpcChannel : public ::google::protobuf::RpcChannel {
                             const ::google::protobuf::Message *request,
                             ::google::protobuf::Message *response);
 
+    // number of open sessions
+    std::size_t SessionCount() const noexcept {
+        return session_num_.load(std::memory_order_acquire);
+    }
+    // calls in flight over all sessions
+    std::uint32_t InFlight() const noexcept;
+
     static constexpr std::size_t MAX_BUFFER_SIZE = 1024UL;
+    static constexpr std::size_t MAX_SESSIONS = 4;  // default pool size, one per poller
+    // delay before connecting again after a failed connect, doubled per failure
+    static constexpr llbc::sint64 MIN_GROW_BACKOFF_MS = 100;
+    static constexpr llbc::sint64 MAX_GROW_BACKOFF_MS = 30000;
 
    private:
+    struct Session {
+        std::atomic<int> id{0};                  // llbc session id
+        std::atomic<std::uint32_t> inflight{0};  // calls sent and not yet finished
+    };
+
+    // Open session with the fewest calls in flight, growing the pool if all are busy.
+    // sessions_[0] with id 0 if none is open.
+    Session &PickSession() noexcept;
+    // Grow the pool without blocking: start connecting a session, and add it once a
+    // later call finds it connected.
+    // @return the added session, or nullptr if none is ready
+    Session *AddSession() noexcept;
+    // Free the slots of the tcp sessions closed since the last call. A slot keeps its
+    // in-flight count, the calls sent over the closed session still end one by one.
+    void PruneSessions() noexcept;
+    // Send the packet over the session, dialing a closed shared memory link again first.
+    // @return see RpcConnMgr::SendPacket()
+    int Send(Session &session, llbc::LLBC_Packet *packet) noexcept;
+    // replace the session's link closed_id, 0 if that failed
+    int Redial(Session &session, int closed_id) noexcept;
+
+    // Register handle as waiting for the response and send the request.
+    // On failure nothing is left registered and the controller is marked failed.
+    // The seq the response will carry is stored to `seq` if given.
+    int SendRequest(std::uint32_t method_id, RpcController *controller,
+                    const ::google::protobuf::Message *request,
+                    ::google::protobuf::Message *response,
+                    std::coroutine_handle<> handle,
+                    std::uint64_t *seq = nullptr) noexcept;
+
     RpcConnMgr *conn_mgr_ = nullptr;
-    int session_ID_ = 0;
+    std::string ip_;
+    int port_ = 0;
+    // Slots of the pool, id 0 for a free one. Shared with the calls in flight, whose
+    // contexts decrement the in-flight count however long they outlive the channel.
+    std::shared_ptr<Session[]> sessions_;
+    std::atomic<std::size_t> slot_num_{0};     // sessions_[0, slot_num_) were ever used
+    std::atomic<std::size_t> session_num_{0};  // open sessions among them
+    std::atomic<std::uint64_t> closed_seen_{0};  // RpcConnMgr::ClosedSessions() pruned
+    std::size_t max_sessions_ = 1;               // the pool never grows beyond this
+    // serializes AddSession(), PruneSessions() and Redial(), guards the 3 below
+    std::mutex grow_mutex_;
+    int connecting_ = 0;  // session being connected to join the pool, 0 for none
+    llbc::sint64 grow_at_ = 0;  // no connect is started before, in milliseconds
+    llbc::sint64 grow_backoff_ms_ = MIN_GROW_BACKOFF_MS;
+    bool shm_ = false;  // sessions_[0] is a shared memory link
 };
 
 #endif  // _RPC_CHANNEL_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <llbc.h>
 
+#include <algorithm>
 #include <csignal>
 
 #include "rpc_conn_mgr.h"
@@ -57,7 +58,7 @@ int RpcClient::InitLLBC() {
 int RpcClient::InitRpcLib() {
     // init rpc connection manager
     RpcConnMgr *connMgr = &RpcConnMgr::GetInst();
-    if (connMgr->Init() != LLBC_OK) {
+    if (connMgr->Init(reactor_num_, queue_config_) != LLBC_OK) {
         LLOG_ERROR("Init: connMgr Init Fail");
         Destroy();
         return LLBC_FAILED;
@@ -65,7 +66,7 @@ int RpcClient::InitRpcLib() {
 
     // init rpc service manager
     RpcServiceMgr *serviceMgr = &RpcServiceMgr::GetInst();
-    if (serviceMgr->Init(connMgr) != LLBC_OK) {
+    if (serviceMgr->Init(connMgr, max_sessions_) != LLBC_OK) {
         LLOG_ERROR("Init: serviceMgr Init Fail");
         Destroy();
         return LLBC_FAILED;
@@ -87,16 +88,38 @@ void RpcClient::Destroy() noexcept {
     std::cout << "RpcClient destroyed.\n";
 }
 
-RpcChannel *RpcClient::RegisterRpcChannel(const std::string &svc_md) {
+RpcChannel *RpcClient::RegisterRpcChannel(const std::string &svc_md,
+                                          std::uint64_t hash_key) {
     if (!initialized_) {
         std::cout << "RpcClient not initialized.\n";
         return nullptr;
     }
-    return RpcServiceMgr::GetInst().RegisterRpcChannel(svc_md);
+    return RpcServiceMgr::GetInst().RegisterRpcChannel(svc_md, hash_key);
 }
 
-void RpcClient::Update() {
-    RpcCoroMgr::GetInst().HandleCoroTimeout();
-    RpcConnMgr::GetInst().Tick();
-    llbc::LLBC_Sleep(1);
+int RpcClient::SetLoadBalancer(const std::string &svc_md,
+                               RpcLoadBalancer::Factory factory) {
+    if (!initialized_) {
+        std::cout << "SetLoadBalancer: RpcClient not initialized.\n";
+        return LLBC_FAILED;
+    }
+    RpcServiceMgr::GetInst().SetLoadBalancer(svc_md, std::move(factory));
+    return LLBC_OK;
+}
+
+void RpcClient::Update(llbc::sint64 max_wait_ms) {
+    auto &coroMgr = RpcCoroMgr::GetInst();
+    auto &connMgr = RpcConnMgr::GetInst();
+    coroMgr.HandleCoroTimeout();
+    if (connMgr.Tick() > 0) {
+        return;
+    }
+
+    // idle, wait for packets but wake up for the next coro timeout
+    auto wait = max_wait_ms;
+    if (auto next = coroMgr.NextTimeout(); next >= 0) {
+        auto left = next - llbc::LLBC_GetMilliSeconds();
+        wait = std::min(wait, std::max<llbc::sint64>(left, 0));
+    }
+    connMgr.WaitRecvPacket(wait);
 }
\ No newline at end of file
@@ -5,7 +5,9 @@
 #include <singleton.h>
 
 #include "rpc_channel.h"
+#include "rpc_conn_comp.h"
 #include "rpc_coro.h"
+#include "rpc_load_balancer.h"
 
 /**
  * To use this class, you must first call Init() to initialize the client. \\
@@ -22,33 +24,49 @@ class RpcClient {
     void Destroy() noexcept;
 
     int SetLogConfPath(const char *log_conf_path);
-    RpcChannel *RegisterRpcChannel(const std::string &);
+    // queue capacities and watermarks, call before Init() to override the defaults
+    void SetQueueConfig(const RpcConnComp::QueueConfig &config) noexcept {
+        queue_config_ = config;
+    }
+    // sessions a channel may open to its endpoint, call before Init() to override
+    void SetMaxSessions(std::size_t max_sessions) noexcept {
+        max_sessions_ = max_sessions;
+    }
+    // hash_key: see RpcServiceMgr::RegisterRpcChannel()
+    RpcChannel *RegisterRpcChannel(const std::string &, std::uint64_t hash_key = 0);
+    // Load balancer of a method, "" for the default, e.g.
+    //  SetLoadBalancer("EchoService.Echo", [] {
+    //      return RpcLoadBalancer::New(RpcLoadBalancer::Policy::P2C);
+    //  });
+    int SetLoadBalancer(const std::string &svc_md, RpcLoadBalancer::Factory factory);
 
-    void Update();
+    // Run one round of the reactor loop: expire coros, handle received packets and,
+    // if there were none, wait up to max_wait_ms for more. The wait ends early on a
+    // new packet or at the next coro timeout.
+    void Update(llbc::sint64 max_wait_ms = 1);
 
     /**
      * Call a method using coroutines.
      * You should rewrite this method to call the remote method. Example:
      *
-     *  RpcController *cntl = new RpcController(true);
-     *  cntl->SetCoroHandle(co_await GetHandleAwaiter{});
-     *  EchoServiceStub stub(RegisterRpcChannel(...));
-     *  co_await stub.xxx(cntl, &req, &rsp, nullptr);
-     *  handle rsp
-     *  delete cntl;
+     *  auto cntl = RpcController::New(true);
+     *  echo::EchoServiceRpcStub stub(RegisterRpcChannel(...));  // from protoc-gen-rpc
+     *  if (co_await stub.xxx(cntl.get(), &req, &rsp) == LLBC_OK)
+     *      handle rsp
      */
     virtual RpcCoro CallMethod() { co_return; }
 
     /**
      * Blocking version of CallMethod.
-     * a should either call CallMethod() or BlockingCallMethod(), not both.
+     * Any number of threads may make blocking calls at once, over the same channel too;
+     * each waits for its own response. A blocking call on a thread running Update()
+     * stalls that reactor's coroutines until it returns.
      * you should rewrite this method to call the remote method. Example:
      *
-     * RpcController *cntl = new RpcController(false);
-     * EchoServiceStub stub(RegisterRpcChannel(...));
-     * stub.xxx(cntl, &req, &rsp, nullptr);
+     * auto cntl = RpcController::New(false);
+     * echo::EchoService_Stub stub(RegisterRpcChannel(...));
+     * stub.xxx(cntl.get(), &req, &rsp, nullptr);
      * handle rsp
-     * delete cntl;
      */
     virtual void BlockingCallMethod() {}
 
@@ -58,6 +76,9 @@ class RpcClient {
     int InitRpcLib();
 
     bool initialized_ = false;
+    std::size_t reactor_num_ = 1;  // reactors exchanging packets with the conn mgr
+    RpcConnComp::QueueConfig queue_config_;
+    std::size_t max_sessions_ = RpcChannel::MAX_SESSIONS;  // per channel
 };
 
 #endif  // _RPC_CLIENT_H
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "rpc_concurrency_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "rpc_macros.h"
+
+RpcConcurrencyLimiter::RpcConcurrencyLimiter(const Options &options) noexcept
+    : options_(options),
+      limit_(options.adaptive
+                 ? std::clamp(options.initial_limit, options.min_limit, options.max_limit)
+                 : options.max_limit),
+      estimated_limit_(limit_.load(std::memory_order_relaxed)) {}
+
+bool RpcConcurrencyLimiter::TryAcquire() noexcept {
+    auto inflight = inflight_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (inflight > limit_.load(std::memory_order_relaxed)) {
+        inflight_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto peak = max_inflight_.load(std::memory_order_relaxed);
+    while (inflight > peak && !max_inflight_.compare_exchange_weak(
+                                  peak, inflight, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void RpcConcurrencyLimiter::Release(llbc::sint64 latency_us) noexcept {
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+    COND_RET(!options_.adaptive || latency_us < 0, );
+
+    sample_sum_us_.fetch_add(latency_us, std::memory_order_relaxed);
+    auto samples = sample_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    COND_RET(samples < options_.window_samples, );
+    auto now = llbc::LLBC_GetMicroSeconds();
+    COND_RET(now < window_end_.load(std::memory_order_relaxed), );
+
+    // whoever gets here first closes the window, the others go on
+    std::unique_lock<std::mutex> lock(update_mutex_, std::try_to_lock);
+    COND_RET(!lock.owns_lock() || now < window_end_.load(std::memory_order_relaxed), );
+    Update(now);
+}
+
+void RpcConcurrencyLimiter::Update(llbc::sint64 now) noexcept {
+    window_end_.store(now + options_.window_us, std::memory_order_relaxed);
+    auto count = sample_count_.exchange(0, std::memory_order_relaxed);
+    auto sum = sample_sum_us_.exchange(0, std::memory_order_relaxed);
+    auto peak = max_inflight_.exchange(inflight_.load(std::memory_order_relaxed),
+                                       std::memory_order_relaxed);
+    // a sample counted in between may land in the next window, it evens out
+    COND_RET(count == 0 || sum <= 0, );
+
+    double rtt = static_cast<double>(sum) / count;
+    bool probe = ++windows_ % PROBE_WINDOWS == 0;
+    if (no_load_rtt_us_ == 0 || rtt < no_load_rtt_us_ || probe) {
+        no_load_rtt_us_ = rtt;
+    }
+
+    // Too few requests to reach the limit, their latency says nothing about it. Growing
+    // anyway would leave a limit far above what the server can take when load comes.
+    COND_RET(peak < estimated_limit_ / 2, );
+
+    auto gradient = std::clamp(options_.tolerance * no_load_rtt_us_ / rtt, 0.5, 1.0);
+    auto limit = estimated_limit_ * gradient + std::sqrt(estimated_limit_);
+    limit = estimated_limit_ * (1 - options_.smoothing) + limit * options_.smoothing;
+    estimated_limit_ = std::clamp(limit, static_cast<double>(options_.min_limit),
+                                  static_cast<double>(options_.max_limit));
+
+    auto old = limit_.exchange(static_cast<std::uint32_t>(estimated_limit_),
+                               std::memory_order_relaxed);
+    LLOG_TRACE("RpcConcurrencyLimiter: limit %u -> %u|rtt: %.0fus, no-load rtt: %.0fus",
+               old, limit_.load(std::memory_order_relaxed), rtt, no_load_rtt_us_);
+}
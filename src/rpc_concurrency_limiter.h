@@ -0,0 +1,88 @@
+#ifndef _RPC_CONCURRENCY_LIMITER_H_
+#define _RPC_CONCURRENCY_LIMITER_H_
+
+#include <llbc.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * Bounds the requests a server handles at once, see
+ * RpcServiceMgr::SetConcurrencyLimiter(). A request over the limit is shed right away
+ * with RpcChannel::RpcOverloaded, so its caller can retry elsewhere instead of queueing
+ * until it times out.
+ *
+ * The adaptive limit follows the latency of the requests, from their receipt to their
+ * response so that time spent queued counts, like TCP Vegas does with a congestion
+ * window: once per window the window's average latency is compared with the no-load
+ * latency, the lowest one seen lately. While it stays within `tolerance` the limit grows
+ * by about its square root. When requests slow down because they queue up, the limit
+ * shrinks in proportion, by at most half per window. Thread-safe, shared by all
+ * reactors.
+ */
+class RpcConcurrencyLimiter {
+   public:
+    // min_limit <= initial_limit <= max_limit
+    struct Options {
+        bool adaptive = true;  // false keeps the limit at max_limit
+        std::uint32_t initial_limit = 20;
+        std::uint32_t min_limit = 4;
+        std::uint32_t max_limit = 1000;
+        double tolerance = 1.5;             // latency over the no-load latency accepted
+        double smoothing = 0.2;             // weight of a window's estimate in the limit
+        llbc::sint64 window_us = 100000;    // how often the limit is updated
+        std::uint32_t window_samples = 10;  // fewest samples of a window
+    };
+
+    // a limiter fixed at limit requests
+    static Options Fixed(std::uint32_t limit) noexcept {
+        return {.adaptive = false, .max_limit = limit};
+    }
+
+    // Windows after which the no-load latency is measured anew, so a service that got
+    // slower for good is not held to its old latency. With the default window it is once
+    // a minute.
+    static constexpr std::uint64_t PROBE_WINDOWS = 600;
+
+    explicit RpcConcurrencyLimiter(const Options &options) noexcept;
+
+    // Admit a request. Every admitted request must be released.
+    // @return false if the limit is reached
+    bool TryAcquire() noexcept;
+
+    // Release an admitted request answered latency_us after it was received, or that was
+    // given up before it was handled if latency_us < 0.
+    void Release(llbc::sint64 latency_us) noexcept;
+
+    std::uint32_t Limit() const noexcept { return limit_.load(std::memory_order_relaxed); }
+    std::uint32_t InFlight() const noexcept {
+        return inflight_.load(std::memory_order_relaxed);
+    }
+    // requests shed so far
+    std::uint64_t Rejected() const noexcept {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    // close the window ending at now, update_mutex_ must be held
+    void Update(llbc::sint64 now) noexcept;
+
+    const Options options_;
+    std::atomic<std::uint32_t> limit_;
+    std::atomic<std::uint32_t> inflight_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+
+    // samples of the current window
+    std::atomic<std::uint32_t> max_inflight_{0};
+    std::atomic<std::uint64_t> sample_count_{0};
+    std::atomic<llbc::sint64> sample_sum_us_{0};
+    std::atomic<llbc::sint64> window_end_{0};
+
+    std::mutex update_mutex_;  // one thread closes a window, guards below
+    double estimated_limit_;
+    double no_load_rtt_us_ = 0;  // lowest window latency, 0 before the first window
+    std::uint64_t windows_ = 0;
+};
+
+#endif  // _RPC_CONCURRENCY_LIMITER_H_
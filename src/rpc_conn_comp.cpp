@@ -1,10 +1,32 @@
 #include "rpc_conn_comp.h"
 
+#include <algorithm>
+
+#include "rpc_channel.h"
+#include "rpc_coro_mgr.h"
 #include "rpc_macros.h"
+#include "rpc_sync_call_mgr.h"
 
-RpcConnComp::RpcConnComp()
+RpcConnComp::RpcConnComp(std::size_t reactors, const QueueConfig &config)
     : llbc::LLBC_Component(llbc::LLBC_ComponentEvents::DefaultEvents |
-                           llbc::LLBC_ComponentEvents::OnUpdate) {}
+                           llbc::LLBC_ComponentEvents::OnUpdate),
+      reactors_(reactors),
+      config_(config) {
+    for (std::size_t i = 0; i < reactors_; ++i) {
+        lanes_.emplace_back(config_);
+    }
+}
+
+RpcConnComp::~RpcConnComp() {
+    llbc::LLBC_Packet *packet = nullptr;
+    for (auto &lane : lanes_) {
+        while (lane.sendQueue.pop(packet)) LLBC_Recycle(packet);
+        while (lane.recvQueue.pop(packet)) LLBC_Recycle(packet);
+        while (lane.shmRecvQueue.pop(packet)) LLBC_Recycle(packet);
+        for (auto *backlogged : lane.sendBacklog) LLBC_Recycle(backlogged);
+        for (auto *backlogged : lane.recvBacklog) LLBC_Recycle(backlogged);
+    }
+}
 
 bool RpcConnComp::OnInit(bool &initFinished) {
     LLOG_TRACE("RpcConnComp OnInit!");
@@ -19,10 +41,43 @@ void RpcConnComp::OnSessionCreate(const llbc::LLBC_SessionInfo &sessionInfo) {
 
 void RpcConnComp::OnSessionDestroy(const llbc::LLBC_SessionDestroyInfo &destroyInfo) {
     LLOG_TRACE("Session Destroy, info: %s", destroyInfo.ToString().c_str());
+    closed_sessions_.fetch_add(1, std::memory_order_release);
 }
 
 void RpcConnComp::OnAsyncConnResult(const llbc::LLBC_AsyncConnResult &result) {
     LLOG_TRACE("Async-Conn result: %s", result.ToString().c_str());
+    {
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        if (abandoned_conns_.erase(result.GetSessionId()) == 0) {
+            conn_results_[result.GetSessionId()] = result.IsConnected();
+            return;
+        }
+    }
+    if (result.IsConnected()) GetService()->RemoveSession(result.GetSessionId());
+}
+
+RpcConnComp::ConnState RpcConnComp::TakeConnResult(int sessionID) noexcept {
+    std::lock_guard<std::mutex> lock(conn_mutex_);
+    auto it = conn_results_.find(sessionID);
+    COND_RET(it == conn_results_.end(), ConnState::Connecting);
+    auto state = it->second ? ConnState::Connected : ConnState::Failed;
+    conn_results_.erase(it);
+    return state;
+}
+
+void RpcConnComp::AbandonConnect(int sessionID) noexcept {
+    bool connected = false;
+    {
+        std::lock_guard<std::mutex> lock(conn_mutex_);
+        auto it = conn_results_.find(sessionID);
+        if (it == conn_results_.end()) {
+            abandoned_conns_.insert(sessionID);
+            return;
+        }
+        connected = it->second;
+        conn_results_.erase(it);
+    }
+    if (connected) GetService()->RemoveSession(sessionID);
 }
 
 void RpcConnComp::OnUnHandledPacket(const llbc::LLBC_Packet &packet) {
@@ -35,31 +90,231 @@ void RpcConnComp::OnProtoReport(const llbc::LLBC_ProtoReport &report) {
 }
 
 void RpcConnComp::OnUpdate() {
-    llbc::LLBC_Packet *sendPacket = nullptr;
-    while (sendQueue_.pop(sendPacket)) {
-        LLOG_TRACE("OnUpdate: sendPacket: %s", sendPacket->ToString().c_str());
-        auto ret = GetService()->Send(sendPacket);
-        if (ret != LLBC_OK) {
-            LLOG_ERROR("Send packet failed, err: %s", llbc::LLBC_FormatLastError());
+    llbc::LLBC_Packet *sendPackets[SEND_BATCH];
+    for (std::size_t i = 0; i < reactors_; ++i) {
+        ResumeRecv(lanes_[i]);
+        std::size_t n = 0;
+        while ((n = lanes_[i].sendQueue.pop_n(sendPackets, SEND_BATCH)) > 0) {
+            for (std::size_t j = 0; j < n; ++j) {
+                Send(sendPackets[j]);
+            }
+        }
+    }
+}
+
+void RpcConnComp::Send(llbc::LLBC_Packet *packet) noexcept {
+    LAZY_TLOG("OnUpdate: sendPacket: %s", packet->ToString().c_str());
+    auto ret = GetService()->Send(packet);
+    if (ret != LLBC_OK) {
+        LLOG_ERROR("Send packet failed, err: %s", llbc::LLBC_FormatLastError());
+    }
+}
+
+std::size_t RpcConnComp::RouteOf(const llbc::LLBC_Packet &packet) const noexcept {
+    if (reactors_ == 1) {
+        return 0;
+    }
+    if (packet.GetOpcode() == RpcChannel::RpcOpCode::RpcRsp) {
+        // back to the reactor whose coro is waiting for it
+        std::uint64_t seq = 0;
+        if (RpcChannel::PkgHead::PeekSeq(packet, seq) != LLBC_OK) {
+            return 0;
         }
+        return RpcCoroMgr::ReactorOf(seq) % reactors_;
     }
+    return static_cast<std::size_t>(packet.GetSessionId()) % reactors_;
 }
 
 void RpcConnComp::OnRecvPacket(llbc::LLBC_Packet &packet) noexcept {
-    LLOG_TRACE("OnRecvPacket: %s", packet.ToString().c_str());
+    LAZY_TLOG("OnRecvPacket: %s", packet.ToString().c_str());
+    // recycled by the reactor thread, so it must come from the thread-safe pool
     llbc::LLBC_Packet *recvPacket =
-        llbc::LLBC_GetObjectFromUnsafetyPool<llbc::LLBC_Packet>();
-    recvPacket->SetHeader(packet, packet.GetOpcode(), 0);
+        llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    recvPacket->SetHeader(packet, packet.GetOpcode(), packet.GetStatus());
     recvPacket->SetPayload(packet.DetachPayload());
-    recvQueue_.emplace(recvPacket);
+    // receive time in microseconds, requests' deadlines are counted from here
+    recvPacket->SetExtData1(llbc::LLBC_GetMicroSeconds());
+    if (auto reactor = Deliver(recvPacket); reactor < reactors_) {
+        lanes_[reactor].parker.unpark();
+    }
 }
 
-int RpcConnComp::PushSendPacket(llbc::LLBC_Packet *sendPacket) noexcept {
-    if (sendQueue_.emplace(sendPacket)) return LLBC_OK;
-    return LLBC_FAILED;
+bool RpcConnComp::DeliverShm(llbc::LLBC_Packet *recvPacket) noexcept {
+    COND_RET(DeliverSync(recvPacket), true);
+    // a full queue holds the frame in the ring, which pushes back on the sender
+    auto &lane = lanes_[RouteOf(*recvPacket)];
+    COND_RET(!lane.shmRecvQueue.emplace(recvPacket), false);
+    lane.parker.unpark();
+    return true;
 }
 
-int RpcConnComp::PopRecvPacket(llbc::LLBC_Packet *&recvPacket) noexcept {
-    if (recvQueue_.pop(recvPacket)) return LLBC_OK;
+bool RpcConnComp::DeliverSync(llbc::LLBC_Packet *recvPacket) noexcept {
+    std::uint64_t seq = 0;
+    if (recvPacket->GetOpcode() != RpcChannel::RpcOpCode::RpcRsp ||
+        RpcChannel::PkgHead::PeekSeq(*recvPacket, seq) != LLBC_OK ||
+        !RpcSyncCallMgr::IsSyncSeq(seq)) {
+        return false;
+    }
+    // a blocking caller waits for it on its own thread, no reactor involved
+    if (!RpcSyncCallMgr::GetInst().Complete(seq, recvPacket)) {
+        LAZY_TLOG("Deliver: blocking call gone (possibly timed out)|seq: %lu", seq);
+        LLBC_Recycle(recvPacket);
+    }
+    return true;
+}
+
+std::size_t RpcConnComp::Deliver(llbc::LLBC_Packet *recvPacket) noexcept {
+    COND_RET(DeliverSync(recvPacket), reactors_);
+
+    auto reactor = RouteOf(*recvPacket);
+    auto &lane = lanes_[reactor];
+    if (!lane.recvStalled && lane.recvQueue.size() >= config_.recvHighWatermark) {
+        lane.recvStalled = true;
+        lane.recvStalls.fetch_add(1, std::memory_order_relaxed);
+        LLOG_WARN("Reactor %lu is behind, holding back its packets|depth: %lu", reactor,
+                  lane.recvQueue.size());
+    }
+    // once stalled, keep the order by queueing behind the backlog
+    if (lane.recvStalled || !lane.recvQueue.emplace(recvPacket)) {
+        if (lane.recvBacklog.size() >= config_.maxBacklog) {
+            lane.recvShed.fetch_add(1, std::memory_order_relaxed);
+            Shed(recvPacket);
+            return reactors_;
+        }
+        lane.recvBacklog.push_back(recvPacket);
+        lane.recvBacklogSize.store(lane.recvBacklog.size(), std::memory_order_relaxed);
+    }
+    return reactor;
+}
+
+void RpcConnComp::Shed(llbc::LLBC_Packet *recvPacket) noexcept {
+    LAZY_TLOG("Shed: recv backlog full|packet: %s", recvPacket->ToString().c_str());
+    RpcChannel::PkgHead head;
+    if (recvPacket->GetOpcode() == RpcChannel::RpcOpCode::RpcReq &&
+        head.FromPacket(*recvPacket) == LLBC_OK) {
+        auto *rsp = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+        rsp->SetHeader(recvPacket->GetSessionId(), RpcChannel::RpcOpCode::RpcRsp,
+                       RpcChannel::RpcOverloaded);
+        // the head alone, it carries the seq the caller waits on
+        head.body_len = 0;
+        head.ToPacket(*rsp);
+        Send(rsp);
+    }
+    LLBC_Recycle(recvPacket);
+}
+
+void RpcConnComp::ResumeRecv(Lane &lane) noexcept {
+    if (!lane.recvStalled || lane.recvQueue.size() > config_.recvLowWatermark) {
+        return;
+    }
+    bool moved = false;
+    while (!lane.recvBacklog.empty() &&
+           lane.recvQueue.size() < config_.recvHighWatermark &&
+           lane.recvQueue.emplace(lane.recvBacklog.front())) {
+        lane.recvBacklog.pop_front();
+        moved = true;
+    }
+    lane.recvStalled = !lane.recvBacklog.empty();
+    lane.recvBacklogSize.store(lane.recvBacklog.size(), std::memory_order_relaxed);
+    if (moved) lane.parker.unpark();
+}
+
+int RpcConnComp::PushSendPacket(std::size_t reactor,
+                                llbc::LLBC_Packet *sendPacket) noexcept {
+    auto &lane = lanes_[reactor];
+    // once backlogged, keep the order by queueing behind the backlog
+    if (lane.sendBacklogSize.load(std::memory_order_acquire) == 0 &&
+        lane.sendQueue.emplace(sendPacket)) {
+        return LLBC_OK;
+    }
+    std::lock_guard<std::mutex> lock(lane.sendBacklogMutex);
+    if (lane.sendBacklog.size() >= config_.maxBacklog) {
+        lane.sendRejected.fetch_add(1, std::memory_order_relaxed);
+        LAZY_TLOG("PushSendPacket: send backlog full|reactor: %lu", reactor);
+        return RpcChannel::RpcOverloaded;
+    }
+    if (lane.sendBacklog.empty()) {
+        lane.sendStalls.fetch_add(1, std::memory_order_relaxed);
+    }
+    lane.sendBacklog.push_back(sendPacket);
+    lane.sendBacklogSize.store(lane.sendBacklog.size(), std::memory_order_release);
+    return LLBC_OK;
+}
+
+std::size_t RpcConnComp::FlushSendBacklog(std::size_t reactor) noexcept {
+    auto &lane = lanes_[reactor];
+    if (lane.sendBacklogSize.load(std::memory_order_acquire) == 0) return 0;
+    std::lock_guard<std::mutex> lock(lane.sendBacklogMutex);
+    while (!lane.sendBacklog.empty() &&
+           lane.sendQueue.emplace(lane.sendBacklog.front())) {
+        lane.sendBacklog.pop_front();
+    }
+    lane.sendBacklogSize.store(lane.sendBacklog.size(), std::memory_order_release);
+    return lane.sendBacklog.size();
+}
+
+RpcConnComp::QueueStats RpcConnComp::GetQueueStats(std::size_t reactor) const noexcept {
+    const auto &lane = lanes_[reactor];
+    QueueStats stats;
+    stats.recvDepth = lane.recvQueue.size() + lane.shmRecvQueue.size();
+    stats.recvBacklog = lane.recvBacklogSize.load(std::memory_order_relaxed);
+    stats.recvStalls = lane.recvStalls.load(std::memory_order_relaxed);
+    stats.recvShed = lane.recvShed.load(std::memory_order_relaxed);
+    stats.sendDepth = lane.sendQueue.size();
+    stats.sendBacklog = lane.sendBacklogSize.load(std::memory_order_relaxed);
+    stats.sendStalls = lane.sendStalls.load(std::memory_order_relaxed);
+    stats.sendRejected = lane.sendRejected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int RpcConnComp::PopRecvPacket(std::size_t reactor,
+                               llbc::LLBC_Packet *&recvPacket) noexcept {
+    auto &lane = lanes_[reactor];
+    if (lane.recvQueue.pop(recvPacket) || lane.shmRecvQueue.pop(recvPacket)) {
+        return LLBC_OK;
+    }
     return LLBC_FAILED;
+}
+
+std::size_t RpcConnComp::PopRecvPackets(std::size_t reactor,
+                                        llbc::LLBC_Packet **recvPackets,
+                                        std::size_t n) noexcept {
+    auto &lane = lanes_[reactor];
+    auto popped = lane.recvQueue.pop_n(recvPackets, n);
+    return popped + lane.shmRecvQueue.pop_n(recvPackets + popped, n - popped);
+}
+
+void RpcConnComp::WaitRecvPacket(std::size_t reactor, llbc::sint64 timeout_ms) noexcept {
+    auto &lane = lanes_[reactor];
+    auto ready = [&lane]() {
+        return !lane.recvQueue.empty() || !lane.shmRecvQueue.empty();
+    };
+
+    // Spin first: a busy reactor gets the next packet without a syscall. The budget
+    // doubles when spinning pays off and halves when it doesn't, so an idle reactor
+    // parks almost immediately.
+    for (std::uint32_t i = 0; i < lane.spinLimit; ++i) {
+        if (ready()) {
+            lane.spinLimit = std::min(lane.spinLimit * 2, MAX_SPIN);
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    lane.spinLimit = std::max(lane.spinLimit / 2, MIN_SPIN);
+
+    // the send backlog only drains when the reactor runs, don't park it for long
+    if (lane.sendBacklogSize.load(std::memory_order_relaxed) > 0) {
+        timeout_ms = std::min<llbc::sint64>(timeout_ms, 1);
+    }
+    if (timeout_ms > 0) {
+        lane.parker.park(ready, timeout_ms);
+    }
+}
+
+void RpcConnComp::WakeAll() noexcept {
+    for (std::size_t i = 0; i < reactors_; ++i) {
+        lanes_[i].parker.unpark();
+    }
 }
\ No newline at end of file
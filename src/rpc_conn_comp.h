@@ -1,11 +1,64 @@
+#ifndef _RPC_CONN_COMP_H_
+#define _RPC_CONN_COMP_H_
+
 #include <llbc.h>
+#include <mpsc_queue.h>
+#include <parker.h>
 #include <spsc_queue.h>
 
-// Connection management component
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Connection management component.
+// Runs on the llbc service thread and exchanges packets with every reactor through a pair
+// of queues per reactor. Requests go to reactor `session_id % reactors`, responses to the
+// reactor encoded in their seq.
+// However many pollers the service runs, they only post events to the service thread,
+// and every On*() callback runs there, so the recv queue has a single producer. The send
+// queue does not: threads that aren't reactor workers all act as reactor 0, so it's MPSC.
+// Neither direction drops packets when a queue is full: they wait in a backlog owned by
+// the producing thread and are moved over as the consumer catches up. A backlog is
+// bounded by QueueConfig::maxBacklog. Beyond it received packets are shed, and sends
+// fail with RpcChannel::RpcOverloaded: under that much load a call fails right away with
+// RpcController::Overloaded() set, instead of queueing until it times out.
+// Packets of shared memory links skip the service thread: the RpcShmTransport poller
+// queues them to a second recv queue per reactor, see DeliverShm().
 class RpcConnComp : public llbc::LLBC_Component {
    public:
-    RpcConnComp();
-    virtual ~RpcConnComp() {}
+    struct QueueConfig {
+        std::size_t recvCapacity = 4096;  // packets per reactor, in each direction
+        std::size_t sendCapacity = 4096;  // at least 2
+        // A reactor whose recv queue reaches the high watermark is not fed until it
+        // drains to the low one; packets received meanwhile wait on the service thread.
+        std::size_t recvHighWatermark = 3072;
+        std::size_t recvLowWatermark = 1024;
+        // packets a backlog holds, per reactor and direction
+        std::size_t maxBacklog = 65536;
+    };
+
+    // queue counters of a reactor, readable from any thread
+    struct QueueStats {
+        std::size_t recvDepth = 0;       // packets in the recv queue
+        std::size_t recvBacklog = 0;     // packets held back on the service thread
+        std::uint64_t recvStalls = 0;    // times the high watermark was hit
+        std::uint64_t recvShed = 0;      // packets dropped with the backlog full
+        std::size_t sendDepth = 0;       // packets in the send queue
+        std::size_t sendBacklog = 0;     // packets waiting for room in the send queue
+        std::uint64_t sendStalls = 0;    // times the send queue was full
+        std::uint64_t sendRejected = 0;  // sends failed with the backlog full
+    };
+
+    // state of a session started with LLBC_Service::AsyncConn()
+    enum class ConnState { Connecting, Connected, Failed };
+
+    explicit RpcConnComp(std::size_t reactors = 1)
+        : RpcConnComp(reactors, QueueConfig()) {}
+    RpcConnComp(std::size_t reactors, const QueueConfig &config);
+    // recycles the packets left in the queues
+    virtual ~RpcConnComp();
 
     virtual bool OnInit(bool &initFinished);
     virtual void OnDestroy(bool &destroyFinished);
@@ -18,16 +71,105 @@ class RpcConnComp : public llbc::LLBC_Component {
     virtual void OnUnHandledPacket(const llbc::LLBC_Packet &packet);
     virtual void OnProtoReport(const llbc::LLBC_ProtoReport &report);
 
-    // push send packet
-    int PushSendPacket(llbc::LLBC_Packet *sendPacket) noexcept;
-    // pop recv packet
-    int PopRecvPacket(llbc::LLBC_Packet *&recvPacket) noexcept;
+    // Push send packet of a reactor, from any thread acting as that reactor. If the send
+    // queue is full the packet waits in the reactor's send backlog.
+    // @return RpcChannel::RpcOverloaded if the backlog is full too, the packet is then
+    // still the caller's
+    int PushSendPacket(std::size_t reactor, llbc::LLBC_Packet *sendPacket) noexcept;
+    // Move a reactor's send backlog into its send queue as far as there is room.
+    // @return number of packets still in the backlog
+    std::size_t FlushSendBacklog(std::size_t reactor) noexcept;
+    // pop recv packet of a reactor
+    int PopRecvPacket(std::size_t reactor, llbc::LLBC_Packet *&recvPacket) noexcept;
+    // pop up to n recv packets of a reactor, @return number of packets popped
+    std::size_t PopRecvPackets(std::size_t reactor, llbc::LLBC_Packet **recvPackets,
+                               std::size_t n) noexcept;
+    // Wait until a reactor's recv queue has packets, for at most timeout_ms.
+    // Spins for a while first, then parks the calling reactor thread.
+    void WaitRecvPacket(std::size_t reactor, llbc::sint64 timeout_ms) noexcept;
+    // wake every parked reactor
+    void WakeAll() noexcept;
     // callback when recv packet
     void OnRecvPacket(llbc::LLBC_Packet &packet) noexcept;
+    // Queue a packet received over shared memory, from the RpcShmTransport poller.
+    // @return false if its reactor's queue is full, the packet is then still the caller's
+    bool DeliverShm(llbc::LLBC_Packet *recvPacket) noexcept;
 
-    static constexpr int MAX_QUEUE_SIZE = 4096;
+    // State of a session started with AsyncConn(), forgotten once it is no longer
+    // Connecting, so the result is taken exactly once.
+    ConnState TakeConnResult(int sessionID) noexcept;
+    // give up on a session started with AsyncConn(), it is closed if it connects
+    void AbandonConnect(int sessionID) noexcept;
+    // Number of sessions closed so far. It goes up only once a closed session is no
+    // longer valid to the service, so a change means some session is gone.
+    std::uint64_t ClosedSessions() const noexcept {
+        return closed_sessions_.load(std::memory_order_acquire);
+    }
+
+    std::size_t Reactors() const noexcept { return reactors_; }
+    QueueStats GetQueueStats(std::size_t reactor) const noexcept;
+
+    static constexpr std::uint32_t MIN_SPIN = 64;    // spin budget bounds, in polls
+    static constexpr std::uint32_t MAX_SPIN = 4096;
+    static constexpr std::size_t SEND_BATCH = 64;  // send packets popped at a time
 
    private:
-    SPSCQueue<llbc::LLBC_Packet *, MAX_QUEUE_SIZE> sendQueue_;
-    SPSCQueue<llbc::LLBC_Packet *, MAX_QUEUE_SIZE> recvQueue_;
-};
\ No newline at end of file
+    // queues shared by the service thread and one reactor
+    struct Lane {
+        explicit Lane(const QueueConfig &config)
+            : sendQueue(config.sendCapacity),
+              recvQueue(config.recvCapacity),
+              shmRecvQueue(config.recvCapacity) {}
+
+        MPSCQueue<llbc::LLBC_Packet *> sendQueue;     // reactor threads -> service
+        SPSCQueue<llbc::LLBC_Packet *> recvQueue;     // service -> reactor
+        SPSCQueue<llbc::LLBC_Packet *> shmRecvQueue;  // shm poller -> reactor
+        Parker parker;  // unparked when either recv queue gets a packet
+
+        // reactor only
+        std::uint32_t spinLimit = MIN_SPIN;  // adaptive spin budget
+
+        // producers of sendQueue, slow path only
+        std::mutex sendBacklogMutex;
+        std::deque<llbc::LLBC_Packet *> sendBacklog;  // waiting for room in sendQueue
+
+        // service thread only
+        std::deque<llbc::LLBC_Packet *> recvBacklog;  // held back while stalled
+        bool recvStalled = false;  // between the high and the low watermark
+
+        std::atomic<std::size_t> sendBacklogSize{0};
+        std::atomic<std::size_t> recvBacklogSize{0};
+        std::atomic<std::uint64_t> sendStalls{0};
+        std::atomic<std::uint64_t> recvStalls{0};
+        std::atomic<std::uint64_t> sendRejected{0};
+        std::atomic<std::uint64_t> recvShed{0};
+    };
+
+    // feed a stalled reactor from its recv backlog once it drained to the low watermark
+    void ResumeRecv(Lane &lane) noexcept;
+
+    // reactor that handles a received packet
+    std::size_t RouteOf(const llbc::LLBC_Packet &packet) const noexcept;
+    // Hand a response of a blocking call to its caller.
+    // @return false if the packet is no such response
+    bool DeliverSync(llbc::LLBC_Packet *recvPacket) noexcept;
+    // Queue a received packet to its reactor, or hand a response to its blocking caller.
+    // @return the reactor, or Reactors() if no reactor got the packet
+    std::size_t Deliver(llbc::LLBC_Packet *recvPacket) noexcept;
+    // Drop a received packet its reactor's backlog has no room for. A request is answered
+    // RpcOverloaded, so the caller can retry elsewhere; a response is lost to a timeout.
+    void Shed(llbc::LLBC_Packet *recvPacket) noexcept;
+    // hand a packet over to the service, which recycles it
+    void Send(llbc::LLBC_Packet *packet) noexcept;
+
+    std::size_t reactors_;
+    QueueConfig config_;
+    std::deque<Lane> lanes_;  // never resized, so lanes keep their address
+
+    std::mutex conn_mutex_;                       // guards the two below
+    std::unordered_map<int, bool> conn_results_;  // connected or not, not taken yet
+    std::unordered_set<int> abandoned_conns_;     // no result yet, nobody waits for it
+    std::atomic<std::uint64_t> closed_sessions_{0};
+};
+
+#endif  // _RPC_CONN_COMP_H_
\ No newline at end of file
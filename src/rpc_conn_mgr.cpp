@@ -1,9 +1,11 @@
 #include "rpc_conn_mgr.h"
 
 #include "rpc_channel.h"
+#include "rpc_endpoint.h"
 #include "rpc_macros.h"
 
 RpcConnMgr::~RpcConnMgr() noexcept {
+    shm_.reset();  // delivers to comp_, which the service owns
     if (svc_) {
         svc_->Stop();
         svc_ = nullptr;
@@ -12,18 +14,29 @@ RpcConnMgr::~RpcConnMgr() noexcept {
     Unsubscribe(RpcChannel::RpcOpCode::RpcRsp);
 }
 
-int RpcConnMgr::Init() noexcept {
+int RpcConnMgr::Init(std::size_t reactors,
+                     const RpcConnComp::QueueConfig &config) noexcept {
     if (svc_) {
         Destroy();
     }
-    LLOG_TRACE("RpcConnMgr Init");
+    LLOG_TRACE("RpcConnMgr Init|reactors: %lu", reactors);
+    COND_RET_ELOG(reactors == 0 || reactors > RpcReactor::MAX_REACTORS, LLBC_FAILED,
+                  "Init: invalid reactor number|reactors: %lu", reactors);
+    // the send queue is an MPSCQueue, which needs 2 slots
+    COND_RET_ELOG(config.recvCapacity == 0 || config.sendCapacity < 2 ||
+                      config.recvLowWatermark > config.recvHighWatermark ||
+                      config.recvHighWatermark > config.recvCapacity,
+                  LLBC_FAILED,
+                  "Init: invalid queue config|recv: %lu, send: %lu, high: %lu, low: %lu",
+                  config.recvCapacity, config.sendCapacity, config.recvHighWatermark,
+                  config.recvLowWatermark);
     // Create service
     svc_ = llbc::LLBC_Service::Create("Svc");  // newed
     if (!svc_) {
         LLOG_ERROR("Create LLBC service failed");
         return LLBC_FAILED;
     }
-    comp_ = new RpcConnComp;
+    comp_ = new RpcConnComp(reactors, config);
     int ret = svc_->AddComponent(comp_);
     COND_RET_ELOG(ret != LLBC_OK, LLBC_FAILED, "AddComponent failed, ret: %d", ret);
 
@@ -41,12 +54,17 @@ int RpcConnMgr::Init() noexcept {
     COND_RET_ELOG(ret != LLBC_OK, LLBC_FAILED,
                   "SuppressCoderNotFoundWarning failed, ret: %d", ret);
 
-    ret = svc_->Start(4);
+    ret = svc_->Start(POLLER_NUM);
     COND_RET_ELOG(ret != LLBC_OK, LLBC_FAILED, "Start service failed, ret: %d", ret);
+
+    auto *comp = comp_;
+    shm_ = std::make_unique<RpcShmTransport>(
+        [comp](llbc::LLBC_Packet *packet) { return comp->DeliverShm(packet); });
     return LLBC_OK;
 }
 
 void RpcConnMgr::Destroy() noexcept {
+    shm_.reset();
     if (svc_) {
         svc_->Stop();
         LLOG_TRACE("RpcConnMgr Svc Stopped");
@@ -62,43 +80,98 @@ int RpcConnMgr::StartRpcService(const char *ip, int port) noexcept {
         return LLBC_FAILED;
     }
     LLOG_TRACE("RpcConnMgr StartRpcService");
+    if (RpcEndpoint::IsUnix(ip)) {
+        // llbc only listens on tcp, a unix socket takes shared memory links only
+        LLOG_TRACE("Server will listen on %s", ip);
+        auto ret = shm_->ListenPath(ip + RpcEndpoint::UNIX_PREFIX.size());
+        COND_RET_ELOG(ret != LLBC_OK, LLBC_FAILED, "Listen on %s failed", ip);
+        is_server_ = true;
+        ip_ = ip;
+        return LLBC_OK;
+    }
     LLOG_TRACE("Server will listen on %s:%d", ip, port);
     server_sessionID_ = svc_->Listen(ip, port);
     COND_RET_ELOG(server_sessionID_ == 0, LLBC_FAILED,
                   "Create session failed, reason: %s", llbc::LLBC_FormatLastError())
     is_server_ = true;
     ip_ = std::string(ip) + ":" + std::to_string(port);
+    // optional, clients on this host fall back to tcp without it
+    if (shm_->Listen(ip, port) != LLBC_OK) {
+        LLOG_WARN("Shared memory links disabled|%s", ip_.c_str());
+    }
     return LLBC_OK;
 }
 
-RpcChannel *RpcConnMgr::CreateRpcChannel(const char *ip, int port) {
+RpcChannel *RpcConnMgr::CreateRpcChannel(const char *ip, int port,
+                                         std::size_t max_sessions, bool shm) {
     LLOG_TRACE("CreateRpcChannel");
+    // the channel dials the link again if it closes
+    if (RpcEndpoint::IsUnix(ip)) {
+        auto sessionID = Connect(ip, port);
+        COND_RET(sessionID == 0, nullptr);
+        return new RpcChannel(this, sessionID, ip, port, 1, true);
+    }
+    if (shm) {
+        if (auto sessionID = ConnectShm(ip, port)) {
+            return new RpcChannel(this, sessionID, ip, port, 1, true);
+        }
+        LLOG_INFO("CreateRpcChannel: no shared memory link, using tcp|%s:%d", ip, port);
+    }
 
+    auto sessionID = Connect(ip, port);
+    COND_RET(sessionID == 0, nullptr);
+
+    return new RpcChannel(this, sessionID, ip, port, max_sessions);
+}
+
+int RpcConnMgr::Connect(const char *ip, int port) noexcept {
+    if (RpcEndpoint::IsUnix(ip)) {
+        auto sessionID = shm_->ConnectPath(ip + RpcEndpoint::UNIX_PREFIX.size());
+        COND_RET_ELOG(sessionID == 0, 0, "Connect to %s failed", ip);
+        return sessionID;
+    }
     // default timeout is -1, which means no timeout
     auto sessionID = svc_->Connect(ip, port);
-    COND_RET_ELOG(sessionID == 0, nullptr, "Create session failed, reason: %s",
+    COND_RET_ELOG(sessionID == 0, 0, "Create session failed, reason: %s",
                   llbc::LLBC_FormatLastError());
+    return sessionID;
+}
 
-    return new RpcChannel(this, sessionID);
+int RpcConnMgr::AsyncConnect(const char *ip, int port) noexcept {
+    auto sessionID = svc_->AsyncConn(ip, port);
+    COND_RET_ELOG(sessionID == 0, 0, "AsyncConnect to %s:%d failed, reason: %s", ip, port,
+                  llbc::LLBC_FormatLastError());
+    return sessionID;
 }
 
 int RpcConnMgr::CloseSession(int sessionID) {
     LLOG_TRACE("CloseSession: %d", sessionID);
+    if (RpcShmTransport::IsShmSession(sessionID)) {
+        return shm_->Close(sessionID);
+    }
     return svc_->RemoveSession(sessionID);
 }
 
-void RpcConnMgr::Tick() noexcept {
-    llbc::LLBC_Packet *packet = nullptr;
-    while (RecvPacket(packet) == LLBC_OK) {
-        LLOG_TRACE("Tick: RecvPacket");
-        auto it = packet_delegs_.find(packet->GetOpcode());
-        if (it == packet_delegs_.end())
-            LLOG_ERROR("Recv Untapped opcode:%d", packet->GetOpcode());
-        else {
-            (it->second)(*packet);  // handle rep or handle rsp
+std::size_t RpcConnMgr::Tick() noexcept {
+    std::size_t handled = 0;
+    llbc::LLBC_Packet *packets[TICK_BATCH];
+    auto reactor = RpcReactor::Current();
+    comp_->FlushSendBacklog(reactor);
+    std::size_t n = 0;
+    while ((n = comp_->PopRecvPackets(reactor, packets, TICK_BATCH)) > 0) {
+        handled += n;
+        LAZY_TLOG("Tick: RecvPackets: %lu", n);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto *packet = packets[i];
+            auto it = packet_delegs_.find(packet->GetOpcode());
+            if (it == packet_delegs_.end())
+                LLOG_ERROR("Recv Untapped opcode:%d", packet->GetOpcode());
+            else
+                (it->second)(*packet);  // handle rep or handle rsp
             LLBC_Recycle(packet);
         }
     }
+    return handled;
 }
 
 int RpcConnMgr::Subscribe(int cmdID,
@@ -111,13 +184,3 @@ int RpcConnMgr::Subscribe(int cmdID,
 void RpcConnMgr::Unsubscribe(int cmdID) {
     if (packet_delegs_.find(cmdID) != packet_delegs_.end()) packet_delegs_.erase(cmdID);
 }
-
-int RpcConnMgr::BlockingRecvPacket(llbc::LLBC_Packet *&recvPacket) {
-    int count = 0;
-    while (RecvPacket(recvPacket) != LLBC_OK && count < RECEIVE_TIME_OUT) {
-        llbc::LLBC_Sleep(1);
-        count++;
-    }
-    if (count != RECEIVE_TIME_OUT) return LLBC_OK;
-    return LLBC_FAILED;
-}
\ No newline at end of file
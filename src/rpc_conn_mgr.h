@@ -5,6 +5,8 @@
 #include <singleton.h>
 
 #include "rpc_conn_comp.h"
+#include "rpc_reactor.h"
+#include "rpc_shm_transport.h"
 
 class RpcChannel;
 
@@ -14,17 +16,52 @@ class RpcConnMgr : public Singleton<RpcConnMgr> {
    public:
     virtual ~RpcConnMgr() noexcept;
 
-    int Init() noexcept;
+    // reactors: number of reactor threads that will exchange packets, see RpcReactor
+    // config: queue capacities and watermarks of every reactor
+    int Init(std::size_t reactors = 1,
+             const RpcConnComp::QueueConfig &config = {}) noexcept;
 
     void Destroy() noexcept;
 
-    // start rpc service and listen on ip:port
+    // Start rpc service and listen on ip:port, and for shared memory links of clients on
+    // this host, see RpcShmTransport. An ip of "unix:/path" listens on that unix socket
+    // instead, for shared memory links only; port is ignored then.
     int StartRpcService(const char *ip, int port) noexcept;
+    // whether clients on this host can reach the service over shared memory
+    bool ShmListening() const noexcept { return shm_ && shm_->Listening(); }
 
     // create rpc client channel, this is used to connect to server
-    RpcChannel *CreateRpcChannel(const char *ip, int port);
+    // ip: may be "unix:/path", see StartRpcService()
+    // max_sessions: size limit of the channel's session pool, see RpcChannel
+    // shm: the server is on this host, try a shared memory link before tcp
+    RpcChannel *CreateRpcChannel(const char *ip, int port, std::size_t max_sessions = 1,
+                                 bool shm = false);
+
+    // connect a new session to ip:port, or a shared memory link to "unix:/path"
+    // @return its id, or 0 on failure
+    int Connect(const char *ip, int port) noexcept;
+    // Start connecting a new session to ip:port without waiting for it, see
+    // TakeConnResult(). @return its id, or 0 on failure
+    int AsyncConnect(const char *ip, int port) noexcept;
+    // state of a session started with AsyncConnect(), see RpcConnComp
+    RpcConnComp::ConnState TakeConnResult(int sessionID) noexcept {
+        return comp_->TakeConnResult(sessionID);
+    }
+    // give up on a session started with AsyncConnect(), it is closed if it connects
+    void AbandonConnect(int sessionID) noexcept { comp_->AbandonConnect(sessionID); }
+    // Link to the server on ip:port of this host over shared memory.
+    // @return the link's session id, or 0 if the server takes no such links
+    int ConnectShm(const char *ip, int port) noexcept { return shm_->Connect(ip, port); }
 
     int CloseSession(int sessionID);
+    // whether the tcp session is up
+    bool IsSessionOpen(int sessionID) noexcept {
+        return svc_->IsSessionValidate(sessionID);
+    }
+    // number of tcp sessions closed so far, see RpcConnComp::ClosedSessions()
+    std::uint64_t ClosedSessions() const noexcept { return comp_->ClosedSessions(); }
+    // whether the shared memory link is up, see RpcShmTransport::IsOpen()
+    bool IsShmLinkOpen(int sessionID) noexcept { return shm_->IsOpen(sessionID); }
 
     int GetServerSessionID() { return server_sessionID_; }
 
@@ -33,35 +70,63 @@ class RpcConnMgr : public Singleton<RpcConnMgr> {
     // Unsubscribe handlers
     void Unsubscribe(int cmdID);
 
-    // add packet to send queue
+    // Add packet to the send queue of the calling thread's reactor, packets of shared
+    // memory links go straight to their ring.
+    // @return LLBC_FAILED if the packet can't be sent, e.g. its shared memory link is
+    // closed, or RpcChannel::RpcOverloaded if its backlog is full; the packet is then
+    // still the caller's
     int SendPacket(llbc::LLBC_Packet *sendPacket) noexcept {
-        return comp_->PushSendPacket(sendPacket);
+        if (RpcShmTransport::IsShmSession(sendPacket->GetSessionId())) {
+            return shm_->Send(sendPacket);
+        }
+        return comp_->PushSendPacket(RpcReactor::Current(), sendPacket);
     }
-    // get packet from recv queue
+    // get packet from the recv queue of the calling thread's reactor
     int RecvPacket(llbc::LLBC_Packet *&recvPacket) noexcept {
-        return comp_->PopRecvPacket(recvPacket);
+        return comp_->PopRecvPacket(RpcReactor::Current(), recvPacket);
+    }
+    // Move the send backlog of the calling thread's reactor into its send queue.
+    // @return number of packets still waiting
+    std::size_t FlushSendBacklog() noexcept {
+        return comp_->FlushSendBacklog(RpcReactor::Current());
+    }
+    // wait for packets of the calling thread's reactor, for at most timeout_ms
+    void WaitRecvPacket(llbc::sint64 timeout_ms) noexcept {
+        comp_->WaitRecvPacket(RpcReactor::Current(), timeout_ms);
+    }
+    // wake all reactors waiting for packets, e.g. to let them see a stop request
+    void WakeAll() noexcept {
+        if (comp_) comp_->WakeAll();
+    }
+    // queue counters of a reactor
+    RpcConnComp::QueueStats GetQueueStats(std::size_t reactor) const noexcept {
+        return comp_->GetQueueStats(reactor);
     }
-    // block and wait for packet in recv queue
-    int BlockingRecvPacket(llbc::LLBC_Packet *&recvPacket);
 
-    // Handle rpc data packets. The main loop should call this function.
-    void Tick() noexcept;
+    // Handle rpc data packets of the calling thread's reactor.
+    // Every reactor loop should call this function.
+    // @return number of packets handled
+    std::size_t Tick() noexcept;
+    static constexpr std::size_t TICK_BATCH = 64;  // recv packets popped at a time
 
     bool IsServer() { return is_server_; }
 
     std::string GetIP() { return ip_; }
 
-    static constexpr int RECEIVE_TIME_OUT = 10000;
+    static constexpr int RECEIVE_TIME_OUT = 10000;  // default blocking call timeout, 10s
+    // llbc poller threads, they do socket IO and post packets to the service thread
+    static constexpr int POLLER_NUM = 4;
 
    protected:
     RpcConnMgr() = default;
 
    private:
-    llbc::LLBC_Service *svc_ = nullptr;  // llbc service
-    RpcConnComp *comp_ = nullptr;        // connection component
-    std::string ip_ = "";                // server listen ip
-    bool is_server_ = false;             // is server or client
-    int server_sessionID_ = 0;           // server session id
+    llbc::LLBC_Service *svc_ = nullptr;     // llbc service
+    RpcConnComp *comp_ = nullptr;           // connection component
+    std::unique_ptr<RpcShmTransport> shm_;  // same-host links, delivers to comp_
+    std::string ip_ = "";                   // server address, "ip:port" or "unix:/path"
+    bool is_server_ = false;                // is server or client
+    int server_sessionID_ = 0;              // server session id
     std::unordered_map<int, llbc::LLBC_Delegate<void(llbc::LLBC_Packet &)>>
         packet_delegs_;  // {RpcOpCode : HandleReq / HandleRsp}
 };
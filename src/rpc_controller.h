@@ -2,18 +2,38 @@
 #define _RPC_CONTROLLER_H
 
 #include <google/protobuf/service.h>
+#include <object_pool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
 
 #include "rpc_channel.h"
 
 class RpcController : public ::google::protobuf::RpcController {
    public:
+    struct Releaser {
+        void operator()(RpcController* controller) const noexcept;
+    };
+    using Ptr = std::unique_ptr<RpcController, Releaser>;
+
     RpcController() = delete;
 
     // use_coro: true for coro, false for blocking
     RpcController(bool use_coro) noexcept : use_coro_(use_coro) {};
     ~RpcController() noexcept = default;
 
-    virtual void Reset() {}
+    // Reset to the initial state for reuse. errorText_ keeps its capacity.
+    virtual void Reset() {
+        isFailed_ = false;
+        overloaded_ = false;
+        errorText_.clear();
+        pkg_head_ = RpcChannel::PkgHead{};
+        session_id_ = 0;
+        coro_handle = nullptr;
+        timeout_ms_ = 0;
+        deadline_ = 0;
+    }
     virtual bool Failed() const { return isFailed_; };
     virtual std::string ErrorText() const { return errorText_; };
     virtual void StartCancel() {}
@@ -22,6 +42,15 @@ class RpcController : public ::google::protobuf::RpcController {
         errorText_ = reason;
     };
     virtual bool IsCanceled() const { return false; }
+
+    // Failed because the server was overloaded and shed the call without handling it, or
+    // the call never left this process as its send backlog was full.
+    // The call may be retried on another backend.
+    void SetOverloaded(const std::string& reason = "server overloaded") {
+        SetFailed(reason);
+        overloaded_ = true;
+    }
+    bool Overloaded() const noexcept { return overloaded_; }
     virtual void NotifyOnCancel(::google::protobuf::Closure* /* callback */) {}
 
     void SetPkgHead(const RpcChannel::PkgHead& pkg_head) noexcept {
@@ -37,13 +66,58 @@ class RpcController : public ::google::protobuf::RpcController {
 
     bool UseCoro() const noexcept { return use_coro_; }
 
+    // Per-call timeout in milliseconds. 0 means the default, RpcCoroMgr::CORO_TIME_OUT.
+    void SetTimeout(int timeout_ms) noexcept { timeout_ms_ = timeout_ms; }
+    int GetTimeout() const noexcept { return timeout_ms_; }
+
+    // Absolute deadline in LLBC_GetMilliSeconds() time, 0 for none. A server-side
+    // controller carries its caller's deadline; copy it into the controllers of nested
+    // calls so they never outlive the request that issued them.
+    void SetDeadline(llbc::sint64 deadline) noexcept { deadline_ = deadline; }
+    llbc::sint64 GetDeadline() const noexcept { return deadline_; }
+
+    // Timeout of a call issued at `now`: the configured timeout (or `dft`) capped by
+    // the time left until the deadline. <= 0 means the deadline has passed.
+    llbc::sint64 CallTimeout(llbc::sint64 now, int dft) const noexcept {
+        llbc::sint64 timeout = timeout_ms_ > 0 ? timeout_ms_ : dft;
+        return deadline_ > 0 ? std::min(timeout, deadline_ - now) : timeout;
+    }
+
+    /**
+     * Get a controller from the calling thread's pool. It goes back to the pool when the
+     * returned pointer is destroyed, which must happen on the same thread; debug builds
+     * assert that it does.
+     */
+    static Ptr New(bool use_coro) {
+        auto* controller = Pool().acquire(use_coro);
+        controller->use_coro_ = use_coro;
+        controller->pool_ = &Pool();
+        return Ptr(controller);
+    }
+
    private:
+    static ObjectPool<RpcController>& Pool() noexcept {
+        thread_local ObjectPool<RpcController> pool;
+        return pool;
+    }
+
     bool isFailed_ = false;
+    bool overloaded_ = false;
     std::string errorText_;
     RpcChannel::PkgHead pkg_head_;
-    int session_id_;
+    int session_id_ = 0;
     void* coro_handle = nullptr;
     bool use_coro_ = true;
+    int timeout_ms_ = 0;
+    llbc::sint64 deadline_ = 0;
+    const ObjectPool<RpcController>* pool_ = nullptr;  // owning pool, see New()
 };
 
+inline void RpcController::Releaser::operator()(
+    RpcController* controller) const noexcept {
+    assert(controller->pool_ == &Pool() && "released on another thread than New()");
+    controller->Reset();
+    Pool().release(controller);
+}
+
 #endif  // _RPC_CONTROLLER_H
@@ -1,48 +1,100 @@
 #include "rpc_coro_mgr.h"
 
-RpcCoroMgr::coro_uid_type RpcCoroMgr::coro_uid_generator_ = 0UL;
+#include <utility>
 
-bool RpcCoroMgr::AddCoroContext(context ctx) noexcept {
-    coroHeap_.Insert(ctx);
-    return suspended_contexts_.insert({ctx.coro_uid, ctx}).second;
+RpcCoroMgr::RpcCoroMgr()
+    : reactor_(RpcReactor::Current()),
+      slots_(std::make_unique<entry[]>(MAX_SUSPENDED)),
+      timeout_wheel_(llbc::LLBC_GetMilliSeconds()) {
+    free_slots_.reserve(MAX_SUSPENDED);
+    // low indices on top, so hot slots stay together
+    for (std::uint32_t i = MAX_SUSPENDED; i > 0; --i) {
+        free_slots_.push_back(i - 1);
+    }
+}
+
+RpcCoroMgr::coro_uid_type RpcCoroMgr::AddCoroContext(const context &ctx) noexcept {
+    COND_RET_ELOG(free_slots_.empty(), 0UL,
+                  "AddCoroContext: too many suspended coros|max: %u", MAX_SUSPENDED);
+    auto idx = free_slots_.back();
+    free_slots_.pop_back();
+
+    auto &e = slots_[idx];
+    e.ctx = ctx;
+    e.ctx.coro_uid = MakeCoroUid(idx, reactor_, e.generation);
+    e.in_use = true;
+    timeout_wheel_.add(&e, ctx.timeout_time);
+    return e.ctx.coro_uid;
 }
 
 void RpcCoroMgr::KillCoro(coro_uid_type coro_uid, const std::string &reason) noexcept {
-    if (auto iter = suspended_contexts_.find(coro_uid);
-        iter != suspended_contexts_.end()) {
-        auto ctx = iter->second;
+    auto ctx = PopCoroContext(coro_uid);
+    if (ctx.handle) {
         KillCoro(ctx, reason);
     }
 }
 
 void RpcCoroMgr::KillCoro(context &ctx, const std::string &reason) noexcept {
+    PopCoroContext(ctx.coro_uid);
     ctx.controller->SetFailed(reason);
+    Resume(ctx);
+}
+
+void RpcCoroMgr::Resume(context &ctx) noexcept {
+    // the controller may be gone once the coro runs on
+    if (ctx.stats) {
+        ctx.stats->End(llbc::LLBC_GetMicroSeconds() - ctx.start_us,
+                       ctx.controller->Failed());
+    }
     ctx.handle.resume();
-    suspended_contexts_.erase(ctx.coro_uid);
 }
 
 void RpcCoroMgr::HandleCoroTimeout() noexcept {
-    llbc::sint64 now = llbc::LLBC_GetMilliSeconds();
-    while (!coroHeap_.IsEmpty()) {
-        auto top = coroHeap_.Top();
-        if (top.timeout_time > now) {
-            break;
-        }
-        coroHeap_.DeleteTop();
-        // already resumed
-        if (suspended_contexts_.find(top.coro_uid) == suspended_contexts_.end()) {
-            continue;
+    // a resumed coro may fail another call, that one waits for the next round
+    if (!failed_.empty()) {
+        auto failed = std::exchange(failed_, {});
+        for (auto handle : failed) {
+            handle.resume();
         }
-        KillCoro(top, "coro timeout");
     }
+    timeout_wheel_.advance(llbc::LLBC_GetMilliSeconds(), [this](TimerNode *node) {
+        auto *e = static_cast<entry *>(node);
+        auto ctx = e->ctx;
+        FreeEntry(e);
+        ctx.controller->SetFailed("coro timeout");
+        Resume(ctx);
+    });
 }
 
 RpcCoroMgr::context RpcCoroMgr::PopCoroContext(coro_uid_type coro_uid) noexcept {
-    if (auto iter = suspended_contexts_.find(coro_uid);
-        iter != suspended_contexts_.end()) {
-        auto ctx = iter->second;
-        suspended_contexts_.erase(iter);
-        return ctx;
+    auto *e = FindEntry(coro_uid);
+    if (!e) {
+        return context{.handle = nullptr, .rsp = nullptr};
+    }
+    auto ctx = e->ctx;
+    timeout_wheel_.cancel(e);
+    FreeEntry(e);
+    return ctx;
+}
+
+RpcCoroMgr::entry *RpcCoroMgr::FindEntry(coro_uid_type coro_uid) noexcept {
+    auto idx = static_cast<std::uint32_t>(coro_uid) & ((1U << REACTOR_SHIFT) - 1);
+    auto generation = static_cast<std::uint32_t>(coro_uid >> 32);
+    if (idx >= MAX_SUSPENDED || ReactorOf(coro_uid) != reactor_) {
+        return nullptr;
+    }
+    auto &e = slots_[idx];
+    return e.in_use && e.generation == generation ? &e : nullptr;
+}
+
+void RpcCoroMgr::FreeEntry(entry *e) noexcept {
+    if (e->ctx.inflight) {
+        e->ctx.inflight->fetch_sub(1, std::memory_order_relaxed);
+        e->ctx.inflight.reset();
+    }
+    e->in_use = false;
+    if (++e->generation == 0) {
+        e->generation = 1;
     }
-    return context{.handle = nullptr, .rsp = nullptr};
+    free_slots_.push_back(static_cast<std::uint32_t>(e - slots_.get()));
 }
\ No newline at end of file
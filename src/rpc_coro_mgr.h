@@ -4,72 +4,133 @@
 #include <google/protobuf/message.h>
 #include <google/protobuf/text_format.h>
 #include <llbc.h>
-#include <singleton.h>
+#include <timing_wheel.h>
 
+#include <atomic>
 #include <coroutine>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 
 #include "rpc_controller.h"
 #include "rpc_coro.h"
 #include "rpc_macros.h"
+#include "rpc_reactor.h"
+#include "rpc_stats.h"
 
-class RpcCoroMgr : public Singleton<RpcCoroMgr> {
-    friend class Singleton<RpcCoroMgr>;
-
+// One instance per reactor thread, see RpcReactor. Coros are resumed on the reactor that
+// suspended them.
+class RpcCoroMgr {
    public:
+    // coro_uid layout:
+    //
+    //   0                    24        32                        64
+    //   +--------------------+---------+-------------------------+
+    //   |     slot index     | reactor |       generation        |
+    //   +--------------------+---------+-------------------------+
+    //
+    // The slot index addresses the in-flight table directly. The generation changes each
+    // time a slot is freed, so responses for timed-out or killed calls don't match. The
+    // reactor lets the connection component route a response back to its caller.
     using coro_uid_type = std::uint64_t;
 
     struct context {
         coro_uid_type coro_uid = 0UL;
         llbc::sint64 timeout_time;
-        std::coroutine_handle<RpcCoro::promise_type> handle = nullptr;
+        std::coroutine_handle<> handle = nullptr;
         ::google::protobuf::Message *rsp = nullptr;
         RpcController *controller = nullptr;
-    };
-
-    struct contextCmp {
-        bool operator()(const context &a, const context &b) const {
-            return a.timeout_time < b.timeout_time;
-        }
+        // Decremented when the context is removed, see RpcChannel's session pool. Owned
+        // with the pool, so a call may outlive its channel.
+        std::shared_ptr<std::atomic<std::uint32_t>> inflight;
+        RpcMethodStats *stats = nullptr;  // client side, ended when the coro is resumed
+        llbc::sint64 start_us = 0;        // when the call was sent
     };
 
     virtual ~RpcCoroMgr() = default;
 
-    // Add coro context to map and timeout heap.
-    bool AddCoroContext(context ctx) noexcept;
+    // instance of the calling thread's reactor
+    static RpcCoroMgr &GetInst() noexcept {
+        thread_local RpcCoroMgr inst;
+        return inst;
+    }
+
+    static constexpr coro_uid_type MakeCoroUid(std::uint32_t idx, std::size_t reactor,
+                                               std::uint32_t generation) noexcept {
+        return (static_cast<coro_uid_type>(generation) << 32) |
+               (static_cast<coro_uid_type>(reactor) << REACTOR_SHIFT) | idx;
+    }
+
+    // reactor that issued coro_uid
+    static constexpr std::size_t ReactorOf(coro_uid_type coro_uid) noexcept {
+        return static_cast<std::size_t>(coro_uid >> REACTOR_SHIFT) &
+               ((std::size_t(1) << (32 - REACTOR_SHIFT)) - 1);
+    }
+
+    /**
+     * Add coro context to the in-flight table and timeout wheel.
+     * @return the coro_uid assigned to the context, or 0 if the table is full.
+     */
+    coro_uid_type AddCoroContext(const context &ctx) noexcept;
 
     // Kill a coro by coro_uid
     void KillCoro(coro_uid_type coro_uid, const std::string &reason) noexcept;
 
-    // Kill a coro by context
+    // Kill a coro by context. The context is removed before the coro is resumed.
     void KillCoro(context &ctx, const std::string &reason) noexcept;
 
-    /**
-     * Pop coro context by coro_uid.
-     * @note This method does not erase the context from timeout heap.
-     */
+    // End the call's stats and resume its coro. The context must be removed already.
+    static void Resume(context &ctx) noexcept;
+
+    // Pop coro context by coro_uid and cancel its timeout.
+    // A stale coro_uid yields a context with a null handle.
     context PopCoroContext(coro_uid_type coro_uid) noexcept;
 
-    // Handle coro timeout.
+    // Resume a coro at the next HandleCoroTimeout(), for one that is about to suspend on
+    // a call that failed before it was sent, so no response or timeout will resume it.
+    void ResumeLater(std::coroutine_handle<> handle) { failed_.push_back(handle); }
+
+    // Resume the coros passed to ResumeLater(), then handle coro timeout.
     void HandleCoroTimeout() noexcept;
 
-    // Generate new coro uid.
-    static coro_uid_type NewCoroUid() noexcept {
-        return ++coro_uid_generator_ == 0UL ? ++coro_uid_generator_ : coro_uid_generator_;
+    // Time of the next coro timeout in milliseconds, or -1 if no coro is suspended.
+    // Never later than the real timeout, so waiting until then is safe.
+    llbc::sint64 NextTimeout() const noexcept {
+        if (!failed_.empty()) return 0;
+        return timeout_wheel_.empty() ? -1 : timeout_wheel_.next_expire();
     }
 
-    static constexpr int CORO_TIME_OUT = 10000;  // coro timeout time, 10s
+    // Number of suspended coros.
+    std::size_t SuspendedCount() const noexcept {
+        return MAX_SUSPENDED - free_slots_.size() + failed_.size();
+    }
+
+    static constexpr int CORO_TIME_OUT = 10000;              // coro timeout time, 10s
+    static constexpr std::uint32_t MAX_SUSPENDED = 1U << 16;  // in-flight table size
+    static constexpr int REACTOR_SHIFT = 24;
+    static_assert(MAX_SUSPENDED <= (1U << REACTOR_SHIFT));
+    static_assert(RpcReactor::MAX_REACTORS <= (1U << (32 - REACTOR_SHIFT)));
 
    protected:
-    RpcCoroMgr() = default;
+    RpcCoroMgr();
 
    private:
-    std::unordered_map<coro_uid_type, context>
-        suspended_contexts_;  // suspended coro contextss
-    llbc::LLBC_BinaryHeap<context, contextCmp> coroHeap_;  // timeout heap
+    // in-flight table slot, linked into the timeout wheel while in use
+    struct entry : TimerNode {
+        context ctx;
+        std::uint32_t generation = 1;  // never 0, so coro_uid is never 0
+        bool in_use = false;
+    };
+
+    // slot of coro_uid, or nullptr if the uid is stale
+    entry *FindEntry(coro_uid_type coro_uid) noexcept;
+    // free the slot, bump its generation and release the call's in-flight count
+    void FreeEntry(entry *e) noexcept;
 
-    static coro_uid_type coro_uid_generator_;  // coro_uid generator, which should
-                                               // generate unique id without `0`.
+    std::size_t reactor_;                     // reactor owning this instance
+    std::unique_ptr<entry[]> slots_;          // in-flight table
+    std::vector<std::uint32_t> free_slots_;  // free slot indices
+    TimingWheel timeout_wheel_;              // coro timeouts, in milliseconds
+    std::vector<std::coroutine_handle<>> failed_;  // see ResumeLater()
 };
 
 #endif  // _RPC_CORO_MGR_H_
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef _RPC_ENDPOINT_H_
+#define _RPC_ENDPOINT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "rpc_channel.h"
+
+/**
+ * A backend of a method, parsed once when it shows up in the registry. The registry's
+ * snapshots share an endpoint for as long as the backend stays registered, so its
+ * channel is looked up once as well.
+ */
+struct RpcEndpoint {
+    // registry node name, "ip:port" or an escaped "unix:/path", optionally followed by
+    // "@weight" and "+host", see RpcRegistry::ParseEndpoint()
+    std::string name;
+    std::string ip;  // or "unix:/path" of a unix socket, whose port is 0
+    int port = 0;
+    std::uint32_t weight = 1;
+    std::string host;  // RpcShmTransport::HostID() of a backend reachable over shm
+    std::atomic<RpcChannel *> channel{nullptr};  // set by the first call to the endpoint
+
+    // Address prefix of servers listening on a unix socket instead of tcp, which the
+    // same-host shared memory transport serves. Accepted wherever an ip is.
+    static constexpr std::string_view UNIX_PREFIX = "unix:";
+    static bool IsUnix(std::string_view addr) noexcept {
+        return addr.substr(0, UNIX_PREFIX.size()) == UNIX_PREFIX;
+    }
+
+    // calls in flight to the endpoint
+    std::uint32_t InFlight() const noexcept {
+        auto *ch = channel.load(std::memory_order_acquire);
+        return ch ? ch->InFlight() : 0;
+    }
+};
+
+#endif  // _RPC_ENDPOINT_H_
@@ -0,0 +1,77 @@
+#include "rpc_fan_out.h"
+
+#include "rpc_controller.h"
+#include "rpc_coro_mgr.h"
+#include "rpc_macros.h"
+
+RpcFanOut::RpcFanOut(std::vector<RpcChannel::CallAwaiter> calls, std::size_t need,
+                     bool wait_all, bool any) noexcept
+    : calls_(std::move(calls)), state_(std::make_shared<State>()) {
+    state_->total = calls_.size();
+    state_->need = need < calls_.size() ? need : calls_.size();
+    state_->wait_all = wait_all;
+    state_->any = any;
+    state_->pending.resize(calls_.size(), nullptr);
+}
+
+bool RpcFanOut::State::Done() const noexcept {
+    if (succeeded + failed == total) return true;
+    if (wait_all) return false;
+    // enough successes, or too many failures to ever get them
+    return succeeded >= need || failed > total - need;
+}
+
+void RpcFanOut::State::CancelPending() noexcept {
+    for (auto *call : pending) {
+        // resumes the call right away, it sees `finished` and ends
+        if (call) RpcCoroMgr::GetInst().KillCoro(call->seq(), "cancelled");
+    }
+}
+
+bool RpcFanOut::await_suspend(std::coroutine_handle<> parent) noexcept {
+    auto &state = *state_;
+    state.parent = parent;
+    for (std::size_t i = 0; i < calls_.size(); ++i) {
+        if (state.finished) {
+            calls_[i].controller()->SetFailed("cancelled");
+            continue;
+        }
+        Issue(calls_[i], state_, i);
+    }
+    state.launching = false;
+    // calls that fail to send finish before suspending, they may have completed the group
+    return !state.finished;
+}
+
+std::ptrdiff_t RpcFanOut::await_resume() const noexcept {
+    if (state_->any) return state_->first;
+    return static_cast<std::ptrdiff_t>(state_->succeeded);
+}
+
+RpcCoro RpcFanOut::Issue(RpcChannel::CallAwaiter call, std::shared_ptr<State> state,
+                         std::size_t index) {
+    state->pending[index] = &call;
+    int ret = co_await call;
+    state->pending[index] = nullptr;
+    if (state->finished) {
+        co_return;  // cancelled, the parent already has what it needs
+    }
+
+    if (ret == LLBC_OK) {
+        if (state->first < 0) state->first = static_cast<std::ptrdiff_t>(index);
+        ++state->succeeded;
+    } else {
+        ++state->failed;
+    }
+    if (!state->Done()) {
+        co_return;
+    }
+
+    state->finished = true;
+    state->CancelPending();
+    LAZY_TLOG("RpcFanOut done|total: %lu, succeeded: %lu, failed: %lu", state->total,
+              state->succeeded, state->failed);
+    if (!state->launching) {
+        state->parent.resume();
+    }
+}
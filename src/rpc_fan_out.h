@@ -0,0 +1,83 @@
+#ifndef _RPC_FAN_OUT_H_
+#define _RPC_FAN_OUT_H_
+
+#include <coroutine>
+#include <memory>
+#include <vector>
+
+#include "rpc_channel.h"
+#include "rpc_coro.h"
+
+/**
+ * Awaiter of a group of calls, returned by WhenAll(), WhenAny() and WhenN():
+ *
+ *  std::vector<RpcChannel::CallAwaiter> calls;
+ *  for (auto &backend : backends)
+ *      calls.push_back(backend.stub.Echo(backend.cntl.get(), &req, &backend.rsp));
+ *  auto succeeded = co_await WhenAll(std::move(calls));
+ *
+ * All requests are queued before the parent suspends, so they go out in the same
+ * RpcConnComp::OnUpdate() tick, each with its own send, and the parent is resumed once,
+ * when the condition is met. Each call still reports through its own controller. Calls
+ * left over by WhenAny() or WhenN() are cancelled with "cancelled": their controllers
+ * are marked failed and late responses are dropped, so their response objects may go
+ * away once the parent resumes.
+ */
+class RpcFanOut {
+   public:
+    // need: successes that complete the group, wait_all: complete only once every call is
+    // done, any: yield the index of the first success instead of the number of successes
+    RpcFanOut(std::vector<RpcChannel::CallAwaiter> calls, std::size_t need, bool wait_all,
+              bool any) noexcept;
+
+    bool await_ready() const noexcept { return state_->total == 0 || state_->need == 0; }
+    bool await_suspend(std::coroutine_handle<> parent) noexcept;
+    // number of calls that succeeded, or for WhenAny() the index of the first one
+    std::ptrdiff_t await_resume() const noexcept;
+
+   private:
+    struct State {
+        std::vector<RpcChannel::CallAwaiter *> pending;  // suspended calls, by index
+        std::size_t total = 0;
+        std::size_t need = 0;
+        bool wait_all = false;
+        bool any = false;
+        std::size_t succeeded = 0;
+        std::size_t failed = 0;
+        std::ptrdiff_t first = -1;  // index of the first success
+        std::coroutine_handle<> parent = nullptr;
+        bool launching = true;  // the parent is still in await_suspend()
+        bool finished = false;
+
+        bool Done() const noexcept;
+        void CancelPending() noexcept;
+    };
+
+    // one call of the group, resumed by its response like any other coroutine call
+    static RpcCoro Issue(RpcChannel::CallAwaiter call, std::shared_ptr<State> state,
+                         std::size_t index);
+
+    std::vector<RpcChannel::CallAwaiter> calls_;
+    std::shared_ptr<State> state_;
+};
+
+// Resume when every call is done. Yields the number of calls that succeeded.
+inline RpcFanOut WhenAll(std::vector<RpcChannel::CallAwaiter> calls) noexcept {
+    auto n = calls.size();
+    return RpcFanOut(std::move(calls), n, true, false);
+}
+
+// Resume once n calls succeeded, or as soon as that can no longer happen.
+// Yields the number of calls that succeeded.
+inline RpcFanOut WhenN(std::vector<RpcChannel::CallAwaiter> calls,
+                       std::size_t n) noexcept {
+    return RpcFanOut(std::move(calls), n, false, false);
+}
+
+// Resume once a call succeeded, or all failed.
+// Yields the index of the call that succeeded, or -1.
+inline RpcFanOut WhenAny(std::vector<RpcChannel::CallAwaiter> calls) noexcept {
+    return RpcFanOut(std::move(calls), 1, false, true);
+}
+
+#endif  // _RPC_FAN_OUT_H_
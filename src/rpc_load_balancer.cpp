@@ -0,0 +1,157 @@
+#include "rpc_load_balancer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace {
+
+std::mt19937_64 &Rng() noexcept {
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    return rng;
+}
+
+// 64-bit FNV-1a followed by a murmur3 finalizer, so close inputs spread over the ring
+std::uint64_t Hash(std::string_view data) noexcept {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : data) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// nginx's smooth weighted round-robin: every pick raises each backend's current weight
+// by its weight, takes the highest and lowers it by the total, so heavy backends are
+// interleaved with light ones instead of picked in a row. The picks repeat after the
+// total weight, so they are laid out once in Update() and Select() only bumps a counter.
+class RpcRoundRobinBalancer : public RpcLoadBalancer {
+   public:
+    void Update(const std::vector<RpcEndpoint *> &endpoints) override {
+        endpoints_ = endpoints;
+        schedule_.clear();
+        // weights 2:4 pick the same as 1:2, and equal weights take one pick each
+        std::uint32_t divisor = 0;
+        for (auto *endpoint : endpoints_) divisor = std::gcd(divisor, endpoint->weight);
+        std::vector<std::int64_t> weight;
+        std::int64_t total = 0;
+        for (auto *endpoint : endpoints_) {
+            weight.push_back(endpoint->weight / divisor);
+            total += weight.back();
+        }
+        std::vector<std::int64_t> current(endpoints_.size(), 0);
+        for (std::int64_t n = 0; n < total; ++n) {
+            std::size_t best = 0;
+            for (std::size_t i = 0; i < endpoints_.size(); ++i) {
+                current[i] += weight[i];
+                if (current[i] > current[best]) best = i;
+            }
+            current[best] -= total;
+            schedule_.push_back(static_cast<std::uint32_t>(best));
+        }
+    }
+
+    RpcEndpoint *Select(const Request &) const override {
+        if (schedule_.empty()) return nullptr;
+        auto n = next_.fetch_add(1, std::memory_order_relaxed);
+        return endpoints_[schedule_[n % schedule_.size()]];
+    }
+
+   private:
+    std::vector<RpcEndpoint *> endpoints_;
+    std::vector<std::uint32_t> schedule_;  // endpoint index of each pick in a round
+    mutable std::atomic<std::uint64_t> next_{0};
+};
+
+// Power of two choices: of two random backends take the one with fewer calls in flight
+// per unit of weight.
+class RpcP2CBalancer : public RpcLoadBalancer {
+   public:
+    void Update(const std::vector<RpcEndpoint *> &endpoints) override {
+        endpoints_ = endpoints;
+    }
+
+    RpcEndpoint *Select(const Request &) const override {
+        if (endpoints_.empty()) return nullptr;
+        if (endpoints_.size() == 1) return endpoints_[0];
+
+        auto &rng = Rng();
+        auto n = endpoints_.size();
+        auto i = rng() % n;
+        auto j = rng() % (n - 1);
+        if (j >= i) ++j;  // distinct from i
+        auto *a = endpoints_[i];
+        auto *b = endpoints_[j];
+        // load(a) / weight(a) <= load(b) / weight(b), without dividing
+        auto load_a = static_cast<std::uint64_t>(a->InFlight()) * b->weight;
+        auto load_b = static_cast<std::uint64_t>(b->InFlight()) * a->weight;
+        return load_a <= load_b ? a : b;
+    }
+
+   private:
+    std::vector<RpcEndpoint *> endpoints_;
+};
+
+// Ketama ring: each backend owns VNODES points per unit of weight and a key goes to the
+// first point at or after its hash. Adding or removing a backend only moves the keys of
+// its own points, so backends that cache per key keep their hit rates.
+class RpcConsistentHashBalancer : public RpcLoadBalancer {
+   public:
+    void Update(const std::vector<RpcEndpoint *> &endpoints) override {
+        ring_.clear();
+        std::string vnode;
+        for (auto *endpoint : endpoints) {
+            // points derive from ip:port only, a weight change keeps the existing ones
+            auto host = endpoint->ip + ":" + std::to_string(endpoint->port);
+            for (std::uint32_t i = 0; i < VNODES * endpoint->weight; ++i) {
+                vnode.assign(host).append("#").append(std::to_string(i));
+                ring_.push_back({Hash(vnode), endpoint});
+            }
+        }
+        std::sort(ring_.begin(), ring_.end(),
+                  [](const point &l, const point &r) { return l.hash < r.hash; });
+    }
+
+    RpcEndpoint *Select(const Request &req) const override {
+        if (ring_.empty()) return nullptr;
+        auto key = Hash(std::string_view(reinterpret_cast<const char *>(&req.hash_key),
+                                         sizeof(req.hash_key)));
+        auto it = std::lower_bound(
+            ring_.begin(), ring_.end(), key,
+            [](const point &p, std::uint64_t hash) { return p.hash < hash; });
+        if (it == ring_.end()) it = ring_.begin();
+        return it->endpoint;
+    }
+
+    static constexpr std::uint32_t VNODES = 160;  // ring points per unit of weight
+
+   private:
+    struct point {
+        std::uint64_t hash;
+        RpcEndpoint *endpoint;
+    };
+
+    std::vector<point> ring_;  // sorted by hash
+};
+
+}  // namespace
+
+std::unique_ptr<RpcLoadBalancer> RpcLoadBalancer::New(Policy policy) {
+    switch (policy) {
+        case Policy::P2C:
+            return std::make_unique<RpcP2CBalancer>();
+        case Policy::ConsistentHash:
+            return std::make_unique<RpcConsistentHashBalancer>();
+        case Policy::RoundRobin:
+        default:
+            return std::make_unique<RpcRoundRobinBalancer>();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef _RPC_LOAD_BALANCER_H_
+#define _RPC_LOAD_BALANCER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "rpc_endpoint.h"
+
+/**
+ * Picks the backend of a call among the endpoints registered for a method, see
+ * RpcRegistry::SetLoadBalancer(). Every snapshot of a method's endpoints gets a balancer
+ * of its own: Update() is called once before the snapshot is published, after that
+ * Select() is called from any number of threads at once.
+ */
+class RpcLoadBalancer {
+   public:
+    struct Request {
+        std::uint64_t hash_key = 0;  // ConsistentHash sends equal keys to one backend
+    };
+
+    enum class Policy {
+        RoundRobin,      // smooth weighted round-robin
+        P2C,             // the less loaded of two random backends, relative to weight
+        ConsistentHash,  // ketama ring keyed by Request::hash_key
+    };
+
+    using Factory = std::function<std::unique_ptr<RpcLoadBalancer>()>;
+
+    virtual ~RpcLoadBalancer() = default;
+
+    // set the backends, they outlive the balancer
+    virtual void Update(const std::vector<RpcEndpoint *> &endpoints) = 0;
+
+    // @return the chosen backend, or nullptr if there are none. Must be thread-safe.
+    virtual RpcEndpoint *Select(const Request &req) const = 0;
+
+    static std::unique_ptr<RpcLoadBalancer> New(Policy policy);
+};
+
+#endif  // _RPC_LOAD_BALANCER_H_
@@ -4,6 +4,32 @@
 #include <llbc.h>
 #include <coroutine>
 
+// Whether the root logger outputs level. Until the logger is initialized llbc prints
+// every level to the console, Trace and Debug count as off then.
+inline bool RpcLogEnabled(int level) noexcept {
+    auto *loggerMgr = LLBC_LoggerMgrSingleton;
+    if (!loggerMgr->IsInited()) [[unlikely]] {
+        return level >= llbc::LLBC_LogLevel::Info;
+    }
+    return level >= loggerMgr->GetRootLogger()->GetLogLevel();
+}
+
+// LLOG_TRACE/DEBUG whose arguments, e.g. ToString() or DebugString(), are only
+// evaluated if the level is on. Use them on the per-call path.
+#define LAZY_TLOG(...)                                                \
+    do {                                                              \
+        if (RpcLogEnabled(llbc::LLBC_LogLevel::Trace)) [[unlikely]] { \
+            LLOG_TRACE(__VA_ARGS__);                                  \
+        }                                                             \
+    } while (false)
+
+#define LAZY_DLOG(...)                                                \
+    do {                                                              \
+        if (RpcLogEnabled(llbc::LLBC_LogLevel::Debug)) [[unlikely]] { \
+            LLOG_DEBUG(__VA_ARGS__);                                  \
+        }                                                             \
+    } while (false)
+
 #define COND_EXP(condition, expr, ...) \
     {                                  \
         if (condition) {               \
@@ -21,7 +47,7 @@
 #define COND_RET_TLOG(condition, retCode, ...) \
     {                                          \
         if (condition) {                       \
-            LLOG_TRACE(__VA_ARGS__);           \
+            LAZY_TLOG(__VA_ARGS__);            \
             return retCode;                    \
         }                                      \
     }
@@ -61,7 +87,7 @@
 #define CO_COND_RET_TLOG(condition, retCode, ...) \
     {                                             \
         if (condition) {                          \
-            LLOG_TRACE(__VA_ARGS__);              \
+            LAZY_TLOG(__VA_ARGS__);               \
             co_return retCode;                    \
         }                                         \
     }
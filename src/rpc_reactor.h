@@ -0,0 +1,26 @@
+#ifndef _RPC_REACTOR_H_
+#define _RPC_REACTOR_H_
+
+#include <cstddef>
+
+/**
+ * Index of the reactor the calling thread runs.
+ * A server serving with N reactors runs reactor 0 on the thread that calls Serve() and
+ * reactors 1..N-1 on worker threads. Each reactor owns its recv/send queues, coroutines
+ * and timers; any thread that is not a worker is reactor 0.
+ */
+class RpcReactor {
+   public:
+    // fits the reactor bits of a coro_uid
+    static constexpr std::size_t MAX_REACTORS = 256;
+
+    static std::size_t Current() noexcept { return current_; }
+
+    // bind the calling thread to a reactor, before it touches any per-reactor state
+    static void Bind(std::size_t index) noexcept { current_ = index; }
+
+   private:
+    static inline thread_local std::size_t current_ = 0;
+};
+
+#endif  // _RPC_REACTOR_H_
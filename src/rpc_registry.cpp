@@ -1,85 +1,260 @@
 #include "rpc_registry.h"
 
+#include <algorithm>
+#include <string_view>
+
 #include "rpc_macros.h"
 
+namespace {
+
+// A unix socket path may contain '/', which separates zookeeper nodes, and the
+// characters that delimit the parts of a node name, so they are escaped as %XX.
+std::string EscapePath(std::string_view path) {
+    static constexpr char HEX[] = "0123456789ABCDEF";
+    std::string escaped;
+    for (unsigned char c : path) {
+        if (c == '/' || c == '%' || c == '@' || c == '+' || c == ':') {
+            escaped += '%';
+            escaped += HEX[c >> 4];
+            escaped += HEX[c & 15];
+        } else {
+            escaped += static_cast<char>(c);
+        }
+    }
+    return escaped;
+}
+
+// @return false if escaped is malformed
+bool UnescapePath(std::string_view escaped, std::string &path) {
+    auto hex = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    };
+    path.clear();
+    for (std::size_t i = 0; i < escaped.size(); ++i) {
+        if (escaped[i] != '%') {
+            path += escaped[i];
+            continue;
+        }
+        COND_RET(i + 2 >= escaped.size(), false);
+        int hi = hex(escaped[i + 1]), lo = hex(escaped[i + 2]);
+        COND_RET(hi < 0 || lo < 0, false);
+        path += static_cast<char>(hi << 4 | lo);
+        i += 2;
+    }
+    return !path.empty();
+}
+
+}  // namespace
+
 int RpcRegistry::Connect(const std::string &url) {
-    auto ret = client_->connect(url);
-    client_->set_log_lvl(utility::zoo_log_lvl_error);
-    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED,
+    COND_RET_ELOG(client_->Connect(url) != LLBC_OK, LLBC_FAILED,
                   "RpcRegistry Connect failed, url: %s", url.c_str());
     return LLBC_OK;
 }
 
-int RpcRegistry::RegisterService(const std::string &svc_md, const std::string &addr) {
-    std::vector<utility::zoo_acl_t> acl;
-    acl.push_back(utility::zk_cpp::create_world_acl(utility::zoo_perm_all));
-    auto path = "/" + svc_md;
-    auto ret = client_->create_persistent_node(path.c_str(), "", acl);
-    COND_RET_ELOG(ret != utility::z_node_exists && ret != utility::z_ok, LLBC_FAILED,
-                  "RegisterService failed, svc_md: %s, addr: %s, ret: %d", svc_md.c_str(),
-                  addr.c_str(), ret);
+int RpcRegistry::RegisterService(const std::string &svc_md, const std::string &addr,
+                                 std::uint32_t weight, const std::string &host) {
+    return RegisterServices({svc_md}, addr, weight, host);
+}
 
-    ret = client_->create_ephemeral_node((path + "/" + addr).c_str(), "", acl);
-    COND_RET_ELOG(ret != utility::z_node_exists && ret != utility::z_ok, LLBC_FAILED,
-                  "RegisterService failed, svc_md: %s, addr: %s, ret: %d", svc_md.c_str(),
-                  addr.c_str(), ret);
+int RpcRegistry::RegisterServices(const std::vector<std::string> &svc_mds,
+                                  const std::string &addr, std::uint32_t weight,
+                                  const std::string &host) {
+    auto node = addr;
+    if (RpcEndpoint::IsUnix(addr)) {
+        node = std::string(RpcEndpoint::UNIX_PREFIX) +
+               EscapePath(std::string_view(addr).substr(RpcEndpoint::UNIX_PREFIX.size()));
+    }
+    if (weight != 1) node += "@" + std::to_string(weight);
+    if (!host.empty()) node += "+" + host;
+    // each method's node is created right before its backend, in the same batch
+    std::vector<RpcRegistryClient::node> nodes;
+    nodes.reserve(svc_mds.size() * 2);
+    for (const auto &svc_md : svc_mds) {
+        auto path = "/" + svc_md;
+        nodes.push_back({path, false});
+        nodes.push_back({path + "/" + node, true});
+    }
 
+    COND_RET_ELOG(client_->CreateNodes(nodes) != LLBC_OK, LLBC_FAILED,
+                  "RegisterServices failed, methods: %lu, addr: %s", svc_mds.size(),
+                  addr.c_str());
     return LLBC_OK;
 }
 
-int RpcRegistry::InitServices(const std::string &svc_md) {
-    if (services.find(svc_md) != services.end()) {
-        return LLBC_OK;
+RpcRegistry::RpcRegistry(std::unique_ptr<RpcRegistryClient> client)
+    : client_(client ? std::move(client) : std::make_unique<RpcZkRegistryClient>()),
+      services_(std::make_shared<const service_map>()) {}
+
+void RpcRegistry::SetLoadBalancer(const std::string &svc_md,
+                                  RpcLoadBalancer::Factory factory) {
+    std::lock_guard<std::mutex> lock(writers_mutex_);
+    if (svc_md.empty()) {
+        default_balancer_ = std::move(factory);
+    } else {
+        balancers_[svc_md] = std::move(factory);
+    }
+
+    // rebuild the affected snapshots with the same endpoints
+    for (const auto &[name, svc] : *services_.load(std::memory_order_relaxed)) {
+        if (!svc_md.empty() && name != svc_md) {
+            continue;
+        }
+        std::vector<std::string> children;
+        auto current = svc->current.load(std::memory_order_relaxed);
+        for (const auto &endpoint : current->endpoints) {
+            children.push_back(endpoint->name);
+        }
+        Publish(name, *svc, children);
+    }
+}
+
+std::shared_ptr<RpcEndpoint> RpcRegistry::SelectEndpoint(
+    const std::string &svc_md, const RpcLoadBalancer::Request &req) {
+    std::shared_ptr<service> svc;
+    auto services = services_.load(std::memory_order_acquire);
+    if (auto it = services->find(svc_md); it != services->end()) {
+        svc = it->second;
+    } else {
+        std::lock_guard<std::mutex> lock(writers_mutex_);
+        svc = InitService(svc_md);
+        COND_RET(!svc, nullptr);
+    }
+
+    auto snap = svc->current.load(std::memory_order_acquire);
+    auto *endpoint = snap->balancer->Select(req);
+    COND_RET(!endpoint, nullptr);
+    // shares ownership of the snapshot, which owns the endpoint
+    return std::shared_ptr<RpcEndpoint>(snap, endpoint);
+}
+
+std::shared_ptr<RpcRegistry::service> RpcRegistry::InitService(
+    const std::string &svc_md) {
+    auto services = services_.load(std::memory_order_relaxed);
+    // looked up by another thread in the meantime
+    if (auto it = services->find(svc_md); it != services->end()) {
+        return it->second;
     }
+
     std::vector<std::string> children;
     auto path = "/" + svc_md;
-    auto ret = client_->get_children(path.c_str(), children, false);
-    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED, "InitServices failed, svc_md: %s",
-                  svc_md.c_str());
-    for (int i = 0; i < children.size(); i++) {
-        LLOG_INFO("Child[%d]: %s", i, children[i].c_str());
-    }
-    services[svc_md] = children;
-
-    ret = client_->watch_children_event(
-        path.c_str(),
-        [](const std::string &path, const std::vector<std::string> &children) {
-            LLOG_INFO("Child_change_events, path:%s, new_child_count:%d", path.c_str(),
-                      (int32_t)children.size());
-            for (int i = 0; i < children.size(); i++) {
-                LLOG_INFO("Child[%d]: %s", i, children[i].c_str());
-            }
+    auto ret = client_->WatchChildren(
+        path,
+        [this, svc_md](const std::vector<std::string> &children) {
+            OnChildrenChange(svc_md, children);
         },
-        &services[svc_md]);
-    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED,
-                  "InitServices failed, failed to set watcher, svc_md: %s",
+        children);
+    COND_RET_ELOG(ret != LLBC_OK, nullptr,
+                  "InitService failed, failed to get or watch children, svc_md: %s",
                   svc_md.c_str());
 
-    return LLBC_OK;
+    auto svc = std::make_shared<service>();
+    Publish(svc_md, *svc, children);
+
+    auto updated = std::make_shared<service_map>(*services);
+    updated->emplace(svc_md, svc);
+    services_.store(std::move(updated), std::memory_order_release);
+    return svc;
+}
+
+void RpcRegistry::OnChildrenChange(const std::string &svc_md,
+                                   const std::vector<std::string> &children) {
+    std::lock_guard<std::mutex> lock(writers_mutex_);
+    auto services = services_.load(std::memory_order_relaxed);
+    auto it = services->find(svc_md);
+    COND_RET(it == services->end(), );
+    Publish(svc_md, *it->second, children);
 }
 
-RpcRegistry::ServiceAddr RpcRegistry::ParseServiceAddr(const std::string &svc_md,
-                                                       const std::string &path) {
-    LLOG_INFO("ParseServiceAddr: svc_md: %s, path: %s", svc_md.c_str(), path.c_str());
-    // parse ip:port
-    auto pos = path.find(':');
-    if (pos == std::string::npos) {
-        return {};
+void RpcRegistry::Publish(const std::string &svc_md, service &svc,
+                          const std::vector<std::string> &children) {
+    std::unordered_map<std::string_view, std::shared_ptr<RpcEndpoint>> existing;
+    if (auto current = svc.current.load(std::memory_order_relaxed)) {
+        for (const auto &endpoint : current->endpoints) {
+            existing.emplace(endpoint->name, endpoint);
+        }
     }
-    auto ip = path.substr(0, pos);
-    auto port = std::stoi(path.substr(pos + 1));
-    return {ip, port};
+
+    auto snap = std::make_shared<snapshot>();
+    std::vector<RpcEndpoint *> endpoints;
+    std::size_t added = 0;
+    for (const auto &child : children) {
+        std::shared_ptr<RpcEndpoint> endpoint;
+        if (auto it = existing.find(child); it != existing.end()) {
+            endpoint = it->second;
+        } else if ((endpoint = ParseEndpoint(child))) {
+            ++added;
+        } else {
+            LLOG_WARN("Publish: malformed endpoint ignored, svc_md: %s, node: %s",
+                      svc_md.c_str(), child.c_str());
+            continue;
+        }
+        endpoints.push_back(endpoint.get());
+        snap->endpoints.push_back(std::move(endpoint));
+    }
+
+    auto it = balancers_.find(svc_md);
+    const auto &factory = it != balancers_.end() ? it->second : default_balancer_;
+    if (factory) {
+        snap->balancer = factory();
+    }
+    if (!snap->balancer) {
+        snap->balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::RoundRobin);
+    }
+    snap->balancer->Update(endpoints);
+
+    LLOG_INFO("Publish: svc_md: %s, endpoints: %lu, added: %lu, removed: %lu",
+              svc_md.c_str(), snap->endpoints.size(), added,
+              existing.size() - (snap->endpoints.size() - added));
+    svc.current.store(std::move(snap), std::memory_order_release);
 }
 
-RpcRegistry::ServiceAddr RpcRegistry::GetRandomService(const std::string &svc_md) {
-    if (InitServices(svc_md) != LLBC_OK) {
-        return {};
+std::shared_ptr<RpcEndpoint> RpcRegistry::ParseEndpoint(
+    const std::string &name) noexcept {
+    // the host id comes last and has no ':', so the port's colon is the last before it
+    auto plus = name.find('+');
+    auto end = plus == std::string::npos ? name.size() : plus;
+    auto colon = name.rfind(':', end);
+    COND_RET(colon == std::string::npos || colon == 0 || end == name.size() - 1, nullptr);
+    // an escaped unix socket path has no ':', its prefix ends with the only one
+    bool unix_socket = RpcEndpoint::IsUnix(name);
+    if (unix_socket) colon = RpcEndpoint::UNIX_PREFIX.size() - 1;
+    auto at = name.find('@', colon);
+    if (at > end) at = std::string::npos;
+
+    // digits of [begin, end) as a number, -1 if there are none or anything else
+    auto parse = [&name](std::size_t begin, std::size_t end) -> long {
+        COND_RET(begin >= end || end - begin > 9, -1);
+        long value = 0;
+        for (auto i = begin; i < end; ++i) {
+            COND_RET(name[i] < '0' || name[i] > '9', -1);
+            value = value * 10 + (name[i] - '0');
+        }
+        return value;
+    };
+
+    auto addr_end = at == std::string::npos ? end : at;
+    long port = 0;
+    std::string path;
+    if (unix_socket) {
+        auto escaped = std::string_view(name).substr(colon + 1, addr_end - colon - 1);
+        COND_RET(!UnescapePath(escaped, path), nullptr);
+    } else {
+        port = parse(colon + 1, addr_end);
+        COND_RET(port <= 0 || port > 65535, nullptr);
     }
-    if (services[svc_md].empty()) {
-        return {};
+    long weight = 1;
+    if (at != std::string::npos) {
+        weight = parse(at + 1, end);
+        COND_RET(weight <= 0, nullptr);
     }
-    LLOG_INFO("GetRandomService: svc_md: %s, service_count: %d", svc_md.c_str(),
-              (int32_t)services[svc_md].size());
-    auto idx = rand() % services[svc_md].size();
-    return ParseServiceAddr(svc_md, services[svc_md][idx]);
-}
\ No newline at end of file
+
+    auto endpoint = std::make_shared<RpcEndpoint>();
+    endpoint->name = name;
+    endpoint->ip = unix_socket ? std::string(RpcEndpoint::UNIX_PREFIX) + path
+                               : name.substr(0, colon);
+    endpoint->port = static_cast<int>(port);
+    endpoint->weight = static_cast<std::uint32_t>(std::min<long>(weight, MAX_WEIGHT));
+    if (plus != std::string::npos) endpoint->host = name.substr(plus + 1);
+    return endpoint;
+}
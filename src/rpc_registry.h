@@ -1,32 +1,89 @@
 #ifndef _RPC_REGISTRY_H_
 #define _RPC_REGISTRY_H_
 
-#include "zk/zk_cpp.h"  // TODO: check
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
+#include "rpc_endpoint.h"
+#include "rpc_load_balancer.h"
+#include "rpc_registry_client.h"
+
+/**
+ * Service discovery over zookeeper. The endpoints of a method are cached in an immutable
+ * snapshot together with their load balancer. Picking a backend loads the current
+ * snapshot and asks its balancer, without locks or parsing. A zookeeper watch keeps the
+ * cache up to date: on every change a new snapshot is built, reusing the endpoints that
+ * are still registered with their channels, and swapped in. Readers still holding the
+ * old snapshot keep it alive until they are done.
+ */
 class RpcRegistry {
    public:
-    struct ServiceAddr {
-        std::string ip;
-        int port = 0;
-    };
+    // runs on client, or on zookeeper if there is none
+    explicit RpcRegistry(std::unique_ptr<RpcRegistryClient> client = nullptr);
+    // closes the zookeeper session first, so no watch fires into a half destroyed one
+    ~RpcRegistry() { client_.reset(); }
+
+    int Connect(const std::string &url);
 
-    static ServiceAddr ParseServiceAddr(const std::string &svc_md,
-                                        const std::string &path);
+    // Register addr ("ip:port" or "unix:/path") as a backend of svc_md, weighted for
+    // the load balancers.
+    // host: RpcShmTransport::HostID() if clients on the host may link over shared memory
+    int RegisterService(const std::string &svc_md, const std::string &addr,
+                        std::uint32_t weight = 1, const std::string &host = "");
 
-    RpcRegistry() : client_(std::make_unique<utility::zk_cpp>()) {};
-    ~RpcRegistry() {};
+    // Register addr as a backend of every method in svc_mds, with one round trip to
+    // zookeeper however many methods there are.
+    int RegisterServices(const std::vector<std::string> &svc_mds, const std::string &addr,
+                         std::uint32_t weight = 1, const std::string &host = "");
 
-    int Connect(const std::string &url);
+    // Balance svc_md with balancers made by factory, or every method without a balancer
+    // of its own if svc_md is empty. The default balances round-robin.
+    void SetLoadBalancer(const std::string &svc_md, RpcLoadBalancer::Factory factory);
+
+    // Pick a backend of svc_md with its load balancer. The first call for a method looks
+    // its endpoints up in zookeeper and starts watching them.
+    // @return the endpoint, or nullptr if there is none
+    std::shared_ptr<RpcEndpoint> SelectEndpoint(const std::string &svc_md,
+                                                const RpcLoadBalancer::Request &req = {});
 
-    int RegisterService(const std::string &svc_md, const std::string &addr);
-    int InitServices(const std::string &svc_md);
+    // parse a registry node name, "ip:port" or "unix:" and an escaped path, optionally
+    // followed by "@weight" and "+host"
+    // @return the endpoint, or nullptr if the name is malformed
+    static std::shared_ptr<RpcEndpoint> ParseEndpoint(const std::string &name) noexcept;
 
-    ServiceAddr GetRandomService(const std::string &svc_md);
+    static constexpr std::uint32_t MAX_WEIGHT = 100;  // larger weights are clamped
 
    private:
-    std::unique_ptr<utility::zk_cpp> client_;
-    std::unordered_map<std::string, std::vector<std::string>>
-        services;  // svc_md -> service_addrs
+    // endpoints of a method and their balancer, immutable once published
+    struct snapshot {
+        std::vector<std::shared_ptr<RpcEndpoint>> endpoints;
+        std::unique_ptr<RpcLoadBalancer> balancer;
+    };
+
+    struct service {
+        std::atomic<std::shared_ptr<const snapshot>> current;
+    };
+
+    using service_map = std::unordered_map<std::string, std::shared_ptr<service>>;
+
+    // look svc_md up and watch it, writers_mutex_ must be held
+    std::shared_ptr<service> InitService(const std::string &svc_md);
+    // children of svc_md changed
+    void OnChildrenChange(const std::string &svc_md,
+                          const std::vector<std::string> &children);
+    // Publish a snapshot of children, reusing the endpoints of the current one.
+    // writers_mutex_ must be held.
+    void Publish(const std::string &svc_md, service &svc,
+                 const std::vector<std::string> &children);
+
+    std::unique_ptr<RpcRegistryClient> client_;
+    std::atomic<std::shared_ptr<const service_map>> services_;  // replaced on insert
+    std::mutex writers_mutex_;  // serializes updates of services_, snapshots and below
+    std::unordered_map<std::string, RpcLoadBalancer::Factory>
+        balancers_;  // svc_md -> balancer factory
+    RpcLoadBalancer::Factory default_balancer_;
 };
 
-#endif  // _RPC_REGISTRY_H_
\ No newline at end of file
+#endif  // _RPC_REGISTRY_H_
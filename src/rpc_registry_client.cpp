@@ -0,0 +1,55 @@
+#include "rpc_registry_client.h"
+
+#include "rpc_macros.h"
+#include "zk/zk_cpp.h"
+
+RpcZkRegistryClient::RpcZkRegistryClient()
+    : client_(std::make_unique<utility::zk_cpp>()) {}
+
+RpcZkRegistryClient::~RpcZkRegistryClient() = default;
+
+int RpcZkRegistryClient::Connect(const std::string &url) {
+    auto ret = client_->connect(url);
+    client_->set_log_lvl(utility::zoo_log_lvl_error);
+    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED, "Connect failed, url: %s, ret: %d",
+                  url.c_str(), ret);
+    return LLBC_OK;
+}
+
+int RpcZkRegistryClient::CreateNodes(const std::vector<node> &nodes) {
+    std::vector<utility::zoo_acl_t> acl;
+    acl.push_back(utility::zk_cpp::create_world_acl(utility::zoo_perm_all));
+
+    std::vector<utility::zoo_create_op_t> ops;
+    ops.reserve(nodes.size());
+    for (const auto &n : nodes) {
+        ops.push_back({n.path, "",
+                       n.ephemeral ? utility::zoo_create_ephemeral
+                                   : utility::zoo_create_persistent});
+    }
+
+    std::vector<utility::zoo_rc> results;
+    auto ret = client_->create_nodes(ops, acl, results);
+    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED,
+                  "CreateNodes failed to send, nodes: %lu, ret: %d", nodes.size(), ret);
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        COND_RET_ELOG(results[i] != utility::z_ok && results[i] != utility::z_node_exists,
+                      LLBC_FAILED, "CreateNodes failed, path: %s, ret: %d",
+                      nodes[i].path.c_str(), results[i]);
+    }
+    return LLBC_OK;
+}
+
+int RpcZkRegistryClient::WatchChildren(const std::string &path, children_handler handler,
+                                       std::vector<std::string> &children) {
+    auto ret = client_->watch_children_event(
+        path.c_str(),
+        [handler = std::move(handler)](const std::string &,
+                                       const std::vector<std::string> &children) {
+            handler(children);
+        },
+        &children);
+    COND_RET_ELOG(ret != utility::z_ok, LLBC_FAILED,
+                  "WatchChildren failed, path: %s, ret: %d", path.c_str(), ret);
+    return LLBC_OK;
+}
@@ -0,0 +1,56 @@
+#ifndef _RPC_REGISTRY_CLIENT_H_
+#define _RPC_REGISTRY_CLIENT_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utility {
+class zk_cpp;
+}
+
+/**
+ * Node store RpcRegistry runs on: zookeeper, or an in-process fake in the tests.
+ * Methods return LLBC_OK or LLBC_FAILED.
+ */
+class RpcRegistryClient {
+   public:
+    struct node {
+        std::string path;
+        bool ephemeral = false;  // removed when the client's session ends
+    };
+
+    // new children of a watched node
+    using children_handler = std::function<void(const std::vector<std::string> &)>;
+
+    virtual ~RpcRegistryClient() = default;
+
+    virtual int Connect(const std::string &url) = 0;
+
+    // Create nodes in order, with one round trip for the whole batch. A parent may come
+    // before its children in the same batch. Nodes that already exist count as created.
+    virtual int CreateNodes(const std::vector<node> &nodes) = 0;
+
+    // Get the children of path into children, and call handler with the new children on
+    // every later change, from the client's own thread.
+    virtual int WatchChildren(const std::string &path, children_handler handler,
+                              std::vector<std::string> &children) = 0;
+};
+
+// RpcRegistryClient over utility::zk_cpp
+class RpcZkRegistryClient : public RpcRegistryClient {
+   public:
+    RpcZkRegistryClient();
+    ~RpcZkRegistryClient() override;
+
+    int Connect(const std::string &url) override;
+    int CreateNodes(const std::vector<node> &nodes) override;
+    int WatchChildren(const std::string &path, children_handler handler,
+                      std::vector<std::string> &children) override;
+
+   private:
+    std::unique_ptr<utility::zk_cpp> client_;
+};
+
+#endif  // _RPC_REGISTRY_CLIENT_H_
@@ -3,8 +3,11 @@
 #include <llbc.h>
 
 #include <csignal>
+#include <thread>
+#include <vector>
 
 #include "rpc_conn_mgr.h"
+#include "rpc_reactor.h"
 #include "rpc_service_mgr.h"
 
 RpcServer::~RpcServer() { Stop(); }
@@ -15,7 +18,8 @@ void RpcServer::SignalHandler(int signum) {
     RpcServer::GetInst().Stop();
 }
 
-int RpcServer::Init() noexcept {
+int RpcServer::Init(std::size_t reactors) noexcept {
+    reactor_num_ = reactors;
     RpcClient::Init();
 
     // register signal SIGINT and signal handler
@@ -24,19 +28,24 @@ int RpcServer::Init() noexcept {
     return LLBC_OK;
 }
 
-RpcChannel *RpcServer::RegisterRpcChannel(const std::string &svc_md) {
+RpcChannel *RpcServer::RegisterRpcChannel(const std::string &svc_md,
+                                          std::uint64_t hash_key) {
     if (stop_) {
         std::cout << "RpcServer not started.\n";
         return nullptr;
     }
-    return RpcServiceMgr::GetInst().RegisterRpcChannel(svc_md);
+    return RpcServiceMgr::GetInst().RegisterRpcChannel(svc_md, hash_key);
 }
 
-int RpcServer::Listen(const char *ip, int port) {
+int RpcServer::Listen(const char *ip, int port, std::uint32_t weight) {
     if (!initialized_) {
         std::cout << "RpcServer not initialized.\n";
         return LLBC_FAILED;
     }
+    if (weight == 0) {
+        std::cout << "RpcServer weight must be positive.\n";
+        return LLBC_FAILED;
+    }
     if (!stop_) {
         std::cout << "RpcServer is already listening.\n";
         return LLBC_FAILED;
@@ -50,6 +59,7 @@ int RpcServer::Listen(const char *ip, int port) {
         Stop();
         return LLBC_FAILED;
     }
+    RpcServiceMgr::GetInst().SetWeight(weight);
     return LLBC_OK;
 }
 
@@ -59,6 +69,7 @@ void RpcServer::Stop() {
         return;
     }
     stop_ = true;
+    RpcConnMgr::GetInst().WakeAll();
     LLOG_TRACE("Server Stop Set.");
 }
 
@@ -68,6 +79,17 @@ void RpcServer::AddService(::google::protobuf::Service *service) {
     }
 }
 
+void RpcServer::AddService(RpcService *service) {
+    if (RpcServiceMgr::GetInst().AddService(service) != LLBC_OK) {
+        LLOG_ERROR("AddService: add service failed");
+    }
+}
+
+int RpcServer::SetConcurrencyLimiter(const std::string &svc_md,
+                                     const RpcConcurrencyLimiter::Options &options) {
+    return RpcServiceMgr::GetInst().SetConcurrencyLimiter(svc_md, options);
+}
+
 void RpcServer::Serve() {
     if (stop_) {
         std::cout << "RpcServer not started.\n";
@@ -76,10 +98,22 @@ void RpcServer::Serve() {
 
     LLOG_INFO(">>> RPC SERVER START SERVING <<<");
 
-    LLOG_TRACE("START LOOP");
+    LLOG_TRACE("START LOOP|reactors: %lu", reactor_num_);
 
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < reactor_num_; ++i) {
+        workers.emplace_back([this, i]() {
+            RpcReactor::Bind(i);
+            while (!stop_) {
+                RpcClient::Update(IDLE_WAIT);
+            }
+        });
+    }
     while (!stop_) {
-        RpcClient::Update();
+        RpcClient::Update(IDLE_WAIT);
+    }
+    for (auto &worker : workers) {
+        worker.join();
     }
 
     LLOG_INFO(">>> RPC SERVER STOP SERVING <<<");
@@ -4,17 +4,27 @@
 #include <google/protobuf/service.h>
 #include <singleton.h>
 
+#include <atomic>
+
 #include "rpc_client.h"
+#include "rpc_concurrency_limiter.h"
 
 class RpcChannel;
+class RpcService;
 
 /**
  * To use this class, you must first call Init() to initialize the server. \\
  * Then, you can optionally call SetLogConfPath() to set the path of the log configuration
  * file. \\
- * Then, you can call Listen() to start listening on a specific port. \\
+ * Then, you can call Listen() to start listening on a specific port, or with an ip of
+ * "unix:/path" on a unix socket, which clients on the same host reach over shared
+ * memory. Its weight sets the server's share of the calls clients' load balancers spread
+ * over the backends of a method, see RpcLoadBalancer. \\
  * You can also call AddService() to add  service implementation to the server. \\
  * Finally, you can call Serve() to start serving requests. \\
+ * Init(n) serves with n reactors: Serve() runs reactor 0 and starts n - 1 worker threads.
+ * Sessions are sharded across reactors, and each handles its own requests, coroutines and
+ * timers. Services must be thread-compatible when n > 1. \\
  */
 class RpcServer : public RpcClient, public Singleton<RpcServer> {
     friend class Singleton<RpcServer>;
@@ -22,21 +32,29 @@ class RpcServer : public RpcClient, public Singleton<RpcServer> {
    public:
     virtual ~RpcServer();
 
-    int Init() noexcept;
+    int Init(std::size_t reactors = 1) noexcept;
 
-    RpcChannel *RegisterRpcChannel(const std::string &);
-    int Listen(const char *ip, int port);
+    RpcChannel *RegisterRpcChannel(const std::string &, std::uint64_t hash_key = 0);
+    // weight: 1 to RpcRegistry::MAX_WEIGHT, larger weights are clamped
+    int Listen(const char *ip, int port, std::uint32_t weight = 1);
     void Stop();
     void Serve();
 
     static void AddService(::google::protobuf::Service *service);
+    static void AddService(RpcService *service);
+    // see RpcServiceMgr::SetConcurrencyLimiter(), call after AddService()
+    static int SetConcurrencyLimiter(const std::string &svc_md,
+                                     const RpcConcurrencyLimiter::Options &options);
+
+    // longest idle wait of a reactor loop, it bounds how late Stop() is noticed
+    static constexpr llbc::sint64 IDLE_WAIT = 100;
 
    protected:
     RpcServer() = default;
 
     static void SignalHandler(int signum);
 
-    bool stop_ = true;
+    std::atomic<bool> stop_{true};
 };
 
 #endif  // _RPC_SERVER_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef _RPC_SERVICE_H_
+#define _RPC_SERVICE_H_
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/service.h>
+
+#include <span>
+
+class RpcController;
+
+/**
+ * Base of the service skeletons generated by protoc-gen-rpc.
+ * Instead of the virtual CallMethod() of ::google::protobuf::Service, a generated service
+ * exposes a table with one entry per method, holding the request/response prototypes and a
+ * typed invoker. RpcServiceMgr resolves the entry once in AddService(), so dispatching a
+ * request is a single indirect call into the implementation.
+ */
+class RpcService {
+   public:
+    using Invoker = void (*)(RpcService *service, RpcController *controller,
+                             const ::google::protobuf::Message *request,
+                             ::google::protobuf::Message *response,
+                             ::google::protobuf::Closure *done);
+
+    struct Method {
+        const ::google::protobuf::MethodDescriptor *md = nullptr;
+        const ::google::protobuf::Message *request_prototype = nullptr;
+        const ::google::protobuf::Message *response_prototype = nullptr;
+        Invoker invoke = nullptr;
+    };
+
+    virtual ~RpcService() = default;
+
+    virtual const ::google::protobuf::ServiceDescriptor *GetDescriptor()
+        const noexcept = 0;
+
+    // method table, in the order of the service descriptor
+    virtual std::span<const Method> GetMethods() const noexcept = 0;
+};
+
+#endif  // _RPC_SERVICE_H_
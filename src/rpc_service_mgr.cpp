@@ -8,9 +8,13 @@
 #include "rpc_controller.h"
 #include "rpc_coro_mgr.h"
 #include "rpc_macros.h"
+#include "rpc_stats.h"
 
-int RpcServiceMgr::Init(RpcConnMgr *conn_mgr) noexcept {
+int RpcServiceMgr::Init(RpcConnMgr *conn_mgr, std::size_t max_sessions,
+                        std::unique_ptr<RpcRegistryClient> registry) noexcept {
+    COND_RET_ELOG(max_sessions == 0, LLBC_FAILED, "Init: max_sessions must be positive");
     conn_mgr_ = conn_mgr;
+    max_sessions_ = max_sessions;
     if (conn_mgr_) [[likely]] {
         conn_mgr_->Subscribe(RpcChannel::RpcOpCode::RpcReq,
                              llbc::LLBC_Delegate<void(llbc::LLBC_Packet &)>(
@@ -19,7 +23,7 @@ int RpcServiceMgr::Init(RpcConnMgr *conn_mgr) noexcept {
                              llbc::LLBC_Delegate<void(llbc::LLBC_Packet &)>(
                                  this, &RpcServiceMgr::HandleRpcRsp));
     }
-    registry_ = std::make_unique<RpcRegistry>();
+    registry_ = std::make_unique<RpcRegistry>(std::move(registry));
     return registry_->Connect("127.0.0.1:2181");
 }
 
@@ -27,35 +31,127 @@ RpcServiceMgr::~RpcServiceMgr() {}
 
 int RpcServiceMgr::AddService(::google::protobuf::Service *service) noexcept {
     const auto *service_desc = service->GetDescriptor();
+    std::vector<ServiceInfo> infos;
     for (int i = 0; i < service_desc->method_count(); ++i) {
         auto *method_desc = service_desc->method(i);
-        service_methods_[service_desc->name()][method_desc->name()] =
-            ServiceInfo{service, method_desc};
-        // register service to zookeeper
-        LLOG_TRACE("RpcServiceMgr AddService: %s.%s, IP: %s",
-                   service_desc->name().c_str(), method_desc->name().c_str(),
-                   conn_mgr_->GetIP().c_str());
-        auto ret = registry_->RegisterService(
-            service_desc->name() + "." + method_desc->name(), conn_mgr_->GetIP());
-        COND_RET(ret != LLBC_OK, ret);
-    }
-    return LLBC_OK;
+        infos.push_back({
+            .service = service,
+            .md = method_desc,
+            .request_prototype = &service->GetRequestPrototype(method_desc),
+            .response_prototype = &service->GetResponsePrototype(method_desc),
+        });
+    }
+    return AddMethods(infos);
+}
+
+int RpcServiceMgr::AddService(RpcService *service) noexcept {
+    std::vector<ServiceInfo> infos;
+    for (const auto &method : service->GetMethods()) {
+        infos.push_back({
+            .rpc_service = service,
+            .md = method.md,
+            .request_prototype = method.request_prototype,
+            .response_prototype = method.response_prototype,
+            .invoke = method.invoke,
+        });
+    }
+    return AddMethods(infos);
+}
+
+int RpcServiceMgr::AddMethods(const std::vector<ServiceInfo> &infos) noexcept {
+    // check every method before adding any, so a collision leaves the service out whole
+    for (std::size_t i = 0; i < infos.size(); ++i) {
+        const auto *method_desc = infos[i].md;
+        auto method_id = RpcChannel::MethodID(method_desc);
+        auto it = service_methods_.find(method_id);
+        const auto *other = it != service_methods_.end() ? it->second.md : nullptr;
+        for (std::size_t j = 0; j < i && !other; ++j) {
+            if (RpcChannel::MethodID(infos[j].md) == method_id) other = infos[j].md;
+        }
+        COND_RET_ELOG(other && other != method_desc, LLBC_FAILED,
+                      "AddService: method id collision|id: %u|%s vs %s", method_id,
+                      method_desc->full_name().c_str(), other->full_name().c_str());
+    }
+
+    std::vector<std::string> svc_mds;
+    for (const auto &info : infos) {
+        const auto *method_desc = info.md;
+        auto method_id = RpcChannel::MethodID(method_desc);
+        auto [it, inserted] = service_methods_.emplace(method_id, info);
+        if (inserted) {
+            it->second.stats = RpcStats::GetInst().Get(RpcStats::Server, method_id,
+                                                       method_desc->full_name());
+        }
+        svc_mds.push_back(method_desc->service()->name() + "." + method_desc->name());
+    }
+    return RegisterMethods(svc_mds);
+}
+
+int RpcServiceMgr::RegisterMethods(const std::vector<std::string> &svc_mds) noexcept {
+    COND_RET(svc_mds.empty(), LLBC_OK);
+    // register service to zookeeper, all methods in one round trip
+    LLOG_TRACE("RpcServiceMgr AddService: %s and %lu more, IP: %s", svc_mds[0].c_str(),
+               svc_mds.size() - 1, conn_mgr_->GetIP().c_str());
+    // clients on this host reach the service over shared memory if it is advertised
+    auto host = conn_mgr_->ShmListening() ? RpcShmTransport::HostID() : std::string();
+    return registry_->RegisterServices(svc_mds, conn_mgr_->GetIP(), weight_, host);
+}
+
+void RpcServiceMgr::SetLoadBalancer(const std::string &svc_md,
+                                    RpcLoadBalancer::Factory factory) noexcept {
+    registry_->SetLoadBalancer(svc_md, std::move(factory));
+}
+
+int RpcServiceMgr::SetConcurrencyLimiter(
+    const std::string &svc_md, const RpcConcurrencyLimiter::Options &options) noexcept {
+    if (svc_md.empty()) {
+        limiter_ = std::make_unique<RpcConcurrencyLimiter>(options);
+        return LLBC_OK;
+    }
+    for (auto &[method_id, info] : service_methods_) {
+        if (info.md->service()->name() + "." + info.md->name() == svc_md) {
+            info.limiter = std::make_shared<RpcConcurrencyLimiter>(options);
+            return LLBC_OK;
+        }
+    }
+    LLOG_ERROR("SetConcurrencyLimiter: method not found|svc_md:%s", svc_md.c_str());
+    return LLBC_FAILED;
 }
 
-RpcChannel *RpcServiceMgr::RegisterRpcChannel(const std::string &svc_md) noexcept {
-    auto [ip, port] = registry_->GetRandomService(svc_md);
-    COND_RET_ELOG(ip == "" || port == 0, nullptr,
-                  "RegisterRpcChannel: service not found|svc_md:%s", svc_md.c_str());
-    auto key = ip + ":" + std::to_string(port);
-    if (auto it = channels_.find(key); it != channels_.end()) {
-        return it->second;
+RpcChannel *RpcServiceMgr::RegisterRpcChannel(const std::string &svc_md,
+                                              std::uint64_t hash_key) noexcept {
+    auto endpoint = registry_->SelectEndpoint(svc_md, {.hash_key = hash_key});
+    COND_RET_ELOG(!endpoint, nullptr, "RegisterRpcChannel: service not found|svc_md:%s",
+                  svc_md.c_str());
+    // fast path, the endpoint remembers its channel
+    if (auto *channel = endpoint->channel.load(std::memory_order_acquire)) {
+        return channel;
     }
-    auto *channel = conn_mgr_->CreateRpcChannel(ip.c_str(), port);
-    if (channel)
+
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    if (auto *channel = endpoint->channel.load(std::memory_order_relaxed)) {
+        return channel;
+    }
+    // the same backend may serve other methods, or have been registered before
+    auto key = endpoint->ip + ":" + std::to_string(endpoint->port);
+    auto it = channels_.find(key);
+    RpcChannel *channel = nullptr;
+    if (it != channels_.end()) {
+        channel = it->second;
+    } else {
+        // a backend on this host gets a shared memory link, or tcp if that fails
+        bool shm = !endpoint->host.empty() && endpoint->host == RpcShmTransport::HostID();
+        COND_RET_ELOG(RpcEndpoint::IsUnix(endpoint->ip) && !shm, nullptr,
+                      "RegisterRpcChannel: unix socket of another host|svc_md:%s|%s",
+                      svc_md.c_str(), endpoint->name.c_str());
+        channel = conn_mgr_->CreateRpcChannel(endpoint->ip.c_str(), endpoint->port,
+                                              max_sessions_, shm);
+        COND_RET_ELOG(!channel, nullptr,
+                      "RegisterRpcChannel: create channel failed|ip:%s|port:%d",
+                      endpoint->ip.c_str(), endpoint->port);
         channels_[key] = channel;
-    else
-        LLOG_ERROR("RegisterRpcChannel: create channel failed|ip:%s|port:%d", ip.c_str(),
-                   port);
+    }
+    endpoint->channel.store(channel, std::memory_order_release);
     return channel;
 }
 
@@ -64,48 +160,76 @@ void RpcServiceMgr::HandleRpcReq(llbc::LLBC_Packet &packet) noexcept {
     int ret = pkg_head.FromPacket(packet);
     COND_RET_ELOG(ret != 0, , "HandleRpcReq: pkg_head.FromPacket failed|ret:%d", ret);
 
-    auto it = service_methods_.find(pkg_head.service_name);
+    auto it = service_methods_.find(pkg_head.method_id);
     COND_RET_ELOG(it == service_methods_.end(), ,
-                  "HandleRpcReq: service not found|service_name:%s",
-                  pkg_head.service_name.c_str());
-    auto iter = it->second.find(pkg_head.method_name);
-    COND_RET_ELOG(iter == it->second.end(), ,
-                  "HandleRpcReq: method not found|method_name:%s",
-                  pkg_head.method_name.c_str());
+                  "HandleRpcReq: method not found|method_id:%u", pkg_head.method_id);
 
-    auto *service = iter->second.service;
-    const auto *md = iter->second.md;
+    const auto &info = it->second;
+    const auto *md = info.md;
+    auto *stats = info.stats;
+
+    // the packet carries its receive time in microseconds, see RpcConnComp
+    auto start_us = llbc::LLBC_GetMicroSeconds();
+    stats->Begin(start_us - packet.GetExtData1());
+
+    // drop requests whose caller has already given up
+    llbc::sint64 deadline = 0;
+    if (pkg_head.timeout > 0) {
+        deadline = packet.GetExtData1() / 1000 + pkg_head.timeout;
+        COND_RET_WLOG(llbc::LLBC_GetMilliSeconds() >= deadline, stats->End(-1, true),
+                      "HandleRpcReq: deadline exceeded, dropped|method:%s|seq:%lu",
+                      md->full_name().c_str(), pkg_head.seq);
+    }
+
+    // shed the request before any work if the server or the method is at its limit
+    auto *limiter = info.limiter.get();
+    COND_RET_TLOG(!AcquireLimiters(limiter),
+                  (stats->End(-1, true),
+                   ReplyOverloaded(packet.GetSessionId(), pkg_head)),
+                  "HandleRpcReq: overloaded, shed|method:%s|seq:%lu",
+                  md->full_name().c_str(), pkg_head.seq);
+
+    // req, rsp, controller and done all live on one arena
+    auto &arena_pool = ArenaPool();
+    auto *arena = arena_pool.Get();
 
     // parse req
-    auto *req = service->GetRequestPrototype(md).New();
-    LLOG_TRACE("HandleRpcReq: packet: %s", packet.ToString().c_str());
-    ret = packet.Read(*req);
-    COND_RET_ELOG(ret != LLBC_OK, delete req,
+    auto *req = info.request_prototype->New(arena);
+    LAZY_TLOG("HandleRpcReq: packet: %s", packet.ToString().c_str());
+    ret = RpcChannel::ReadMessage(packet, pkg_head, *req);
+    COND_RET_ELOG(ret != LLBC_OK,
+                  (arena_pool.Put(arena), ReleaseLimiters(limiter, -1),
+                   stats->End(-1, true)),
                   "HandleRpcReq: read req failed|ret:%d|reason:%s", ret,
                   llbc::LLBC_FormatLastError());
     // create rsp
-    auto *rsp = service->GetResponsePrototype(md).New();
+    auto *rsp = info.response_prototype->New(arena);
 
-    auto controller = new RpcController(true);
-    // TODO: auto controller = objPool.Get<RpcController>();
+    auto *controller = ::google::protobuf::Arena::Create<RpcController>(arena, true);
     controller->SetSessionID(packet.GetSessionId());
     controller->SetPkgHead(pkg_head);
+    controller->SetDeadline(deadline);
 
     // create call back on rpc done
     // service methods should call done->run on rpc completion
-    auto done = ::google::protobuf::NewCallback(this, &RpcServiceMgr::OnRpcDone,
-                                                controller, {req, rsp});
-    service->CallMethod(md, controller, req, rsp, done);
+    auto *done = ::google::protobuf::Arena::Create<RpcDone>(
+        arena, this, arena, controller, rsp, limiter, stats, packet.GetExtData1(),
+        start_us);
+    if (info.invoke) {
+        info.invoke(info.rpc_service, controller, req, rsp, done);
+    } else {
+        info.service->CallMethod(md, controller, req, rsp, done);
+    }
 }
 
 void RpcServiceMgr::HandleRpcRsp(llbc::LLBC_Packet &packet) noexcept {
-    LLOG_TRACE("HandleRpcRsp: packet: %s", packet.ToString().c_str());
+    LAZY_TLOG("HandleRpcRsp: packet: %s", packet.ToString().c_str());
     RpcChannel::PkgHead pkg_head;
     int ret = pkg_head.FromPacket(packet);
     // this should not happen
     COND_RET_ELOG(ret != LLBC_OK, , "HandleRpcRsp: pkg_head.FromPacket failed|ret:%d",
                   ret);
-    LLOG_DEBUG("HandleRpcRsp: pkg_head info|%s", pkg_head.ToString().c_str());
+    LAZY_DLOG("HandleRpcRsp: pkg_head info|%s", pkg_head.ToString().c_str());
 
     auto coro_uid = static_cast<RpcCoroMgr::coro_uid_type>(pkg_head.seq);
     auto ctx = RpcCoroMgr::GetInst().PopCoroContext(coro_uid);
@@ -114,81 +238,116 @@ void RpcServiceMgr::HandleRpcRsp(llbc::LLBC_Packet &packet) noexcept {
     // the coro is already killed
     COND_RET_WLOG(ctx.handle == nullptr || ctx.controller == nullptr, ,
                   "HandleRpcRsp: coro context not found (possibly due to "
-                  "timeout)|seq_id:%lu|service_name:%s|method_name:%s|",
-                  coro_uid, pkg_head.service_name.c_str(), pkg_head.method_name.c_str());
+                  "timeout)|seq_id:%lu|method_id:%u|",
+                  coro_uid, pkg_head.method_id);
 
     COND_RET_ELOG(ctx.controller->UseCoro() == false, ,
                   "HandleRpcRsp: controller is blocking controller");
+    if (ctx.stats) {
+        ctx.stats->RecordQueue(llbc::LLBC_GetMicroSeconds() - packet.GetExtData1());
+    }
 
     // failed due to other reasons
     if (packet.GetStatus() != LLBC_OK) {
-        ctx.controller->SetFailed("rpc failed");
-        ctx.handle.resume();
-        LLOG_INFO("HandleRpcRsp: coro is done|%u", ctx.handle.done());
+        if (packet.GetStatus() == RpcChannel::RpcOverloaded) {
+            ctx.controller->SetOverloaded();
+        } else {
+            ctx.controller->SetFailed("rpc failed");
+        }
+        RpcCoroMgr::Resume(ctx);
         return;
     }
     if (ctx.controller->Failed()) {
-        ctx.handle.resume();
-        LLOG_INFO("HandleRpcRsp: coro is done|%u", ctx.handle.done());
+        RpcCoroMgr::Resume(ctx);
         return;
     }
 
     // no response, just resume the coro
     if (!ctx.rsp) {
-        LLOG_INFO("HandleRpcRsp: ctx doesn't have rsp");
-        ctx.handle.resume();
-        LLOG_INFO("HandleRpcRsp: coro is done|%u", ctx.handle.done());
+        LAZY_TLOG("HandleRpcRsp: ctx doesn't have rsp");
+        RpcCoroMgr::Resume(ctx);
         return;
     }
 
-    ret = packet.Read(*ctx.rsp);
+    ret = RpcChannel::ReadMessage(packet, pkg_head, *ctx.rsp);
     COND_RET_ELOG(ret != LLBC_OK, RpcCoroMgr::GetInst().KillCoro(ctx, "read rsp failed"),
                   "HandleRpcRsp: read rsp failed|ret:%d", ret);
-    LLOG_INFO("HandleRpcRsp: received rsp|address:%p|info:%s|sesson_id:%d", ctx.rsp,
-              ctx.rsp->DebugString().c_str(), packet.GetSessionId());
+    LAZY_DLOG("HandleRpcRsp: received rsp|address:%p|info:%s|sesson_id:%d", ctx.rsp,
+              ctx.rsp->ShortDebugString().c_str(), packet.GetSessionId());
 
-    ctx.handle.resume();
-    LLOG_INFO("HandleRpcRsp: coro is done|%u", ctx.handle.done());
+    RpcCoroMgr::Resume(ctx);
 }
 
-void RpcServiceMgr::OnRpcDone(
-    RpcController *controller,
-    std::pair<::google::protobuf::Message *, ::google::protobuf::Message *>
-        req_rsp) noexcept {
-    COND_EXP_ELOG(controller == nullptr, , "OnRpcDone: controller is nullptr");
+void RpcServiceMgr::OnRpcDone(RpcDone *done) noexcept {
+    auto *controller = done->controller;
+    auto *rsp = done->rsp;
+    auto *arena = done->arena;
+    auto now = llbc::LLBC_GetMicroSeconds();
+    auto time_us = now - done->start_us;
+    // the limiters count the time queued too, queues grow before handling slows down
+    ReleaseLimiters(done->limiter, now - done->recv_us);
+    done->stats->End(time_us, controller->Failed());
 
-    auto &[req, rsp] = req_rsp;
+    // releases req, rsp, controller and done itself
+    auto cleanUp = [&]() { ArenaPool().Put(arena); };
 
     llbc::LLBC_Packet *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
 
-    auto cleanUp = [&]() {
-        delete req;
-        delete rsp;
-        delete controller;
-    };
-
-    COND_RET_ELOG(
-        !packet, cleanUp(),
-        "OnRpcDone: alloc packet from obj pool failed|pkg_head: %s|req: %s|rsp: %s",
-        controller->GetPkgHead().ToString().c_str(),
-        req ? req->ShortDebugString().c_str() : "",
-        rsp ? rsp->ShortDebugString().c_str() : "");
+    COND_RET_ELOG(!packet, cleanUp(),
+                  "OnRpcDone: alloc packet from obj pool failed|pkg_head: %s|rsp: %s",
+                  controller->GetPkgHead().ToString().c_str(),
+                  rsp->ShortDebugString().c_str());
 
     packet->SetOpcode(RpcChannel::RpcOpCode::RpcRsp);
     packet->SetSessionId(controller->GetSessionID());
 
-    int ret = controller->GetPkgHead().ToPacket(*packet);
-    COND_RET_ELOG(ret != 0, cleanUp(), "OnRpcDone: pkg_head.ToPacket failed|ret:%d", ret);
-
     if (controller->Failed()) {
         packet->SetStatus(LLBC_FAILED);
     }
 
-    ret = packet->Write(*rsp);
-    COND_RET_ELOG(ret != 0, cleanUp(), "OnRpcDone: packet.Write failed|ret:%d", ret);
+    int ret = RpcChannel::WriteMessage(*packet, controller->GetPkgHead(), *rsp);
+    COND_RET_ELOG(ret != 0, LLBC_Recycle(packet);
+                  cleanUp(), "OnRpcDone: write message failed|ret:%d", ret);
 
-    LLOG_TRACE("OnRpcDone: packet: %s", packet->ToString().c_str());
+    LAZY_TLOG("OnRpcDone: packet: %s", packet->ToString().c_str());
 
-    conn_mgr_->SendPacket(packet);
+    // the client may be gone
+    ret = conn_mgr_->SendPacket(packet);
+    COND_EXP_ELOG(ret != LLBC_OK, LLBC_Recycle(packet),
+                  "OnRpcDone: send packet failed|session: %d", packet->GetSessionId());
     cleanUp();
 }
+
+bool RpcServiceMgr::AcquireLimiters(RpcConcurrencyLimiter *limiter) noexcept {
+    COND_RET(limiter_ && !limiter_->TryAcquire(), false);
+    if (limiter && !limiter->TryAcquire()) {
+        if (limiter_) limiter_->Release(-1);
+        return false;
+    }
+    return true;
+}
+
+void RpcServiceMgr::ReleaseLimiters(RpcConcurrencyLimiter *limiter,
+                                    llbc::sint64 latency_us) noexcept {
+    if (limiter_) limiter_->Release(latency_us);
+    if (limiter) limiter->Release(latency_us);
+}
+
+void RpcServiceMgr::ReplyOverloaded(int session_id,
+                                    RpcChannel::PkgHead pkg_head) noexcept {
+    llbc::LLBC_Packet *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    COND_RET_ELOG(!packet, , "ReplyOverloaded: alloc packet from obj pool failed|%s",
+                  pkg_head.ToString().c_str());
+
+    packet->SetOpcode(RpcChannel::RpcOpCode::RpcRsp);
+    packet->SetSessionId(session_id);
+    packet->SetStatus(RpcChannel::RpcOverloaded);
+    // the head alone, it carries the seq the caller waits on
+    pkg_head.body_len = 0;
+    int ret = pkg_head.ToPacket(*packet);
+    COND_RET_ELOG(ret != LLBC_OK, LLBC_Recycle(packet),
+                  "ReplyOverloaded: write pkg_head failed|ret:%d", ret);
+    ret = conn_mgr_->SendPacket(packet);
+    COND_EXP_ELOG(ret != LLBC_OK, LLBC_Recycle(packet),
+                  "ReplyOverloaded: send packet failed|session: %d", session_id);
+}
@@ -7,30 +7,69 @@
 #include <llbc.h>
 #include <singleton.h>
 
+#include <mutex>
+
+#include "rpc_arena_pool.h"
 #include "rpc_channel.h"
+#include "rpc_concurrency_limiter.h"
 #include "rpc_registry.h"
+#include "rpc_service.h"
 
 class RpcController;
 class RpcConnMgr;
+class RpcMethodStats;
 
 class RpcServiceMgr : public Singleton<RpcServiceMgr> {
     friend class Singleton<RpcServiceMgr>;
 
    public:
+    // Dispatch entry of a method. Generated services are called through `invoke`,
+    // generic services through Service::CallMethod().
     struct ServiceInfo {
         ::google::protobuf::Service *service = nullptr;
+        RpcService *rpc_service = nullptr;
         const ::google::protobuf::MethodDescriptor *md = nullptr;
+        const ::google::protobuf::Message *request_prototype = nullptr;
+        const ::google::protobuf::Message *response_prototype = nullptr;
+        RpcService::Invoker invoke = nullptr;
+        std::shared_ptr<RpcConcurrencyLimiter> limiter;  // of the method, if any
+        RpcMethodStats *stats = nullptr;                  // server side, never nullptr
     };
 
     virtual ~RpcServiceMgr();
 
-    int Init(RpcConnMgr *conn_mgr) noexcept;
+    // max_sessions: session pool size of each channel, see RpcChannel
+    // registry: node store of the service registry, zookeeper on 127.0.0.1:2181 if null
+    int Init(RpcConnMgr *conn_mgr, std::size_t max_sessions = RpcChannel::MAX_SESSIONS,
+             std::unique_ptr<RpcRegistryClient> registry = nullptr) noexcept;
+
+    // Weight the services added from now on are registered with, see
+    // RpcRegistry::RegisterService()
+    void SetWeight(std::uint32_t weight) noexcept { weight_ = weight; }
 
-    // add an user implemented service
+    // add an user implemented service, before any reactor starts serving
     int AddService(::google::protobuf::Service *service) noexcept;
+    // add a service derived from a skeleton generated by protoc-gen-rpc
+    int AddService(RpcService *service) noexcept;
 
     // register rpc channel. if channel already exists, return it directly.
-    RpcChannel *RegisterRpcChannel(const std::string &) noexcept;
+    // Channels are shared by all reactors, this may be called from any of them.
+    // A channel pools up to max_sessions sessions to its endpoint.
+    // The endpoint is picked by the method's load balancer, hash_key keeps calls sticky
+    // under RpcLoadBalancer::Policy::ConsistentHash.
+    RpcChannel *RegisterRpcChannel(const std::string &,
+                                   std::uint64_t hash_key = 0) noexcept;
+
+    // load balancer of svc_md, "" for the default, see RpcRegistry::SetLoadBalancer()
+    void SetLoadBalancer(const std::string &svc_md,
+                         RpcLoadBalancer::Factory factory) noexcept;
+
+    // Bound the requests of svc_md ("Service.Method") handled at once, or of all methods
+    // together if svc_md is empty. A request over either limit is answered right away
+    // with RpcChannel::RpcOverloaded. Call after AddService() and before any reactor
+    // starts serving.
+    int SetConcurrencyLimiter(const std::string &svc_md,
+                              const RpcConcurrencyLimiter::Options &options) noexcept;
 
    protected:
     RpcServiceMgr() = default;
@@ -41,15 +80,66 @@ class RpcServiceMgr : public Singleton<RpcServiceMgr> {
     virtual void HandleRpcRsp(llbc::LLBC_Packet &packet) noexcept;
 
    private:
+    // Index the methods of a service by id and register them. Fails without adding any
+    // if one's id collides with another method's.
+    int AddMethods(const std::vector<ServiceInfo> &infos) noexcept;
+    // register the methods of a service to zookeeper at once
+    int RegisterMethods(const std::vector<std::string> &svc_mds) noexcept;
+
+    // `done` closure handed to service methods. It lives on the request arena together
+    // with req, rsp and controller, and all of them are released at once in OnRpcDone.
+    struct RpcDone : public ::google::protobuf::Closure {
+        RpcDone(RpcServiceMgr *mgr, ::google::protobuf::Arena *arena,
+                RpcController *controller, ::google::protobuf::Message *rsp,
+                RpcConcurrencyLimiter *limiter, RpcMethodStats *stats,
+                llbc::sint64 recv_us, llbc::sint64 start_us) noexcept
+            : mgr(mgr),
+              arena(arena),
+              controller(controller),
+              rsp(rsp),
+              limiter(limiter),
+              stats(stats),
+              recv_us(recv_us),
+              start_us(start_us) {}
+
+        void Run() override { mgr->OnRpcDone(this); }
+
+        RpcServiceMgr *mgr = nullptr;
+        ::google::protobuf::Arena *arena = nullptr;
+        RpcController *controller = nullptr;
+        ::google::protobuf::Message *rsp = nullptr;
+        RpcConcurrencyLimiter *limiter = nullptr;  // of the method, if any
+        RpcMethodStats *stats = nullptr;
+        llbc::sint64 recv_us = 0;   // when the request was received
+        llbc::sint64 start_us = 0;  // when the request was dispatched
+    };
+
     // called on rpc request done, send response back
-    void OnRpcDone(
-        RpcController *controller,
-        std::pair<::google::protobuf::Message *, ::google::protobuf::Message *>) noexcept;
+    void OnRpcDone(RpcDone *done) noexcept;
+
+    // admit a request to the global limiter and limiter, false if either is at its limit
+    bool AcquireLimiters(RpcConcurrencyLimiter *limiter) noexcept;
+    // release an admitted request, see RpcConcurrencyLimiter::Release()
+    void ReleaseLimiters(RpcConcurrencyLimiter *limiter,
+                         llbc::sint64 latency_us) noexcept;
+    // answer a shed request with RpcChannel::RpcOverloaded
+    void ReplyOverloaded(int session_id, RpcChannel::PkgHead pkg_head) noexcept;
+
+    // per-request arenas of the calling thread's reactor. A request is handled and
+    // finished on the reactor that received it.
+    static RpcArenaPool &ArenaPool() noexcept {
+        thread_local RpcArenaPool pool;
+        return pool;
+    }
 
     RpcConnMgr *conn_mgr_ = nullptr;
+    std::size_t max_sessions_ = RpcChannel::MAX_SESSIONS;  // per channel
+    std::uint32_t weight_ = 1;  // of this server in clients' load balancers
     std::unique_ptr<RpcRegistry> registry_;
-    std::unordered_map<std::string, std::unordered_map<std::string, ServiceInfo>>
-        service_methods_;  // service_name -> method_name -> service_info
+    std::unique_ptr<RpcConcurrencyLimiter> limiter_;  // of all methods together, if any
+    std::unordered_map<std::uint32_t, ServiceInfo>
+        service_methods_;  // method_id -> service_info
+    std::mutex channels_mutex_;  // guards channels_
     std::unordered_map<std::string, RpcChannel *> channels_;  // ip:port -> channel
 };  // RpcServiceMgr
 
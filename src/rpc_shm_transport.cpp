@@ -0,0 +1,599 @@
+#include "rpc_shm_transport.h"
+
+#include <shm_ring.h>
+
+#include <fstream>
+
+#include "rpc_channel.h"
+#include "rpc_macros.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+
+namespace {
+
+// first message of a client, sent with the memfd and the two eventfds
+struct Hello {
+    std::uint64_t magic = MAGIC;
+    std::uint32_t version = VERSION;
+    std::uint32_t flags = 0;
+    std::uint64_t ring_bytes = 0;  // capacity of each ring
+
+    static constexpr std::uint64_t MAGIC = 0x4d48535f43505243ULL;  // "CRPC_SHM"
+    static constexpr std::uint32_t VERSION = 1;
+};
+
+// head of every record: the packet's opcode and status, its payload follows
+struct FrameHead {
+    std::uint32_t opcode;
+    std::int32_t status;
+};
+
+// epoll registrations, the kind in the high half of the data, a value in the low one
+enum EventKind : std::uint64_t {
+    WakeEvent,
+    ListenEvent,
+    HelloEvent,
+    BellEvent,
+    PeerEvent,
+};
+
+constexpr std::uint64_t EventData(EventKind kind, std::uint32_t value) noexcept {
+    return (static_cast<std::uint64_t>(kind) << 32) | value;
+}
+
+int Watch(int epoll_fd, int fd, EventKind kind, std::uint32_t value) noexcept {
+    epoll_event ev{};
+    ev.events = EPOLLIN | (kind == PeerEvent ? EPOLLRDHUP : 0);
+    ev.data.u64 = EventData(kind, value);
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void Ring(int bell) noexcept {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto n = write(bell, &one, sizeof(one));
+}
+
+void Clear(int fd) noexcept {
+    std::uint64_t count;
+    [[maybe_unused]] auto n = read(fd, &count, sizeof(count));
+}
+
+// the segment: the client -> server ring, then the server -> client one
+std::size_t SegmentSize(std::size_t ring_bytes) noexcept {
+    return 2 * ShmRing::region_size(ring_bytes);
+}
+
+// abstract socket of the server on ip:port, the name starts with a NUL
+socklen_t Address(const std::string &ip, int port, sockaddr_un &addr) noexcept {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    auto name = "cpp-rpc-shm:" + ip + ":" + std::to_string(port);
+    auto len = std::min(name.size(), sizeof(addr.sun_path) - 1);
+    std::memcpy(addr.sun_path + 1, name.data(), len);
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + len);
+}
+
+// socket at path in the file system, @return 0 if the path is too long
+socklen_t PathAddress(const std::string &path, sockaddr_un &addr) noexcept {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return 0;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+}
+
+}  // namespace
+
+struct RpcShmTransport::Link {
+    int id = 0;
+    int sock = -1;     // unix socket to the other end, for liveness only
+    int tx_bell = -1;  // eventfd of the other end's consumer
+    int rx_bell = -1;  // eventfd of ours
+    void *mem = MAP_FAILED;
+    std::size_t mem_size = 0;
+
+    ShmRing rx;  // poller only
+    llbc::LLBC_Packet *pending = nullptr;  // received, not yet taken by deliver_
+
+    std::mutex mutex;  // guards tx and backlog
+    ShmRing tx;
+    std::deque<llbc::LLBC_Packet *> backlog;  // waiting for room in tx
+    std::atomic<std::size_t> backlog_size{0};
+
+    ~Link() {
+        for (int fd : {sock, tx_bell, rx_bell}) {
+            if (fd >= 0) close(fd);
+        }
+        if (mem != MAP_FAILED) munmap(mem, mem_size);
+        if (pending) LLBC_Recycle(pending);
+        for (auto *packet : backlog) {
+            LLBC_Recycle(packet);
+        }
+    }
+};
+
+RpcShmTransport::RpcShmTransport(Deliver deliver) : deliver_(std::move(deliver)) {}
+
+RpcShmTransport::~RpcShmTransport() {
+    if (poller_.joinable()) {
+        stop_.store(true, std::memory_order_release);
+        Wake();
+        poller_.join();
+    }
+    links_.clear();
+    for (int fd : {listen_fd_, epoll_fd_, wake_fd_}) {
+        if (fd >= 0) close(fd);
+    }
+    if (!listen_path_.empty()) unlink(listen_path_.c_str());
+}
+
+int RpcShmTransport::Start() noexcept {
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    COND_RET(poller_.joinable(), LLBC_OK);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    COND_RET_ELOG(epoll_fd_ < 0 || wake_fd_ < 0 ||
+                      Watch(epoll_fd_, wake_fd_, WakeEvent, 0) != 0,
+                  LLBC_FAILED, "RpcShmTransport: start poller failed|%s",
+                  std::strerror(errno));
+    poller_ = std::thread([this] { Run(); });
+    return LLBC_OK;
+}
+
+int RpcShmTransport::Listen(const std::string &ip, int port) noexcept {
+    sockaddr_un addr;
+    auto len = Address(ip, port, addr);
+    return ListenAt(addr, len, ip + ":" + std::to_string(port));
+}
+
+int RpcShmTransport::ListenPath(const std::string &path) noexcept {
+    sockaddr_un addr;
+    auto len = PathAddress(path, addr);
+    COND_RET_ELOG(len == 0, LLBC_FAILED, "RpcShmTransport: bad socket path|%s",
+                  path.c_str());
+    // a socket left behind by a server that is gone is removed, a live one is kept
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr *>(&addr),
+                                          len) == 0;
+        if (probe >= 0) close(probe);
+        COND_RET_ELOG(live, LLBC_FAILED, "RpcShmTransport: socket in use|%s",
+                      path.c_str());
+        unlink(path.c_str());
+    }
+    COND_RET(ListenAt(addr, len, path) != LLBC_OK, LLBC_FAILED);
+    listen_path_ = path;
+    return LLBC_OK;
+}
+
+int RpcShmTransport::ListenAt(const sockaddr_un &addr, socklen_t len,
+                              const std::string &name) noexcept {
+    COND_RET_ELOG(Listening(), LLBC_FAILED, "RpcShmTransport: already listening");
+    COND_RET(Start() != LLBC_OK, LLBC_FAILED);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr *>(&addr), len) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        LLOG_WARN("RpcShmTransport: listen failed|%s|%s", name.c_str(),
+                  std::strerror(errno));
+        if (fd >= 0) close(fd);
+        return LLBC_FAILED;
+    }
+    listen_fd_ = fd;
+    COND_RET_ELOG(Watch(epoll_fd_, fd, ListenEvent, 0) != 0, LLBC_FAILED,
+                  "RpcShmTransport: watch listener failed|%s", std::strerror(errno));
+    LLOG_INFO("RpcShmTransport: listening|%s", name.c_str());
+    return LLBC_OK;
+}
+
+int RpcShmTransport::Connect(const std::string &ip, int port) noexcept {
+    sockaddr_un addr;
+    auto len = Address(ip, port, addr);
+    return ConnectAt(addr, len, ip + ":" + std::to_string(port));
+}
+
+int RpcShmTransport::ConnectPath(const std::string &path) noexcept {
+    sockaddr_un addr;
+    auto len = PathAddress(path, addr);
+    COND_RET_ELOG(len == 0, 0, "RpcShmTransport: bad socket path|%s", path.c_str());
+    return ConnectAt(addr, len, path);
+}
+
+int RpcShmTransport::ConnectAt(const sockaddr_un &addr, socklen_t len,
+                               const std::string &name) noexcept {
+    COND_RET(Start() != LLBC_OK, 0);
+    auto link = std::make_shared<Link>();
+    link->sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    // no server of this host listens there
+    COND_RET_TLOG(link->sock < 0 || connect(link->sock,
+                                            reinterpret_cast<const sockaddr *>(&addr),
+                                            len) != 0,
+                  0, "RpcShmTransport: no listener|%s|%s", name.c_str(),
+                  std::strerror(errno));
+
+    int memfd = memfd_create("cpp-rpc-shm", MFD_CLOEXEC);
+    link->mem_size = SegmentSize(RING_BYTES);
+    if (memfd >= 0 && ftruncate(memfd, static_cast<off_t>(link->mem_size)) == 0) {
+        link->mem = mmap(nullptr, link->mem_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         memfd, 0);
+    }
+    link->tx_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    link->rx_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (link->mem == MAP_FAILED || link->tx_bell < 0 || link->rx_bell < 0) {
+        LLOG_ERROR("RpcShmTransport: create segment failed|%s", std::strerror(errno));
+        if (memfd >= 0) close(memfd);
+        return 0;
+    }
+    auto *mem = static_cast<char *>(link->mem);
+    link->tx = ShmRing::create(mem, RING_BYTES);
+    link->rx = ShmRing::create(mem + ShmRing::region_size(RING_BYTES), RING_BYTES);
+
+    Hello hello;
+    hello.ring_bytes = RING_BYTES;
+    iovec iov{&hello, sizeof(hello)};
+    int fds[3] = {memfd, link->tx_bell, link->rx_bell};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    auto sent = sendmsg(link->sock, &msg, MSG_NOSIGNAL);
+    close(memfd);  // the mapping keeps the segment
+    COND_RET_ELOG(sent != sizeof(hello), 0, "RpcShmTransport: send hello failed|%s",
+                  std::strerror(errno));
+
+    timeval timeout{HANDSHAKE_TIMEOUT_MS / 1000, HANDSHAKE_TIMEOUT_MS % 1000 * 1000};
+    setsockopt(link->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char ack = 0;
+    COND_RET_ELOG(recv(link->sock, &ack, 1, 0) != 1 || ack != 1, 0,
+                  "RpcShmTransport: handshake failed|%s|%s", name.c_str(),
+                  std::strerror(errno));
+    fcntl(link->sock, F_SETFL, fcntl(link->sock, F_GETFL) | O_NONBLOCK);
+
+    auto sessionID = AddLink(std::move(link));
+    LLOG_INFO("RpcShmTransport: connected|%s|session: %d", name.c_str(), sessionID);
+    return sessionID;
+}
+
+int RpcShmTransport::AddLink(std::shared_ptr<Link> link) noexcept {
+    auto *raw = link.get();
+    {
+        std::unique_lock<std::shared_mutex> lock(links_mutex_);
+        raw->id = next_session_++;
+        links_.emplace(raw->id, std::move(link));
+    }
+    auto id = static_cast<std::uint32_t>(raw->id);
+    if (Watch(epoll_fd_, raw->rx_bell, BellEvent, id) != 0 ||
+        Watch(epoll_fd_, raw->sock, PeerEvent, id) != 0) {
+        LLOG_ERROR("RpcShmTransport: watch link failed|session: %d|%s", raw->id,
+                   std::strerror(errno));
+    }
+    links_version_.fetch_add(1, std::memory_order_release);
+    Wake();
+    return static_cast<int>(id);
+}
+
+std::shared_ptr<RpcShmTransport::Link> RpcShmTransport::FindLink(int sessionID) noexcept {
+    std::shared_lock<std::shared_mutex> lock(links_mutex_);
+    auto it = links_.find(sessionID);
+    return it != links_.end() ? it->second : nullptr;
+}
+
+int RpcShmTransport::Close(int sessionID) noexcept {
+    std::shared_ptr<Link> link;
+    {
+        std::unique_lock<std::shared_mutex> lock(links_mutex_);
+        auto it = links_.find(sessionID);
+        COND_RET(it == links_.end(), LLBC_FAILED);
+        link = std::move(it->second);
+        links_.erase(it);
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, link->rx_bell, nullptr);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, link->sock, nullptr);
+    // the other end sees the socket close; the poller may still hold the link a while
+    shutdown(link->sock, SHUT_RDWR);
+    links_version_.fetch_add(1, std::memory_order_release);
+    LLOG_TRACE("RpcShmTransport: closed|session: %d", sessionID);
+    return LLBC_OK;
+}
+
+bool RpcShmTransport::IsOpen(int sessionID) noexcept {
+    return FindLink(sessionID) != nullptr;
+}
+
+int RpcShmTransport::Send(llbc::LLBC_Packet *packet) noexcept {
+    auto link = FindLink(packet->GetSessionId());
+    COND_RET_TLOG(!link, LLBC_FAILED,
+                  "RpcShmTransport: send to a closed link|session: %d",
+                  packet->GetSessionId());
+    COND_RET_ELOG(sizeof(FrameHead) + packet->GetPayloadLength() > link->tx.max_record(),
+                  LLBC_FAILED, "RpcShmTransport: packet too large|session: %d, len: %lu",
+                  packet->GetSessionId(), packet->GetPayloadLength());
+
+    std::unique_lock<std::mutex> lock(link->mutex);
+    // once backlogged, keep the order by queueing behind the backlog
+    if (link->backlog.empty() && Write(*link, *packet)) {
+        lock.unlock();
+        LLBC_Recycle(packet);
+        return LLBC_OK;
+    }
+    COND_RET_TLOG(link->backlog.size() >= MAX_BACKLOG, RpcChannel::RpcOverloaded,
+                  "RpcShmTransport: backlog full|session: %d", packet->GetSessionId());
+    link->backlog.push_back(packet);
+    link->backlog_size.store(link->backlog.size(), std::memory_order_release);
+    bool first = link->backlog.size() == 1;
+    lock.unlock();
+    // the poller only flushes backlogs it knows about
+    if (first) Wake();
+    return LLBC_OK;
+}
+
+bool RpcShmTransport::Write(Link &link, const llbc::LLBC_Packet &packet) noexcept {
+    auto len = packet.GetPayloadLength();
+    auto *p = static_cast<char *>(link.tx.reserve(sizeof(FrameHead) + len));
+    COND_RET(!p, false);
+    FrameHead head{static_cast<std::uint32_t>(packet.GetOpcode()),
+                   static_cast<std::int32_t>(packet.GetStatus())};
+    std::memcpy(p, &head, sizeof(head));
+    if (len > 0) std::memcpy(p + sizeof(head), packet.GetPayload(), len);
+    if (link.tx.commit()) Ring(link.tx_bell);
+    return true;
+}
+
+void RpcShmTransport::FlushBacklog(Link &link) noexcept {
+    if (link.backlog_size.load(std::memory_order_acquire) == 0) return;
+    std::lock_guard<std::mutex> lock(link.mutex);
+    while (!link.backlog.empty() && Write(link, *link.backlog.front())) {
+        LLBC_Recycle(link.backlog.front());
+        link.backlog.pop_front();
+    }
+    link.backlog_size.store(link.backlog.size(), std::memory_order_release);
+}
+
+bool RpcShmTransport::Drain(Link &link) noexcept {
+    if (link.pending) {
+        COND_RET(!deliver_(link.pending), false);
+        link.pending = nullptr;
+    }
+    auto now = llbc::LLBC_GetMicroSeconds();
+    std::size_t n = 0;
+    for (; n < DRAIN_BATCH; ++n) {
+        std::size_t len = 0;
+        const auto *p = static_cast<const char *>(link.rx.front(len));
+        if (!p) break;
+        if (len < sizeof(FrameHead)) {
+            LLOG_ERROR("RpcShmTransport: short frame|session: %d, len: %lu", link.id, len);
+            link.rx.pop();
+            continue;
+        }
+        FrameHead head;
+        std::memcpy(&head, p, sizeof(head));
+        // recycled by the reactor thread, so it must come from the thread-safe pool
+        auto *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+        packet->SetHeader(link.id, static_cast<int>(head.opcode), head.status);
+        if (len > sizeof(head)) packet->Write(p + sizeof(head), len - sizeof(head));
+        packet->SetExtData1(now);
+        link.rx.pop();
+        if (!deliver_(packet)) {
+            link.pending = packet;
+            return true;
+        }
+    }
+    return n > 0;
+}
+
+void RpcShmTransport::Run() noexcept {
+    std::vector<std::shared_ptr<Link>> links;  // copy of links_, refreshed on change
+    std::uint64_t version = ~0ULL;
+    epoll_event events[64];
+    std::uint32_t idle = 0;   // polls that found nothing in a row
+    std::uint32_t polls = 0;  // polls since the sockets were looked at
+    // spinning on the only cpu just keeps the other end from running
+    const std::uint32_t spin = std::thread::hardware_concurrency() > 1 ? SPIN : 0;
+
+    while (!stop_.load(std::memory_order_acquire)) {
+        if (auto v = links_version_.load(std::memory_order_acquire); v != version) {
+            std::shared_lock<std::shared_mutex> lock(links_mutex_);
+            links.clear();
+            for (auto &[id, link] : links_) {
+                links.push_back(link);
+            }
+            version = v;
+        }
+
+        bool busy = false, stuck = false;
+        for (auto &link : links) {
+            FlushBacklog(*link);
+            busy |= Drain(*link);
+            stuck |= link->pending || link->backlog_size.load(std::memory_order_relaxed);
+        }
+
+        // Spin a while before sleeping, a busy link gets the next frame without a
+        // syscall. The sockets are only looked at now and then meanwhile.
+        int timeout = 0;
+        bool waited = false;
+        if (busy || ++idle <= spin) {
+            if (busy) idle = 0;
+#if defined(__x86_64__) || defined(__i386__)
+            if (!busy) __builtin_ia32_pause();
+#endif
+            if ((++polls & 63) != 0) continue;
+        } else {
+            // Sleep unless a ring got records after we looked. Retry the stuck links,
+            // which no doorbell rings for, every millisecond.
+            bool empty = true;
+            for (auto &link : links) {
+                empty &= link->rx.prepare_wait();
+            }
+            timeout = !empty ? 0 : stuck ? 1 : -1;
+            waited = true;
+            idle = 0;
+        }
+
+        int n = epoll_wait(epoll_fd_, events, 64, timeout);
+        if (waited) {
+            for (auto &link : links) {
+                link->rx.finish_wait();
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            auto kind = static_cast<EventKind>(events[i].data.u64 >> 32);
+            auto value = static_cast<std::uint32_t>(events[i].data.u64);
+            switch (kind) {
+                case WakeEvent:
+                    Clear(wake_fd_);
+                    break;
+                case ListenEvent:
+                    Accept();
+                    break;
+                case HelloEvent:
+                    Handshake(static_cast<int>(value));
+                    break;
+                case BellEvent:
+                    if (auto link = FindLink(static_cast<int>(value))) {
+                        Clear(link->rx_bell);
+                    }
+                    break;
+                case PeerEvent:
+                    // the other end only ever closes the socket, take what it sent first
+                    if (auto link = FindLink(static_cast<int>(value))) {
+                        while (Drain(*link) && !link->pending) {
+                        }
+                        LLOG_INFO("RpcShmTransport: peer gone|session: %d", link->id);
+                        Close(link->id);
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+void RpcShmTransport::Accept() noexcept {
+    for (;;) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LLOG_ERROR("RpcShmTransport: accept failed|%s", std::strerror(errno));
+            }
+            return;
+        }
+        if (Watch(epoll_fd_, fd, HelloEvent, static_cast<std::uint32_t>(fd)) != 0) {
+            close(fd);
+        }
+    }
+}
+
+void RpcShmTransport::Handshake(int fd) noexcept {
+    Hello hello;
+    iovec iov{&hello, sizeof(hello)};
+    int fds[3] = {-1, -1, -1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto received = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    // closed without a hello, e.g. ListenPath() probing whether the socket is in use
+    if (received == 0) {
+        LAZY_TLOG("RpcShmTransport: closed before hello");
+        close(fd);
+        return;
+    }
+
+    auto link = std::make_shared<Link>();
+    link->sock = fd;  // closed with the link from here on
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        std::memcpy(fds, CMSG_DATA(cmsg), cmsg->cmsg_len - CMSG_LEN(0));
+    }
+    link->rx_bell = fds[1];
+    link->tx_bell = fds[2];
+    auto ring_bytes = hello.ring_bytes;
+    bool ok = received == sizeof(hello) && !(msg.msg_flags & MSG_CTRUNC) &&
+              fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0 && hello.magic == Hello::MAGIC &&
+              hello.version == Hello::VERSION && ring_bytes >= 4096 &&
+              ring_bytes <= (1UL << 30) && (ring_bytes & (ring_bytes - 1)) == 0;
+    struct stat st;
+    if (ok && fstat(fds[0], &st) == 0 &&
+        static_cast<std::size_t>(st.st_size) == SegmentSize(ring_bytes)) {
+        link->mem_size = SegmentSize(ring_bytes);
+        link->mem = mmap(nullptr, link->mem_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fds[0], 0);
+    }
+    if (fds[0] >= 0) close(fds[0]);
+    if (link->mem != MAP_FAILED) {
+        auto *mem = static_cast<char *>(link->mem);
+        auto region = ShmRing::region_size(ring_bytes);
+        link->rx = ShmRing::attach(mem, region);
+        link->tx = ShmRing::attach(mem + region, region);
+    }
+
+    char ack = 1;
+    COND_RET_ELOG(!link->rx.valid() || !link->tx.valid() ||
+                      send(fd, &ack, 1, MSG_NOSIGNAL) != 1,
+                  , "RpcShmTransport: bad hello|received: %ld|%s", received,
+                  std::strerror(errno));
+    auto sessionID = AddLink(std::move(link));
+    LLOG_INFO("RpcShmTransport: accepted|session: %d", sessionID);
+}
+
+void RpcShmTransport::Wake() noexcept {
+    if (wake_fd_ >= 0) Ring(wake_fd_);
+}
+
+const std::string &RpcShmTransport::HostID() noexcept {
+    // changes on every boot, the same in every process and container of one kernel
+    static const std::string id = [] {
+        std::string boot_id;
+        std::ifstream("/proc/sys/kernel/random/boot_id") >> boot_id;
+        return boot_id;
+    }();
+    return id;
+}
+
+#else  // shared memory links need Linux, every session goes over tcp
+
+struct RpcShmTransport::Link {};
+
+RpcShmTransport::RpcShmTransport(Deliver deliver) : deliver_(std::move(deliver)) {}
+RpcShmTransport::~RpcShmTransport() {}
+
+int RpcShmTransport::Listen(const std::string &, int) noexcept { return LLBC_FAILED; }
+int RpcShmTransport::ListenPath(const std::string &) noexcept { return LLBC_FAILED; }
+int RpcShmTransport::Connect(const std::string &, int) noexcept { return 0; }
+int RpcShmTransport::ConnectPath(const std::string &) noexcept { return 0; }
+
+int RpcShmTransport::Send(llbc::LLBC_Packet *) noexcept { return LLBC_FAILED; }
+
+int RpcShmTransport::Close(int) noexcept { return LLBC_FAILED; }
+bool RpcShmTransport::IsOpen(int) noexcept { return false; }
+
+const std::string &RpcShmTransport::HostID() noexcept {
+    static const std::string id;
+    return id;
+}
+
+#endif  // __linux__
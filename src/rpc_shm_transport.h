@@ -0,0 +1,122 @@
+#ifndef _RPC_SHM_TRANSPORT_H_
+#define _RPC_SHM_TRANSPORT_H_
+
+#include <llbc.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Shared memory transport between processes on the same host.
+ * A link is a memfd segment with one ShmRing per direction and an eventfd per ring that
+ * wakes its consumer, only when it sleeps. The client creates the segment and the
+ * eventfds and passes them over a unix socket of the server: an abstract one named after
+ * its "ip:port", or one at a path, e.g. shared with a sidecar. The socket stays open so
+ * either end sees when the other goes away.
+ *
+ * Links have session ids of their own, from SESSION_BASE up, so packets look the same
+ * as those of llbc sessions above this layer. Any thread may send; a poller thread reads
+ * every link and hands the packets to the deliver callback.
+ */
+class RpcShmTransport {
+   public:
+    // Takes a received packet, with its receive time in microseconds in ExtData1.
+    // @return false if it can't be taken now, it is offered again later
+    using Deliver = std::function<bool(llbc::LLBC_Packet *)>;
+
+    explicit RpcShmTransport(Deliver deliver);
+    ~RpcShmTransport();
+
+    // non-copyable
+    RpcShmTransport(const RpcShmTransport &) = delete;
+    RpcShmTransport &operator=(const RpcShmTransport &) = delete;
+
+    // accept links of clients that call Connect(ip, port) on this host
+    int Listen(const std::string &ip, int port) noexcept;
+    // Accept links of clients that call ConnectPath(path) instead. A socket a former
+    // server left at path is replaced, it is removed again on destruction.
+    int ListenPath(const std::string &path) noexcept;
+    bool Listening() const noexcept { return listen_fd_ >= 0; }
+
+    // Set up a link to the server listening on ip:port of this host.
+    // @return its session id, or 0 if there is no such server
+    int Connect(const std::string &ip, int port) noexcept;
+    // same as above for the server listening at path
+    int ConnectPath(const std::string &path) noexcept;
+
+    // Send a packet over the link of its session id, the packet is recycled. If the ring
+    // is full it waits in the link's backlog, which the poller flushes.
+    // @return LLBC_FAILED if the link is closed or the packet too large for the ring,
+    // RpcChannel::RpcOverloaded if MAX_BACKLOG packets are waiting already; the packet is
+    // then still the caller's
+    int Send(llbc::LLBC_Packet *packet) noexcept;
+
+    int Close(int sessionID) noexcept;
+    // whether the link is up, it goes down when either end closes it
+    bool IsOpen(int sessionID) noexcept;
+
+    static constexpr bool IsShmSession(int sessionID) noexcept {
+        return sessionID >= SESSION_BASE;
+    }
+
+    // Id of the running kernel, equal for processes that can share memory with each
+    // other. Servers advertise it next to their address, see RpcRegistry.
+    static const std::string &HostID() noexcept;
+
+    static constexpr int SESSION_BASE = 1 << 30;          // llbc session ids stay below
+    static constexpr std::size_t RING_BYTES = 8UL << 20;  // per direction and link
+    static constexpr std::size_t MAX_BACKLOG = 65536;     // packets a link holds back
+    static constexpr std::size_t DRAIN_BATCH = 64;  // frames read from a link at a time
+    static constexpr std::uint32_t SPIN = 1024;  // idle polls before the poller sleeps
+    static constexpr int HANDSHAKE_TIMEOUT_MS = 1000;
+
+   private:
+    struct Link;
+
+    // name is for the log
+    int ListenAt(const sockaddr_un &addr, socklen_t len,
+                 const std::string &name) noexcept;
+    int ConnectAt(const sockaddr_un &addr, socklen_t len,
+                  const std::string &name) noexcept;
+    // start the poller thread if it isn't running
+    int Start() noexcept;
+    void Run() noexcept;
+
+    // hand up to DRAIN_BATCH frames of a link to deliver_, @return whether any was taken
+    bool Drain(Link &link) noexcept;
+    // move a link's backlog into its ring as far as there is room
+    void FlushBacklog(Link &link) noexcept;
+    // write a packet to a link's ring, the link's mutex must be held
+    static bool Write(Link &link, const llbc::LLBC_Packet &packet) noexcept;
+
+    void Accept() noexcept;
+    // read a client's hello and set up its link, the socket is closed on failure
+    void Handshake(int fd) noexcept;
+    int AddLink(std::shared_ptr<Link> link) noexcept;
+    std::shared_ptr<Link> FindLink(int sessionID) noexcept;
+    void Wake() noexcept;
+
+    Deliver deliver_;
+    int listen_fd_ = -1;
+    std::string listen_path_;  // socket file of ListenPath()
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;  // eventfd, wakes the poller
+    std::thread poller_;
+    std::mutex start_mutex_;
+    std::atomic<bool> stop_{false};
+
+    std::shared_mutex links_mutex_;
+    std::unordered_map<int, std::shared_ptr<Link>> links_;
+    std::atomic<std::uint64_t> links_version_{0};  // bumped on every change of links_
+    int next_session_ = SESSION_BASE;
+};
+
+#endif  // _RPC_SHM_TRANSPORT_H_
@@ -0,0 +1,203 @@
+#include "rpc_stats.h"
+
+#include <cstdio>
+
+namespace {
+
+// shard index of the calling thread
+std::size_t ThreadShard() noexcept {
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t shard =
+        next.fetch_add(1, std::memory_order_relaxed) % RpcMethodStats::MAX_SHARDS;
+    return shard;
+}
+
+}  // namespace
+
+void RpcHistogram::Merge(const RpcHistogram &other) noexcept {
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        if (auto n = other.counts_[i].load(std::memory_order_relaxed)) {
+            counts_[i].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::uint64_t RpcHistogram::Count() const noexcept {
+    std::uint64_t count = 0;
+    for (const auto &n : counts_) {
+        count += n.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::uint64_t RpcHistogram::Quantile(double q) const noexcept {
+    auto count = Count();
+    if (count == 0) {
+        return 0;
+    }
+    // rank of the value, 1-based
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count) + 0.5);
+    rank = std::clamp<std::uint64_t>(rank, 1, count);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return UpperBoundOf(i);
+        }
+    }
+    // records added while counting
+    return UpperBoundOf(BUCKETS - 1);
+}
+
+RpcMethodStats::~RpcMethodStats() {
+    for (auto &s : shards_) {
+        delete s.load(std::memory_order_relaxed);
+    }
+}
+
+RpcMethodStats::shard &RpcMethodStats::Local() noexcept {
+    auto &slot = shards_[ThreadShard()];
+    auto *s = slot.load(std::memory_order_acquire);
+    if (s) [[likely]] {
+        return *s;
+    }
+    // another thread sharing the slot may have won the race
+    auto *created = new shard;
+    if (slot.compare_exchange_strong(s, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+    delete created;
+    return *s;
+}
+
+void RpcMethodStats::Begin(llbc::sint64 queue_us) noexcept {
+    auto &s = Local();
+    s.begun.fetch_add(1, std::memory_order_relaxed);
+    if (queue_us >= 0) {
+        s.queue_us.Record(static_cast<std::uint64_t>(queue_us));
+    }
+}
+
+void RpcMethodStats::RecordQueue(llbc::sint64 queue_us) noexcept {
+    // the clocks of receive and handling may step apart by a tick
+    queue_us = std::max<llbc::sint64>(queue_us, 0);
+    Local().queue_us.Record(static_cast<std::uint64_t>(queue_us));
+}
+
+void RpcMethodStats::End(llbc::sint64 time_us, bool failed) noexcept {
+    auto &s = Local();
+    s.ended.fetch_add(1, std::memory_order_relaxed);
+    if (failed) {
+        s.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (time_us >= 0) {
+        s.time_us.Record(static_cast<std::uint64_t>(time_us));
+    }
+}
+
+void RpcMethodStats::Collect(Snapshot &out) const noexcept {
+    std::uint64_t ended = 0;
+    for (const auto &slot : shards_) {
+        const auto *s = slot.load(std::memory_order_acquire);
+        if (!s) {
+            continue;
+        }
+        // ended before begun, so a request never looks ended but not begun
+        ended += s->ended.load(std::memory_order_relaxed);
+        out.requests += s->begun.load(std::memory_order_relaxed);
+        out.errors += s->errors.load(std::memory_order_relaxed);
+        out.queue_us.Merge(s->queue_us);
+        out.time_us.Merge(s->time_us);
+    }
+    // a request may begin on one thread and end on another
+    out.inflight = out.requests > ended ? out.requests - ended : 0;
+}
+
+RpcMethodStats *RpcStats::Find(Side side, std::uint32_t method_id) const noexcept {
+    const auto &table = table_[side];
+    for (std::size_t i = 0; i < TABLE_SIZE; ++i) {
+        const auto &slot = table[(method_id + i) & (TABLE_SIZE - 1)];
+        auto *stats = slot.load(std::memory_order_acquire);
+        if (!stats || stats->MethodID() == method_id) {
+            return stats;
+        }
+    }
+    return nullptr;
+}
+
+RpcMethodStats *RpcStats::Get(Side side, std::uint32_t method_id,
+                              std::string_view full_name) noexcept {
+    auto *stats = Find(side, method_id);
+    if (stats && (full_name.empty() || stats->named_.load(std::memory_order_acquire))) {
+        return stats;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stats && !(stats = Find(side, method_id))) {
+        auto &table = table_[side];
+        std::size_t i = 0;
+        while (i < TABLE_SIZE &&
+               table[(method_id + i) & (TABLE_SIZE - 1)].load(std::memory_order_relaxed)) {
+            ++i;
+        }
+        if (i == TABLE_SIZE) {
+            // every method from here on is counted as one
+            if (!overflow_[side]) {
+                LLOG_WARN("RpcStats: too many methods, the rest are merged|max: %lu",
+                          TABLE_SIZE);
+                entries_.push_back({std::make_unique<RpcMethodStats>(0), side, "(other)"});
+                overflow_[side] = entries_.back().stats.get();
+            }
+            return overflow_[side];
+        }
+        entries_.push_back({std::make_unique<RpcMethodStats>(method_id), side, ""});
+        stats = entries_.back().stats.get();
+        table[(method_id + i) & (TABLE_SIZE - 1)].store(stats, std::memory_order_release);
+    }
+
+    if (!full_name.empty() && !stats->named_.load(std::memory_order_relaxed)) {
+        for (auto &e : entries_) {
+            if (e.stats.get() == stats) {
+                e.name = full_name;
+                break;
+            }
+        }
+        stats->named_.store(true, std::memory_order_release);
+    }
+    return stats;
+}
+
+std::string RpcStats::Dump(std::string_view filter) const {
+    char line[512];
+    std::string out;
+    std::snprintf(line, sizeof(line), "%-6s %-40s %10s %8s %8s %26s %34s\n", "side",
+                  "method", "requests", "errors", "inflight", "queue_us p50/p99/p999",
+                  "time_us p50/p99/p999/max");
+    out += line;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &e : entries_) {
+        std::string name = e.name;
+        if (name.empty()) {
+            std::snprintf(line, sizeof(line), "#%08x", e.stats->MethodID());
+            name = line;
+        }
+        if (name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        // about 8KB of histograms, kept off the stack
+        auto snap = std::make_unique<RpcMethodStats::Snapshot>();
+        e.stats->Collect(*snap);
+        const auto &q = snap->queue_us;
+        const auto &t = snap->time_us;
+        std::snprintf(line, sizeof(line),
+                      "%-6s %-40s %10lu %8lu %8lu %8lu/%8lu/%8lu %8lu/%8lu/%8lu/%8lu\n",
+                      e.side == Server ? "server" : "client", name.c_str(), snap->requests,
+                      snap->errors, snap->inflight, q.Quantile(0.5), q.Quantile(0.99),
+                      q.Quantile(0.999), t.Quantile(0.5), t.Quantile(0.99),
+                      t.Quantile(0.999), t.Quantile(1));
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,165 @@
+#ifndef _RPC_STATS_H_
+#define _RPC_STATS_H_
+
+#include <llbc.h>
+#include <singleton.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Log-linear histogram in the style of HdrHistogram: every power of two is split into
+ * 2^SUB_BITS equal buckets, so a value is known to within 1 / 2^SUB_BITS of itself
+ * whatever its magnitude. Recording is one relaxed increment.
+ */
+class RpcHistogram {
+   public:
+    static constexpr int SUB_BITS = 4;   // 16 buckets per power of two, <= 6.25% error
+    static constexpr int MAX_BITS = 32;  // larger values are clamped to 2^32 - 1
+    static constexpr std::size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+    void Record(std::uint64_t value) noexcept {
+        counts_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // add the counts of other, e.g. to merge shards
+    void Merge(const RpcHistogram &other) noexcept;
+
+    std::uint64_t Count() const noexcept;
+    // Upper bound of the values at or below which a fraction q of the records fall, or
+    // 0 if there are none. Quantile(1) is the upper bound of the largest record.
+    std::uint64_t Quantile(double q) const noexcept;
+
+    static std::size_t BucketOf(std::uint64_t value) noexcept {
+        value = std::min<std::uint64_t>(value, (std::uint64_t(1) << MAX_BITS) - 1);
+        if (value < (1U << SUB_BITS)) {
+            return static_cast<std::size_t>(value);
+        }
+        int shift = std::bit_width(value) - 1 - SUB_BITS;
+        return (static_cast<std::size_t>(shift + 1) << SUB_BITS) +
+               static_cast<std::size_t>((value >> shift) - (1U << SUB_BITS));
+    }
+
+    // largest value that falls into bucket
+    static std::uint64_t UpperBoundOf(std::size_t bucket) noexcept {
+        if (bucket < (1U << SUB_BITS)) {
+            return bucket;
+        }
+        int shift = static_cast<int>(bucket >> SUB_BITS) - 1;
+        std::uint64_t sub = (bucket & ((1U << SUB_BITS) - 1)) + (1U << SUB_BITS);
+        return ((sub + 1) << shift) - 1;
+    }
+
+   private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> counts_{};
+};
+
+/**
+ * Counters and latency histograms of one method on one side of the wire. Writers update
+ * the shard of their thread, so reactors don't contend on cache lines; readers merge the
+ * shards. Everything is lock-free.
+ *
+ * Server: queue is receive to dispatch, time is dispatch to done.
+ * Client: queue is the response's receive to its handling, time is send to completion.
+ */
+class RpcMethodStats {
+   public:
+    struct Snapshot {
+        std::uint64_t requests = 0;
+        std::uint64_t errors = 0;
+        std::uint64_t inflight = 0;
+        RpcHistogram queue_us;
+        RpcHistogram time_us;
+    };
+
+    explicit RpcMethodStats(std::uint32_t method_id) noexcept : method_id_(method_id) {}
+    ~RpcMethodStats();
+
+    RpcMethodStats(const RpcMethodStats &) = delete;
+    RpcMethodStats &operator=(const RpcMethodStats &) = delete;
+
+    // a request arrived or a call was sent, queue_us < 0 if it didn't wait
+    void Begin(llbc::sint64 queue_us = -1) noexcept;
+    // time a begun request waited in a queue
+    void RecordQueue(llbc::sint64 queue_us) noexcept;
+    // a begun request ended after time_us, time_us < 0 if it was never handled
+    void End(llbc::sint64 time_us, bool failed) noexcept;
+
+    // sum of the shards, not an atomic cut across them
+    void Collect(Snapshot &out) const noexcept;
+
+    std::uint32_t MethodID() const noexcept { return method_id_; }
+
+    static constexpr std::size_t MAX_SHARDS = 64;  // threads beyond share shards
+
+   private:
+    struct alignas(64) shard {
+        std::atomic<std::uint64_t> begun{0};
+        std::atomic<std::uint64_t> ended{0};
+        std::atomic<std::uint64_t> errors{0};
+        RpcHistogram queue_us;
+        RpcHistogram time_us;
+    };
+
+    friend class RpcStats;
+
+    // shard of the calling thread, allocated on its first record
+    shard &Local() noexcept;
+
+    const std::uint32_t method_id_;
+    std::array<std::atomic<shard *>, MAX_SHARDS> shards_{};
+    std::atomic<bool> named_{false};  // RpcStats knows the method's full name
+};
+
+/**
+ * Stats of every method the process serves or calls, see RpcMethodStats. Looking up the
+ * stats of a method is lock-free, only its first use takes a lock. RpcStatsService dumps
+ * them.
+ */
+class RpcStats : public Singleton<RpcStats> {
+    friend class Singleton<RpcStats>;
+
+   public:
+    enum Side { Server = 0, Client = 1 };
+
+    // Stats of method_id on side, created on first use. full_name names the method, e.g.
+    // "echo.EchoService.Echo"; stats created without one show the id until it is given.
+    // Never nullptr.
+    RpcMethodStats *Get(Side side, std::uint32_t method_id,
+                        std::string_view full_name = {}) noexcept;
+
+    // One line per method whose name contains filter, with request, error and in-flight
+    // counts and the percentiles of both histograms.
+    std::string Dump(std::string_view filter = {}) const;
+
+    static constexpr std::size_t TABLE_SIZE = 1024;  // methods per side, power of two
+
+   protected:
+    RpcStats() = default;
+
+   private:
+    struct entry {
+        std::unique_ptr<RpcMethodStats> stats;
+        Side side;
+        std::string name;  // full name, empty if unknown
+    };
+
+    // stats of method_id on side, nullptr if there are none yet
+    RpcMethodStats *Find(Side side, std::uint32_t method_id) const noexcept;
+
+    // method_id -> stats per side, open addressing, slots are filled once and kept
+    std::array<std::atomic<RpcMethodStats *>, TABLE_SIZE> table_[2]{};
+    RpcMethodStats *overflow_[2]{};  // shared by the methods of a full table
+    mutable std::mutex mutex_;       // serializes inserts and naming, guards below
+    std::vector<entry> entries_;     // in creation order
+};
+
+#endif  // _RPC_STATS_H_
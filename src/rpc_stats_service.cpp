@@ -0,0 +1,72 @@
+#include "rpc_stats_service.h"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/text_format.h>
+
+#include "rpc_macros.h"
+#include "rpc_stats.h"
+
+namespace {
+
+// rpc_stats.proto, see RpcStatsService
+constexpr const char *STATS_PROTO = R"pb(
+    name: "rpc_stats.proto"
+    package: "rpc"
+    dependency: "google/protobuf/wrappers.proto"
+    service {
+        name: "RpcStatsService"
+        method {
+            name: "GetStats"
+            input_type: ".google.protobuf.StringValue"
+            output_type: ".google.protobuf.StringValue"
+        }
+    }
+)pb";
+
+// pool of rpc_stats.proto, over the generated pool that holds wrappers.proto
+const ::google::protobuf::ServiceDescriptor *BuildDescriptor() {
+    // the generated pool builds a file on first lookup only
+    ::google::protobuf::StringValue::descriptor();
+
+    static ::google::protobuf::DescriptorPool pool(
+        ::google::protobuf::DescriptorPool::generated_pool());
+    ::google::protobuf::FileDescriptorProto file;
+    COND_RET_ELOG(!::google::protobuf::TextFormat::ParseFromString(STATS_PROTO, &file),
+                  nullptr, "RpcStatsService: parse rpc_stats.proto failed");
+    const auto *built = pool.BuildFile(file);
+    COND_RET_ELOG(!built, nullptr, "RpcStatsService: build rpc_stats.proto failed");
+    return built->service(0);
+}
+
+}  // namespace
+
+const ::google::protobuf::ServiceDescriptor *RpcStatsService::GetDescriptor()
+    const noexcept {
+    static const auto *descriptor = BuildDescriptor();
+    return descriptor;
+}
+
+const ::google::protobuf::MethodDescriptor *RpcStatsService::GetStatsMethod() noexcept {
+    const auto *descriptor = GetInst().GetDescriptor();
+    return descriptor ? descriptor->method(0) : nullptr;
+}
+
+std::span<const RpcService::Method> RpcStatsService::GetMethods() const noexcept {
+    COND_RET(!GetDescriptor(), {});
+    static const RpcService::Method methods[] = {
+        {GetStatsMethod(), &::google::protobuf::StringValue::default_instance(),
+         &::google::protobuf::StringValue::default_instance(), &InvokeGetStats},
+    };
+    return methods;
+}
+
+void RpcStatsService::InvokeGetStats(RpcService *, RpcController *,
+                                     const ::google::protobuf::Message *request,
+                                     ::google::protobuf::Message *response,
+                                     ::google::protobuf::Closure *done) {
+    const auto *req = static_cast<const ::google::protobuf::StringValue *>(request);
+    auto *rsp = static_cast<::google::protobuf::StringValue *>(response);
+    rsp->set_value(RpcStats::GetInst().Dump(req->value()));
+    done->Run();
+}
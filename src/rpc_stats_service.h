@@ -0,0 +1,46 @@
+#ifndef _RPC_STATS_SERVICE_H_
+#define _RPC_STATS_SERVICE_H_
+
+#include <google/protobuf/wrappers.pb.h>
+
+#include "rpc_service.h"
+
+/**
+ * Built-in service that dumps RpcStats, served only by servers that add it with
+ * RpcServer::AddService(&RpcStatsService::GetInst()):
+ *
+ *   package rpc;
+ *   service RpcStatsService {
+ *       // request: substring of the methods to dump, "" for all
+ *       // response: RpcStats::Dump() of them
+ *       rpc GetStats(google.protobuf.StringValue) returns (google.protobuf.StringValue);
+ *   }
+ *
+ * The messages are compiled into libprotobuf, so the service is described at runtime and
+ * needs no generated code:
+ *
+ *   ::google::protobuf::StringValue req, rsp;
+ *   co_await channel->Call(RpcStatsService::GetStatsMethod(), cntl.get(), &req, &rsp);
+ */
+class RpcStatsService : public RpcService {
+   public:
+    static RpcStatsService &GetInst() noexcept {
+        static RpcStatsService inst;
+        return inst;
+    }
+
+    const ::google::protobuf::ServiceDescriptor *GetDescriptor() const noexcept override;
+    std::span<const Method> GetMethods() const noexcept override;
+
+    static const ::google::protobuf::MethodDescriptor *GetStatsMethod() noexcept;
+
+   private:
+    RpcStatsService() = default;
+
+    static void InvokeGetStats(RpcService *service, RpcController *controller,
+                               const ::google::protobuf::Message *request,
+                               ::google::protobuf::Message *response,
+                               ::google::protobuf::Closure *done);
+};
+
+#endif  // _RPC_STATS_SERVICE_H_
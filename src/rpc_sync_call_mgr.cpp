@@ -0,0 +1,87 @@
+#include "rpc_sync_call_mgr.h"
+
+#include <chrono>
+
+#include "rpc_macros.h"
+
+RpcSyncCallMgr::RpcSyncCallMgr() : slots_(std::make_unique<slot[]>(MAX_PENDING)) {
+    free_slots_.reserve(MAX_PENDING);
+    // low indices on top, so hot slots stay together
+    for (std::uint32_t i = MAX_PENDING; i > 0; --i) {
+        free_slots_.push_back(i - 1);
+    }
+}
+
+RpcSyncCallMgr::seq_type RpcSyncCallMgr::Acquire() noexcept {
+    std::uint32_t idx = 0;
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        COND_RET_ELOG(free_slots_.empty(), 0UL,
+                      "Acquire: too many pending blocking calls|max: %u", MAX_PENDING);
+        idx = free_slots_.back();
+        free_slots_.pop_back();
+    }
+
+    auto &s = slots_[idx];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.in_use = true;
+    s.response = nullptr;
+    return RpcCoroMgr::MakeCoroUid(idx | SYNC_FLAG, 0, s.generation);
+}
+
+RpcSyncCallMgr::slot *RpcSyncCallMgr::SlotOf(seq_type seq) noexcept {
+    auto idx = static_cast<std::uint32_t>(seq) & (SYNC_FLAG - 1);
+    COND_RET(!IsSyncSeq(seq) || idx >= MAX_PENDING, nullptr);
+    return &slots_[idx];
+}
+
+void RpcSyncCallMgr::FreeSlot(slot &s, std::uint32_t idx) noexcept {
+    s.in_use = false;
+    if (++s.generation == 0) {
+        s.generation = 1;
+    }
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_slots_.push_back(idx);
+}
+
+llbc::LLBC_Packet *RpcSyncCallMgr::Wait(seq_type seq, llbc::sint64 timeout_ms) noexcept {
+    auto *s = SlotOf(seq);
+    COND_RET(s == nullptr, nullptr);
+
+    std::unique_lock<std::mutex> lock(s->mutex);
+    // the slot has been released and possibly taken again
+    COND_RET(!Holds(*s, seq), nullptr);
+    s->cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                     [s]() { return s->response != nullptr; });
+    auto *response = s->response;
+    s->response = nullptr;
+    FreeSlot(*s, static_cast<std::uint32_t>(s - slots_.get()));
+    return response;
+}
+
+void RpcSyncCallMgr::Release(seq_type seq) noexcept {
+    auto *s = SlotOf(seq);
+    COND_RET(s == nullptr, );
+
+    std::lock_guard<std::mutex> lock(s->mutex);
+    COND_RET(!Holds(*s, seq), );
+    if (s->response) {
+        LLBC_Recycle(s->response);
+        s->response = nullptr;
+    }
+    FreeSlot(*s, static_cast<std::uint32_t>(s - slots_.get()));
+}
+
+bool RpcSyncCallMgr::Complete(seq_type seq, llbc::LLBC_Packet *packet) noexcept {
+    auto *s = SlotOf(seq);
+    COND_RET(s == nullptr, false);
+
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        // timed out, or a duplicate response
+        COND_RET(!Holds(*s, seq) || s->response, false);
+        s->response = packet;
+    }
+    s->cond.notify_one();
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef _RPC_SYNC_CALL_MGR_H_
+#define _RPC_SYNC_CALL_MGR_H_
+
+#include <llbc.h>
+#include <singleton.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rpc_coro_mgr.h"
+
+/**
+ * Completion slots of blocking calls, shared by all threads.
+ * A blocking call takes a slot, sends its request with the slot's seq and sleeps on the
+ * slot's condition variable. The connection component hands the response straight to the
+ * slot from the service thread, so any number of threads can have blocking calls in
+ * flight over the same channel, without a reactor loop running, and each one gets exactly
+ * its own response.
+ *
+ * A seq uses the coro_uid layout of RpcCoroMgr with SYNC_FLAG set in the slot index,
+ * which coro slots never reach. The generation is bumped whenever a slot is released, so
+ * late responses of timed-out calls are dropped.
+ */
+class RpcSyncCallMgr : public Singleton<RpcSyncCallMgr> {
+    friend class Singleton<RpcSyncCallMgr>;
+
+   public:
+    using seq_type = RpcCoroMgr::coro_uid_type;
+
+    // @return the seq of a free slot, or 0 if all slots are taken
+    seq_type Acquire() noexcept;
+
+    // Wait for the response of seq for at most timeout_ms, then release the slot.
+    // @return the response, owned by the caller, or nullptr on timeout or if seq doesn't
+    // hold its slot
+    llbc::LLBC_Packet *Wait(seq_type seq, llbc::sint64 timeout_ms) noexcept;
+
+    // release a slot without waiting, e.g. when sending failed; a stale seq is ignored
+    void Release(seq_type seq) noexcept;
+
+    // Hand a response to its waiting caller.
+    // @return false if nobody waits for seq anymore, the packet is then still the caller's
+    bool Complete(seq_type seq, llbc::LLBC_Packet *packet) noexcept;
+
+    static constexpr bool IsSyncSeq(seq_type seq) noexcept {
+        return (seq & SYNC_FLAG) != 0;
+    }
+
+    static constexpr std::uint32_t MAX_PENDING = 4096;  // concurrent blocking calls
+    static constexpr std::uint32_t SYNC_FLAG = 1U << (RpcCoroMgr::REACTOR_SHIFT - 1);
+    static_assert(RpcCoroMgr::MAX_SUSPENDED <= SYNC_FLAG);
+    static_assert(MAX_PENDING <= SYNC_FLAG);
+
+   protected:
+    RpcSyncCallMgr();
+
+   private:
+    struct slot {
+        std::mutex mutex;
+        std::condition_variable cond;
+        llbc::LLBC_Packet *response = nullptr;
+        std::uint32_t generation = 1;
+        bool in_use = false;
+    };
+
+    // slot of seq, or nullptr if seq is malformed
+    slot *SlotOf(seq_type seq) noexcept;
+    // whether seq is the call holding the slot, its mutex must be held
+    static bool Holds(const slot &s, seq_type seq) noexcept {
+        return s.in_use && s.generation == static_cast<std::uint32_t>(seq >> 32);
+    }
+    // free a slot, its mutex must be held
+    void FreeSlot(slot &s, std::uint32_t idx) noexcept;
+
+    std::unique_ptr<slot[]> slots_;
+    std::mutex free_mutex_;                  // guards free_slots_
+    std::vector<std::uint32_t> free_slots_;  // free slot indices
+};
+
+#endif  // _RPC_SYNC_CALL_MGR_H_
@@ -4,6 +4,8 @@
 
 #include <zookeeper/zookeeper.h>
 
+#include <condition_variable>
+
 namespace utility {
 
 static const int32_t zoo_path_buf_len = 1024;
@@ -65,6 +67,30 @@ static void default_void_completion_func(int rc, const void* data) {
     printf("default_void_completion_func, rc = %d, data: %p\n", rc, data);
 }
 
+// replies of a create_nodes() batch, filled in by the completion thread
+struct create_batch {
+    std::mutex mtx;
+    std::condition_variable cv;
+    int32_t pending = 0;
+    std::vector<zoo_rc>* results = nullptr;
+};
+
+struct create_ctx {
+    create_batch* batch;
+    size_t idx;
+};
+
+static void create_completion_func(int rc, const char* value, const void* data) {
+    const create_ctx* ctx = (const create_ctx*)data;
+    create_batch* batch = ctx->batch;
+
+    std::lock_guard<std::mutex> locker(batch->mtx);
+    (*batch->results)[ctx->idx] = (zoo_rc)rc;
+    if (--batch->pending == 0) {
+        batch->cv.notify_all();
+    }
+}
+
 static void state_to_zoo_state_t(const struct Stat& s, zoo_state_t* state) {
     state->ctime = s.ctime;
     state->mtime = s.mtime;
@@ -236,6 +262,54 @@ zoo_rc zk_cpp::create_sequance_ephemeral_node(const char* path, const std::strin
     return rt;
 }
 
+zoo_rc zk_cpp::create_nodes(const std::vector<zoo_create_op_t>& ops,
+                            const std::vector<zoo_acl_t>& acl,
+                            std::vector<zoo_rc>& results) {
+    results.assign(ops.size(), z_ok);
+
+    struct ACL_vector acl_v;
+    acl_v.count = (int32_t)acl.size();
+    std::vector<struct ACL> acl_list(acl.size());
+    for (size_t i = 0; i < acl.size(); ++i) {
+        acl_list[i].perms = acl[i].perm;
+        acl_list[i].id.scheme = (char*)acl[i].scheme.c_str();
+        acl_list[i].id.id = (char*)acl[i].id.c_str();
+    }
+    acl_v.data = acl_list.empty() ? NULL : acl_list.data();
+
+    details::create_batch batch;
+    batch.results = &results;
+    std::vector<details::create_ctx> ctxs(ops.size());
+
+    zoo_rc rt = z_ok;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        ctxs[i] = {&batch, i};
+        {
+            std::lock_guard<std::mutex> locker(batch.mtx);
+            ++batch.pending;
+        }
+        // the request is serialized right away, acl_v needs not outlive the call
+        int rc = zoo_acreate((zhandle_t*)m_zh, ops[i].path.c_str(), ops[i].value.c_str(),
+                             (int)ops[i].value.size(), &acl_v, ops[i].flags,
+                             details::create_completion_func, &ctxs[i]);
+        if (rc != ZOK) {
+            std::lock_guard<std::mutex> locker(batch.mtx);
+            --batch.pending;
+            rt = (zoo_rc)rc;
+            // this one and the rest were never sent
+            for (size_t j = i; j < ops.size(); ++j) {
+                results[j] = rt;
+            }
+            break;
+        }
+    }
+
+    // every sent request is completed, on connection loss too
+    std::unique_lock<std::mutex> locker(batch.mtx);
+    batch.cv.wait(locker, [&batch]() { return batch.pending == 0; });
+    return rt;
+}
+
 zoo_rc zk_cpp::delete_node(const char* path, int32_t version) {
     return (zoo_rc)zoo_delete((zhandle_t*)m_zh, path, version);
 }
@@ -115,6 +115,20 @@ enum zoo_log_lvl {
     zoo_log_lvl_debug = 4,
 };
 
+/** node create flags, may be or-ed */
+enum zoo_create_flag {
+    zoo_create_persistent = 0,
+    zoo_create_ephemeral = 1,
+    zoo_create_sequence = 2,
+};
+
+/** one node of a batch create, see {@link zk_cpp#create_nodes} */
+struct zoo_create_op_t {
+    std::string path;
+    std::string value;
+    int32_t     flags;  // see {@link #zoo_create_flag}
+};
+
 /** zoo node info */
 struct zoo_state_t {
     int64_t ctime;              // node create time
@@ -329,6 +343,20 @@ public:
      */
     zoo_rc      create_sequance_ephemeral_node(const char* path, const std::string& value, const std::vector<zoo_acl_t>& acl, std::string& returned_path_name);
 
+    /** 
+     * @brief create several nodes in one round trip
+     *
+     * the creates are pipelined: all requests are sent before waiting for any reply.
+     * zookeeper applies the requests of a session in order, so a node may be created
+     * after its parent in the same batch. unlike a multi op, each create succeeds or
+     * fails on its own, e.g. an existing node only fails its own create.
+     *
+     * @param ops       - the nodes to create
+     * @param results   - result of each create, see {@link #create_node}
+     * @return z_ok if every request was sent, else the error of the first failed send
+     */
+    zoo_rc      create_nodes(const std::vector<zoo_create_op_t>& ops, const std::vector<zoo_acl_t>& acl, std::vector<zoo_rc>& results);
+
 
     /** 
      * @brief   try delete a node  synchronously
@@ -0,0 +1,108 @@
+#include "mpsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(MPSCQueueTest, PushPop) {
+    MPSCQueue<int, 4> q;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.emplace(i));
+    }
+    ASSERT_FALSE(q.emplace(4));
+    ASSERT_EQ(q.size(), 4);
+
+    int item = -1;
+    for (int lap = 0; lap < 3; ++lap) {  // wraps around
+        ASSERT_TRUE(q.pop(item));
+        ASSERT_EQ(item, lap);
+        ASSERT_TRUE(q.emplace(lap + 4));
+    }
+    int out[8];
+    ASSERT_EQ(q.pop_n(out, 8), 4);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(out[i], i + 3);
+    }
+    ASSERT_FALSE(q.pop(item));
+    ASSERT_TRUE(q.empty());
+}
+
+TEST(MPSCQueueTest, RuntimeCapacity) {
+    MPSCQueue<int> q(3);
+    ASSERT_EQ(q.capacity(), 3);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(q.emplace(i));
+    }
+    ASSERT_FALSE(q.emplace(3));
+}
+
+// A single slot can't tell a published item from a free one, so 1 is rounded up to 2.
+TEST(MPSCQueueTest, RuntimeCapacityMin) {
+    for (size_t capacity : {1, 2}) {
+        MPSCQueue<int> q(capacity);
+        ASSERT_EQ(q.capacity(), 2);
+        for (int lap = 0; lap < 3; ++lap) {
+            ASSERT_TRUE(q.emplace(lap * 2));
+            ASSERT_TRUE(q.emplace(lap * 2 + 1));
+            ASSERT_FALSE(q.emplace(-1));
+            ASSERT_EQ(q.size(), 2);
+
+            int item = -1;
+            ASSERT_TRUE(q.pop(item));
+            ASSERT_EQ(item, lap * 2);
+            ASSERT_TRUE(q.pop(item));
+            ASSERT_EQ(item, lap * 2 + 1);
+            ASSERT_FALSE(q.pop(item));
+        }
+    }
+}
+
+TEST(MPSCQueueTest, Destroy) {
+    auto item = std::make_shared<int>(1);
+    {
+        MPSCQueue<std::shared_ptr<int>, 8> q;
+        q.emplace(item);
+        q.emplace(item);
+        ASSERT_EQ(item.use_count(), 3);
+    }
+    ASSERT_EQ(item.use_count(), 1);
+}
+
+// Several producers racing on a small queue: every item arrives exactly once and each
+// producer's items arrive in the order they were pushed.
+TEST(MPSCQueueTest, Stress) {
+    constexpr int producers = 8;
+    constexpr int count = 50000;
+    MPSCQueue<std::uint64_t, 1024> q;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p] {
+            for (std::uint64_t i = 0; i < count; ++i) {
+                while (!q.emplace((static_cast<std::uint64_t>(p) << 32) | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<std::uint64_t> next(producers, 0);
+    std::uint64_t items[64];
+    for (int received = 0; received < producers * count;) {
+        auto n = q.pop_n(items, 64);
+        for (size_t i = 0; i < n; ++i) {
+            auto p = items[i] >> 32;
+            ASSERT_LT(p, producers);
+            ASSERT_EQ(items[i] & 0xffffffff, next[p]++);
+        }
+        received += static_cast<int>(n);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    ASSERT_TRUE(q.empty());
+    for (int p = 0; p < producers; ++p) {
+        ASSERT_EQ(next[p], count);
+    }
+}
@@ -0,0 +1,65 @@
+#include "object_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unordered_set>
+
+struct PoolItem {
+   public:
+    PoolItem() = default;
+    PoolItem(int a) : a(a) {}
+    ~PoolItem() { ++destroyed; }
+
+    int a = 0;
+    std::string s;
+
+    static inline int destroyed = 0;
+};
+
+TEST(ObjectPoolTest, Acquire) {
+    ObjectPool<PoolItem, 4> pool;
+    std::unordered_set<PoolItem *> items;
+    for (int i = 0; i < 10; ++i) {
+        auto *item = pool.acquire(i);
+        ASSERT_EQ(item->a, i);
+        items.insert(item);
+    }
+    ASSERT_EQ(items.size(), 10);
+    ASSERT_EQ(pool.size(), 10);
+    ASSERT_EQ(pool.idle(), 0);
+    for (auto *item : items) {
+        pool.release(item);
+    }
+    ASSERT_EQ(pool.idle(), 10);
+}
+
+TEST(ObjectPoolTest, Reuse) {
+    ObjectPool<PoolItem, 4> pool;
+    auto *item = pool.acquire(1);
+    item->s.assign(100, 'x');
+    auto capacity = item->s.capacity();
+    item->s.clear();
+    pool.release(item);
+
+    auto *reused = pool.acquire(2);
+    ASSERT_EQ(reused, item);
+    // released objects are kept constructed
+    ASSERT_EQ(reused->a, 1);
+    ASSERT_EQ(reused->s.capacity(), capacity);
+    ASSERT_EQ(pool.size(), 1);
+    pool.release(reused);
+}
+
+TEST(ObjectPoolTest, Destroy) {
+    PoolItem::destroyed = 0;
+    {
+        ObjectPool<PoolItem, 4> pool;
+        for (int i = 0; i < 6; ++i) {
+            pool.release(pool.acquire());
+            pool.acquire();
+        }
+        ASSERT_EQ(pool.size(), 6);
+    }
+    ASSERT_EQ(PoolItem::destroyed, 6);
+}
@@ -0,0 +1,70 @@
+#include "parker.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "spsc_queue.h"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start)
+        .count();
+}
+
+TEST(ParkerTest, Timeout) {
+    Parker parker;
+    auto start = Clock::now();
+    ASSERT_FALSE(parker.park([]() { return false; }, 20));
+    ASSERT_GE(ElapsedMs(start), 20);
+}
+
+TEST(ParkerTest, Ready) {
+    Parker parker;
+    auto start = Clock::now();
+    ASSERT_TRUE(parker.park([]() { return true; }, 10000));
+    ASSERT_LT(ElapsedMs(start), 1000);
+}
+
+TEST(ParkerTest, Unpark) {
+    Parker parker;
+    std::atomic<bool> ready{false};
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ready.store(true);
+        parker.unpark();
+    });
+    auto start = Clock::now();
+    while (!ready.load()) {
+        parker.park([&]() { return ready.load(); }, 10000);
+    }
+    ASSERT_LT(ElapsedMs(start), 5000);
+    producer.join();
+}
+
+TEST(ParkerTest, NoLostWakeup) {
+    // every park would take 10s if an unpark() were lost
+    constexpr int COUNT = 100000;
+    Parker parker;
+    SPSCQueue<int, 64> q;
+    std::thread producer([&]() {
+        for (int i = 0; i < COUNT; ++i) {
+            while (!q.emplace(i)) {
+            }
+            parker.unpark();
+        }
+    });
+    auto start = Clock::now();
+    for (int expected = 0; expected < COUNT;) {
+        int value;
+        if (q.pop(value)) {
+            ASSERT_EQ(value, expected++);
+            continue;
+        }
+        parker.park([&]() { return !q.empty(); }, 10000);
+    }
+    ASSERT_LT(ElapsedMs(start), 10000);
+    producer.join();
+}
@@ -0,0 +1,204 @@
+#include "shm_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+// a ring over 64-aligned memory the test owns, as a shared mapping would be
+struct RingMemory {
+    explicit RingMemory(std::size_t capacity)
+        : size(ShmRing::region_size(capacity)),
+          mem(static_cast<char *>(::operator new(size, std::align_val_t(64)))) {}
+    ~RingMemory() { ::operator delete(mem, std::align_val_t(64)); }
+
+    std::size_t size;
+    char *mem;
+};
+
+static bool Push(ShmRing &ring, const std::string &msg) {
+    auto *p = ring.reserve(msg.size());
+    if (!p) return false;
+    std::memcpy(p, msg.data(), msg.size());
+    ring.commit();
+    return true;
+}
+
+static bool Pop(ShmRing &ring, std::string &msg) {
+    std::size_t len = 0;
+    auto *p = ring.front(len);
+    if (!p) return false;
+    msg.assign(static_cast<const char *>(p), len);
+    ring.pop();
+    return true;
+}
+
+TEST(ShmRingTest, Empty) {
+    RingMemory memory(1024);
+    auto ring = ShmRing::create(memory.mem, 1024);
+    ASSERT_TRUE(ring.valid());
+    ASSERT_TRUE(ring.empty());
+    std::string msg;
+    ASSERT_FALSE(Pop(ring, msg));
+}
+
+TEST(ShmRingTest, PushPop) {
+    RingMemory memory(1024);
+    auto producer = ShmRing::create(memory.mem, 1024);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+    ASSERT_TRUE(consumer.valid());
+
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(Push(producer, "msg" + std::to_string(i)));
+    }
+    ASSERT_FALSE(consumer.empty());
+    for (int i = 0; i < 10; ++i) {
+        std::string msg;
+        ASSERT_TRUE(Pop(consumer, msg));
+        ASSERT_EQ(msg, "msg" + std::to_string(i));
+    }
+    std::string msg;
+    ASSERT_FALSE(Pop(consumer, msg));
+    ASSERT_TRUE(consumer.empty());
+
+    // zero-length records are records too
+    ASSERT_TRUE(Push(producer, ""));
+    ASSERT_TRUE(Pop(consumer, msg));
+    ASSERT_TRUE(msg.empty());
+}
+
+TEST(ShmRingTest, Full) {
+    RingMemory memory(1024);
+    auto producer = ShmRing::create(memory.mem, 1024);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+
+    ASSERT_EQ(producer.reserve(producer.max_record() + 1), nullptr);
+    // 8 bytes of length plus 24 of data take 32 bytes
+    std::string record(24, 'x');
+    for (int i = 0; i < 1024 / 32; ++i) {
+        ASSERT_TRUE(Push(producer, record));
+    }
+    ASSERT_FALSE(Push(producer, record));
+
+    std::string msg;
+    ASSERT_TRUE(Pop(consumer, msg));
+    ASSERT_TRUE(Push(producer, record));
+    ASSERT_FALSE(Push(producer, record));
+}
+
+TEST(ShmRingTest, Wrap) {
+    RingMemory memory(1024);
+    auto producer = ShmRing::create(memory.mem, 1024);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+
+    // sizes that leave odd gaps at the end, so records start over at the beginning
+    for (int i = 0; i < 1000; ++i) {
+        std::string record(i % 300, static_cast<char>('a' + i % 26));
+        ASSERT_TRUE(Push(producer, record));
+        if (i % 3 == 0) {
+            ASSERT_TRUE(Push(producer, record));
+        }
+
+        std::string msg;
+        ASSERT_TRUE(Pop(consumer, msg));
+        ASSERT_EQ(msg, record);
+        if (i % 3 == 0) {
+            ASSERT_TRUE(Pop(consumer, msg));
+            ASSERT_EQ(msg, record);
+        }
+        ASSERT_TRUE(consumer.empty());
+    }
+}
+
+TEST(ShmRingTest, Attach) {
+    RingMemory memory(1024);
+    ASSERT_FALSE(ShmRing::attach(memory.mem, 16).valid());
+
+    std::memset(memory.mem, 0, memory.size);
+    ASSERT_FALSE(ShmRing::attach(memory.mem, memory.size).valid());
+
+    ShmRing::create(memory.mem, 1024);
+    ASSERT_TRUE(ShmRing::attach(memory.mem, memory.size).valid());
+    // the header claims more memory than there is
+    ASSERT_FALSE(ShmRing::attach(memory.mem, memory.size - 1).valid());
+}
+
+TEST(ShmRingTest, Broken) {
+    RingMemory memory(1024);
+    auto producer = ShmRing::create(memory.mem, 1024);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+
+    ASSERT_TRUE(Push(producer, "hello"));
+    // the other process scribbles over the length
+    std::uint64_t length = 4096;
+    std::memcpy(memory.mem + memory.size - 1024, &length, sizeof(length));
+
+    std::string msg;
+    ASSERT_FALSE(Pop(consumer, msg));
+    ASSERT_TRUE(consumer.broken());
+}
+
+TEST(ShmRingTest, Wake) {
+    RingMemory memory(1024);
+    auto producer = ShmRing::create(memory.mem, 1024);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+
+    // nobody sleeps, nobody is woken
+    ASSERT_TRUE(producer.reserve(1));
+    ASSERT_FALSE(producer.commit());
+
+    // records arrived, don't sleep
+    ASSERT_FALSE(consumer.prepare_wait());
+    consumer.finish_wait();
+
+    std::string msg;
+    ASSERT_TRUE(Pop(consumer, msg));
+    ASSERT_TRUE(consumer.prepare_wait());
+    ASSERT_TRUE(producer.reserve(1));
+    ASSERT_TRUE(producer.commit());
+    // woken once only
+    ASSERT_TRUE(producer.reserve(1));
+    ASSERT_FALSE(producer.commit());
+}
+
+TEST(ShmRingTest, MultiThread) {
+    constexpr int RECORDS = 200000;
+    RingMemory memory(4096);
+    auto producer = ShmRing::create(memory.mem, 4096);
+    auto consumer = ShmRing::attach(memory.mem, memory.size);
+
+    std::thread t([&producer] {
+        for (int i = 0; i < RECORDS; ++i) {
+            auto len = static_cast<std::size_t>(i % 200);
+            void *p;
+            while (!(p = producer.reserve(sizeof(i) + len))) {
+                std::this_thread::yield();
+            }
+            std::memcpy(p, &i, sizeof(i));
+            std::memset(static_cast<char *>(p) + sizeof(i), i & 0xff, len);
+            producer.commit();
+        }
+    });
+
+    for (int i = 0; i < RECORDS; ++i) {
+        std::size_t len = 0;
+        const void *p;
+        while (!(p = consumer.front(len))) {
+            ASSERT_FALSE(consumer.broken());
+            std::this_thread::yield();
+        }
+        int value;
+        std::memcpy(&value, p, sizeof(value));
+        ASSERT_EQ(value, i);
+        ASSERT_EQ(len, sizeof(i) + i % 200);
+        auto *data = static_cast<const unsigned char *>(p) + sizeof(i);
+        for (std::size_t k = 0; k < len - sizeof(i); ++k) {
+            ASSERT_EQ(data[k], i & 0xff);
+        }
+        consumer.pop();
+    }
+    t.join();
+    ASSERT_TRUE(consumer.empty());
+}
@@ -2,6 +2,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <thread>
 
 struct Item {
@@ -101,4 +102,69 @@ TEST(SPSCQueueTest, Concurrency) {
 
     producer.join();
     consumer.join();
-}
\ No newline at end of file
+}
+
+TEST(SPSCQueueTest, Batch) {
+    SPSCQueue<int, 8> q;
+    int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    ASSERT_EQ(q.push_n(in, 5), 5);
+    ASSERT_EQ(q.push_n(in + 5, 5), 2);  // only 7 slots
+    ASSERT_EQ(q.push_n(in, 1), 0);
+
+    int out[10];
+    ASSERT_EQ(q.pop_n(out, 3), 3);
+    ASSERT_EQ(q.push_n(in + 7, 3), 3);  // wraps around
+    ASSERT_EQ(q.pop_n(out + 3, 10), 7);
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(out[i], i);
+    }
+    ASSERT_EQ(q.pop_n(out, 10), 0);
+    ASSERT_TRUE(q.empty());
+}
+
+TEST(SPSCQueueTest, BatchConcurrency) {
+    constexpr int count = 1000000;
+    SPSCQueue<int, 1024> q;
+    std::thread producer([&q] {
+        int items[64];
+        for (int i = 0; i < count;) {
+            int n = std::min(64, count - i);
+            for (int j = 0; j < n; ++j) items[j] = i + j;
+            i += static_cast<int>(q.push_n(items, n));
+        }
+    });
+
+    std::thread consumer([&q] {
+        int items[48];
+        for (int i = 0; i < count;) {
+            auto n = q.pop_n(items, 48);
+            for (size_t j = 0; j < n; ++j) {
+                ASSERT_EQ(items[j], i++);
+            }
+        }
+        ASSERT_TRUE(q.empty());
+    });
+
+    producer.join();
+    consumer.join();
+}
+
+TEST(SPSCQueueTest, RuntimeCapacity) {
+    SPSCQueue<Item> q(3);
+    ASSERT_EQ(q.capacity(), 3);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(q.emplace(i, i + 1));
+    }
+    ASSERT_FALSE(q.emplace(3, 4));
+    ASSERT_EQ(q.size(), 3);
+
+    Item item;
+    ASSERT_TRUE(q.pop(item));
+    ASSERT_TRUE(q.emplace(3, 4));  // wraps around
+    ASSERT_EQ(q.size(), 3);
+    for (int i = 1; i < 4; ++i) {
+        ASSERT_TRUE(q.pop(item));
+        ASSERT_EQ(item.a, i);
+    }
+    ASSERT_TRUE(q.empty());
+}
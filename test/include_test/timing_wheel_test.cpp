@@ -0,0 +1,113 @@
+#include "timing_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+struct TestTimer : TimerNode {
+    int id = 0;
+    int64_t fired_at = -1;
+};
+
+TEST(TimingWheelTest, Expire) {
+    TimingWheel wheel(1000);
+    std::vector<TestTimer> timers(5);
+    const int64_t delays[] = {0, 1, 255, 256, 100000};
+    for (int i = 0; i < 5; ++i) {
+        timers[i].id = i;
+        wheel.add(&timers[i], 1000 + delays[i]);
+    }
+    ASSERT_EQ(wheel.size(), 5);
+
+    int64_t now = 1000;
+    auto fire = [&](TimerNode *node) { static_cast<TestTimer *>(node)->fired_at = now; };
+    for (; now <= 1000 + 100000; ++now) {
+        wheel.advance(now, fire);
+    }
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(timers[i].fired_at, 1000 + delays[i]);
+        ASSERT_FALSE(timers[i].linked());
+    }
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, Cancel) {
+    TimingWheel wheel(0);
+    TestTimer a, b;
+    wheel.add(&a, 10);
+    wheel.add(&b, 5000);
+    wheel.cancel(&a);
+    wheel.cancel(&a);  // no-op when not linked
+    ASSERT_EQ(wheel.size(), 1);
+
+    int fired = 0;
+    wheel.advance(10000, [&](TimerNode *node) {
+        ASSERT_EQ(node, &b);
+        ++fired;
+    });
+    ASSERT_EQ(fired, 1);
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, LargeStep) {
+    // expiry must not depend on how often advance() is called
+    TimingWheel wheel(0);
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int64_t> dist(0, 1 << 20);
+    std::vector<TestTimer> timers(1000);
+    for (auto &t : timers) {
+        wheel.add(&t, dist(gen));
+    }
+    int64_t now = 0;
+    while (!wheel.empty()) {
+        now += 777;
+        wheel.advance(now, [&](TimerNode *node) {
+            auto *t = static_cast<TestTimer *>(node);
+            ASSERT_LE(t->expire, now);
+            ASSERT_GT(t->expire, now - 777);
+            t->fired_at = now;
+        });
+    }
+    for (auto &t : timers) {
+        ASSERT_NE(t.fired_at, -1);
+    }
+}
+
+TEST(TimingWheelTest, AddInCallback) {
+    TimingWheel wheel(0);
+    TestTimer a, b;
+    wheel.add(&a, 3);
+    int fired = 0;
+    for (int64_t now = 0; now < 10; ++now) {
+        wheel.advance(now, [&](TimerNode *node) {
+            ++fired;
+            // re-adding at the current tick fires on the next advance, not in this one
+            if (node == &a) wheel.add(&b, now);
+        });
+    }
+    ASSERT_EQ(fired, 2);
+    ASSERT_EQ(b.expire, 4);
+}
+
+TEST(TimingWheelTest, NextExpire) {
+    TimingWheel wheel(1000);
+    ASSERT_EQ(wheel.next_expire(), INT64_MAX);
+
+    TestTimer near, far;
+    wheel.add(&near, 1010);
+    wheel.add(&far, 1000 + 100000);
+    ASSERT_EQ(wheel.next_expire(), 1010);
+
+    // never later than the real expiry while advancing towards the far timer
+    wheel.cancel(&near);
+    int64_t now = 1000;
+    while (!wheel.empty()) {
+        auto next = wheel.next_expire();
+        ASSERT_GE(next, now);
+        ASSERT_LE(next, far.expire);
+        now = next;
+        wheel.advance(now, [](TimerNode *) {});
+    }
+    ASSERT_EQ(now, far.expire);
+}
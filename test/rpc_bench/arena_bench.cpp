@@ -0,0 +1,91 @@
+// Allocation count of the server dispatch path: heap-allocated req/rsp/controller/done
+// (the old HandleRpcReq) against one pooled arena per request (RpcArenaPool).
+
+#include <google/protobuf/stubs/callback.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include "echo.pb.h"
+#include "rpc_arena_pool.h"
+#include "rpc_controller.h"
+
+static std::atomic<std::size_t> g_allocs{0};
+
+void *operator new(std::size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+static constexpr int ITERATIONS = 1000000;
+
+using ReqRsp = std::pair<::google::protobuf::Message *, ::google::protobuf::Message *>;
+
+static void OnDone(RpcController *controller, ReqRsp req_rsp) {
+    delete req_rsp.first;
+    delete req_rsp.second;
+    delete controller;
+}
+
+struct ArenaDone : public ::google::protobuf::Closure {
+    ArenaDone(RpcArenaPool *pool, ::google::protobuf::Arena *arena)
+        : pool(pool), arena(arena) {}
+    void Run() override { pool->Put(arena); }
+
+    RpcArenaPool *pool;
+    ::google::protobuf::Arena *arena;
+};
+
+template <typename Fn>
+static void Run(const char *name, Fn &&fn) {
+    fn();  // warm up
+    auto allocs = g_allocs.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        fn();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    std::printf("%-8s allocs/call: %.2f  ns/call: %.1f\n", name,
+                double(g_allocs.load() - allocs) / ITERATIONS, double(ns) / ITERATIONS);
+}
+
+int main() {
+    echo::EchoRequest proto;
+    proto.set_msg("Hello, Echo.");
+    const std::string wire = proto.SerializeAsString();
+    const auto &req_prototype = echo::EchoRequest::default_instance();
+    const auto &rsp_prototype = echo::EchoResponse::default_instance();
+
+    Run("heap", [&]() {
+        auto *req = req_prototype.New();
+        req->ParseFromArray(wire.data(), static_cast<int>(wire.size()));
+        auto *rsp = rsp_prototype.New();
+        auto *controller = new RpcController(true);
+        auto *done = ::google::protobuf::NewCallback(&OnDone, controller, ReqRsp{req, rsp});
+        rsp->set_msg(req->msg());
+        done->Run();
+    });
+
+    RpcArenaPool pool;
+    Run("arena", [&]() {
+        auto *arena = pool.Get();
+        auto *req = req_prototype.New(arena);
+        req->ParseFromArray(wire.data(), static_cast<int>(wire.size()));
+        auto *rsp = rsp_prototype.New(arena);
+        ::google::protobuf::Arena::Create<RpcController>(arena, true);
+        auto *done = ::google::protobuf::Arena::Create<ArenaDone>(arena, &pool, arena);
+        rsp->set_msg(req->msg());
+        done->Run();
+    });
+
+    return 0;
+}
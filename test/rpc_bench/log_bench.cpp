@@ -0,0 +1,126 @@
+// Calls per second through the per-call code of both sides, with the logger at INFO and
+// at ERROR: the server reads the request and writes the response, the client hands it
+// to RpcServiceMgr::HandleRpcRsp(), which resumes the waiting coro. No network, so the
+// difference is what logging costs each call.
+
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+
+#include <llbc.h>
+
+#include "echo.pb.h"
+#include "rpc_channel.h"
+#include "rpc_controller.h"
+#include "rpc_coro_mgr.h"
+#include "rpc_service_mgr.h"
+
+static constexpr int CALLS = 200000;
+
+// makes the response handler callable
+class BenchServiceMgr : public RpcServiceMgr {
+   public:
+    using RpcServiceMgr::HandleRpcRsp;
+};
+
+// a caller that waits for responses forever
+struct Waiter {
+    struct promise_type {
+        Waiter get_return_object() noexcept {
+            return {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+static Waiter Wait(std::uint64_t &resumed) {
+    for (;;) {
+        co_await std::suspend_always{};
+        ++resumed;
+    }
+}
+
+static bool InitLogger(const char *level) {
+    const char *path = "log_bench.cfg";
+    auto *file = std::fopen(path, "w");
+    if (!file) return false;
+    std::fprintf(file,
+                 "root.asynchronous=true\n"
+                 "root.logToConsole=false\n"
+                 "root.logToFile=true\n"
+                 "root.fileLogLevel=%s\n"
+                 "root.logFile=./log/log_bench\n"
+                 "root.logFileSuffix=.log\n",
+                 level);
+    std::fclose(file);
+    LLBC_LoggerMgrSingleton->Finalize();
+    return LLBC_LoggerMgrSingleton->Initialize(path) == LLBC_OK;
+}
+
+static void Run(const char *level) {
+    if (!InitLogger(level)) {
+        std::printf("%-5s  init logger FAILED\n", level);
+        return;
+    }
+
+    BenchServiceMgr mgr;
+    std::uint64_t resumed = 0;
+    auto waiter = Wait(resumed);
+    RpcController controller(true);
+    echo::EchoRequest req, server_req;
+    echo::EchoResponse rsp, server_rsp;
+    req.set_msg("hello, this is a request of a typical size for an echo call");
+    server_rsp.set_msg(req.msg());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALLS; ++i) {
+        auto seq = RpcCoroMgr::GetInst().AddCoroContext({
+            .timeout_time = llbc::LLBC_GetMilliSeconds() + RpcCoroMgr::CORO_TIME_OUT,
+            .handle = waiter.handle,
+            .rsp = &rsp,
+            .controller = &controller,
+        });
+
+        // client -> server
+        llbc::LLBC_Packet req_packet;
+        RpcChannel::PkgHead head;
+        head.method_id = 1;
+        head.seq = seq;
+        RpcChannel::WriteMessage(req_packet, head, req);
+
+        RpcChannel::PkgHead server_head;
+        server_head.FromPacket(req_packet);
+        RpcChannel::ReadMessage(req_packet, server_head, server_req);
+
+        // server -> client
+        llbc::LLBC_Packet rsp_packet;
+        RpcChannel::WriteMessage(rsp_packet, server_head, server_rsp);
+        rsp_packet.SetExtData1(llbc::LLBC_GetMicroSeconds());
+        mgr.HandleRpcRsp(rsp_packet);
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    bool ok = resumed == CALLS && rsp.msg() == req.msg();
+    std::printf("%-5s  %8.0f calls/s  %6.2f us/call  %s\n", level, CALLS * 1e6 / us,
+                static_cast<double>(us) / CALLS, ok ? "ok" : "FAILED");
+    waiter.handle.destroy();
+}
+
+int main() {
+    if (llbc::LLBC_Startup() != LLBC_OK) {
+        std::printf("llbc startup failed\n");
+        return 1;
+    }
+    Run("INFO");
+    Run("ERROR");
+    LLBC_LoggerMgrSingleton->Finalize();
+    llbc::LLBC_Cleanup();
+    return 0;
+}
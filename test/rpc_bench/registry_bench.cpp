@@ -0,0 +1,63 @@
+// Server startup registration of a 50-method service against a registry with a simulated
+// round trip: the per-node path registration used to take, a round trip for each
+// method's node and one for its backend, against one batched RegisterServices.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <llbc.h>
+
+#include "rpc_fake_registry.h"
+#include "rpc_registry.h"
+
+static constexpr int METHODS = 50;
+static constexpr std::uint32_t ROUND_TRIP_US = 500;  // a zookeeper in the same datacenter
+
+template <typename Fn>
+static void Run(const char *name, Fn &&fn) {
+    RpcFakeRegistry fake(ROUND_TRIP_US);
+    RpcRegistry registry(fake.NewClient());
+    auto client = fake.NewClient();
+    std::vector<std::string> svc_mds;
+    for (int i = 0; i < METHODS; ++i) {
+        svc_mds.push_back("BenchService.Method" + std::to_string(i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = fn(registry, *client, svc_mds);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    // every method must see the backend
+    for (const auto &svc_md : svc_mds) {
+        ok = ok && fake.Children("/" + svc_md).size() == 1;
+    }
+    std::printf("%-10s round trips: %3lu  startup: %6.2f ms  %s\n", name,
+                static_cast<unsigned long>(fake.RoundTrips()), us / 1000.0,
+                ok ? "ok" : "FAILED");
+}
+
+using Methods = std::vector<std::string>;
+
+int main() {
+    const std::string addr = "127.0.0.1:6688";
+    Run("per-method", [&addr](RpcRegistry &, RpcRegistryClient &client,
+                              const Methods &svc_mds) {
+        for (const auto &svc_md : svc_mds) {
+            auto path = "/" + svc_md;
+            if (client.CreateNodes({{path, false}}) != LLBC_OK ||
+                client.CreateNodes({{path + "/" + addr, true}}) != LLBC_OK) {
+                return false;
+            }
+        }
+        return true;
+    });
+    Run("batched", [&addr](RpcRegistry &registry, RpcRegistryClient &,
+                           const Methods &svc_mds) {
+        return registry.RegisterServices(svc_mds, addr) == LLBC_OK;
+    });
+    return 0;
+}
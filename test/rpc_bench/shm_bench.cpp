@@ -0,0 +1,112 @@
+// Round trip of a request-sized packet between two processes on this host, through
+// RpcConnMgr as calls take it: once over a shared memory link, once over tcp through
+// the llbc service. The child process echoes every request from its reactor loop; the
+// parent sends one request at a time and runs its reactor loop until the response.
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <llbc.h>
+
+#include "rpc_channel.h"
+#include "rpc_conn_mgr.h"
+
+static constexpr int PORT = 19527;
+static constexpr int ROUND_TRIPS = 50000;
+static constexpr std::size_t BODY = 104;  // plus the 24-byte head
+
+static std::uint64_t replies = 0;
+
+static void Echo(llbc::LLBC_Packet &req) {
+    auto *rsp = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    rsp->SetHeader(req.GetSessionId(), RpcChannel::RpcOpCode::RpcRsp, 0);
+    rsp->Write(req.GetPayload(), req.GetPayloadLength());
+    RpcConnMgr::GetInst().SendPacket(rsp);
+}
+
+static void OnReply(llbc::LLBC_Packet &) { ++replies; }
+
+[[noreturn]] static void Server() {
+    auto &mgr = RpcConnMgr::GetInst();
+    if (mgr.Init() != LLBC_OK || mgr.StartRpcService("127.0.0.1", PORT) != LLBC_OK) {
+        std::printf("server start failed\n");
+        std::_Exit(1);
+    }
+    mgr.Subscribe(RpcChannel::RpcOpCode::RpcReq, &Echo);
+    for (;;) {
+        mgr.Tick();
+        mgr.WaitRecvPacket(10);
+    }
+}
+
+static bool Run(const char *name, int session) {
+    auto &mgr = RpcConnMgr::GetInst();
+    std::vector<double> us;
+    us.reserve(ROUND_TRIPS);
+    RpcChannel::PkgHead head;
+    head.seq = 1;  // a coro seq, so the response goes to the reactor
+    char body[BODY] = {};
+
+    for (int i = 0; i < ROUND_TRIPS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        auto *req = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+        req->SetHeader(session, RpcChannel::RpcOpCode::RpcReq, 0);
+        head.ToPacket(*req);
+        req->Write(body, sizeof(body));
+        mgr.SendPacket(req);
+        auto expected = replies + 1;
+        for (auto deadline = start + std::chrono::seconds(1); replies < expected;) {
+            if (mgr.Tick() == 0) mgr.WaitRecvPacket(10);
+            if (std::chrono::steady_clock::now() > deadline) return false;
+        }
+        us.push_back(std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+    }
+
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double u : us) sum += u;
+    std::printf("%-4s  avg %6.2f us  p50 %6.2f us  p99 %6.2f us  (%zu round trips)\n",
+                name, sum / us.size(), us[us.size() / 2], us[us.size() * 99 / 100],
+                us.size());
+    return true;
+}
+
+int main() {
+    auto child = fork();
+    if (child == 0) {
+        llbc::LLBC_Startup();
+        Server();
+    }
+    if (llbc::LLBC_Startup() != LLBC_OK) {
+        std::printf("llbc startup failed\n");
+        return 1;
+    }
+    auto &mgr = RpcConnMgr::GetInst();
+    mgr.Init();
+    mgr.Subscribe(RpcChannel::RpcOpCode::RpcRsp, &OnReply);
+
+    int shm = 0;
+    for (int i = 0; i < 100 && !(shm = mgr.ConnectShm("127.0.0.1", PORT)); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    int tcp = mgr.Connect("127.0.0.1", PORT);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));  // let tcp settle
+
+    bool ok = shm && tcp && Run("shm", shm) && Run("tcp", tcp);
+    if (!ok) std::printf("FAILED\n");
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    mgr.Destroy();
+    llbc::LLBC_Cleanup();
+    return ok ? 0 : 1;
+}
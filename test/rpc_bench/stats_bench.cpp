@@ -0,0 +1,51 @@
+// Cost of recording a request in RpcMethodStats, one Begin() and End() per request,
+// from one thread and from several reactors recording the same method at once.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rpc_stats.h"
+
+static constexpr int REQUESTS = 1000000;  // per thread
+
+static void Run(int threads) {
+    auto name = "BenchService.Method" + std::to_string(threads);
+    auto method_id = static_cast<std::uint32_t>(threads);
+    auto *stats = RpcStats::GetInst().Get(RpcStats::Server, method_id, name);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([stats] {
+            for (int i = 0; i < REQUESTS; ++i) {
+                stats->Begin(i & 63);
+                stats->End(100 + (i & 1023), (i & 127) == 0);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    RpcMethodStats::Snapshot snap;
+    stats->Collect(snap);
+    auto requests = static_cast<std::uint64_t>(threads) * REQUESTS;
+    bool ok = snap.requests == requests && snap.inflight == 0;
+    // wall time over all threads' requests, flat as long as the threads have cores
+    std::printf("threads: %2d  %6.1f ns/request  %s\n", threads,
+                static_cast<double>(ns) / static_cast<double>(requests),
+                ok ? "ok" : "FAILED");
+}
+
+int main() {
+    for (int threads : {1, 2, 4, 8}) {
+        Run(threads);
+    }
+    std::printf("%s", RpcStats::GetInst().Dump("BenchService").c_str());
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <gtest/gtest.h>
+#include <llbc.h>
+
+// llbc's object pools and services need it started, once for all tests
+class LlbcEnvironment : public ::testing::Environment {
+   public:
+    void SetUp() override { ASSERT_EQ(llbc::LLBC_Startup(), LLBC_OK); }
+    void TearDown() override { llbc::LLBC_Cleanup(); }
+};
+
+static auto *const llbc_env = ::testing::AddGlobalTestEnvironment(new LlbcEnvironment);
@@ -0,0 +1,216 @@
+#include "rpc_channel.h"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <google/protobuf/wrappers.pb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "rpc_conn_mgr.h"
+#include "rpc_controller.h"
+#include "rpc_stats_service.h"
+#include "rpc_test_util.h"
+
+// A tcp port on 127.0.0.1 that takes connections into the kernel's backlog and never
+// reads them; a free port if port is 0.
+class Listener {
+   public:
+    explicit Listener(int port = 0) : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+        int on = 1;
+        setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<std::uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), len) == 0 &&
+            listen(fd_, 64) == 0 &&
+            getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &len) == 0) {
+            port_ = ntohs(addr.sin_port);
+        }
+    }
+    ~Listener() { close(fd_); }
+
+    int Port() const { return port_; }
+
+    // close the connections waiting in the backlog
+    void Drop() {
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+        for (int fd; (fd = accept(fd_, nullptr, nullptr)) >= 0;) {
+            close(fd);
+        }
+    }
+
+   private:
+    int fd_;
+    int port_ = 0;
+};
+
+// a port nobody listens on, connects to it are refused
+static int ClosedPort() { return Listener().Port(); }
+
+class RpcChannelTest : public ::testing::Test {
+   protected:
+    void SetUp() override { ASSERT_EQ(RpcConnMgr::GetInst().Init(), LLBC_OK); }
+    void TearDown() override { RpcConnMgr::GetInst().Destroy(); }
+
+    // a blocking call with timeout_ms, the controller tells how it went
+    static RpcController::Ptr Call(RpcChannel *channel, int timeout_ms = 1000) {
+        auto cntl = RpcController::New(false);
+        cntl->SetTimeout(timeout_ms);
+        ::google::protobuf::StringValue req, rsp;
+        channel->BlockingCallMethod(RpcStatsService::GetStatsMethod(), cntl.get(), &req,
+                                    &rsp);
+        return cntl;
+    }
+
+    PendingCalls calls_;
+};
+
+TEST_F(RpcChannelTest, PoolGrowsInBackground) {
+    Listener listener;
+    auto &mgr = RpcConnMgr::GetInst();
+    auto session = mgr.Connect("127.0.0.1", listener.Port());
+    ASSERT_NE(session, 0);
+    RpcChannel channel(&mgr, session, "127.0.0.1", listener.Port(), 3);
+
+    // every call stays in flight, so each one finds the pool busy
+    for (int i = 0; i < 200 && channel.SessionCount() < 3; ++i) {
+        calls_.Start(&channel);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(channel.SessionCount(), 3);
+    calls_.Expire();
+}
+
+TEST_F(RpcChannelTest, PoolGrowthRetried) {
+    Listener listener;
+    auto port = ClosedPort();
+    auto &mgr = RpcConnMgr::GetInst();
+    auto session = mgr.Connect("127.0.0.1", listener.Port());
+    ASSERT_NE(session, 0);
+    RpcChannel channel(&mgr, session, "127.0.0.1", port, 2);
+
+    // growing fails, calls go to the open session meanwhile
+    for (int i = 0; i < 20; ++i) {
+        calls_.Start(&channel);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(channel.SessionCount(), 1);
+    EXPECT_EQ(channel.InFlight(), 20);
+
+    // and is retried once the server is up
+    Listener late(port);
+    ASSERT_EQ(late.Port(), port);
+    for (int i = 0; i < 300 && channel.SessionCount() < 2; ++i) {
+        calls_.Start(&channel);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(channel.SessionCount(), 2);
+    calls_.Expire();
+}
+
+TEST_F(RpcChannelTest, PoolDropsClosedSessions) {
+    Listener listener;
+    auto &mgr = RpcConnMgr::GetInst();
+    auto session = mgr.Connect("127.0.0.1", listener.Port());
+    ASSERT_NE(session, 0);
+    RpcChannel channel(&mgr, session, "127.0.0.1", listener.Port(), 2);
+    for (int i = 0; i < 200 && channel.SessionCount() < 2; ++i) {
+        calls_.Start(&channel);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(channel.SessionCount(), 2);
+
+    // the server closes both sessions, the next call finds them gone
+    auto closed = mgr.ClosedSessions();
+    listener.Drop();
+    for (int i = 0; i < 200 && mgr.ClosedSessions() < closed + 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(mgr.ClosedSessions(), closed + 2);
+    EXPECT_FALSE(mgr.IsSessionOpen(session));
+    calls_.Start(&channel);
+    EXPECT_EQ(channel.SessionCount(), 0);
+
+    // and the pool grows back
+    for (int i = 0; i < 200 && channel.SessionCount() < 2; ++i) {
+        calls_.Start(&channel);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(channel.SessionCount(), 2);
+    calls_.Expire();
+}
+
+TEST_F(RpcChannelTest, CallsOutliveChannel) {
+    Listener listener;
+    auto &mgr = RpcConnMgr::GetInst();
+    auto session = mgr.Connect("127.0.0.1", listener.Port());
+    ASSERT_NE(session, 0);
+    auto channel = std::make_unique<RpcChannel>(&mgr, session);
+    for (int i = 0; i < 3; ++i) {
+        calls_.Start(channel.get());
+    }
+    EXPECT_EQ(channel->InFlight(), 3);
+
+    // the calls time out after the channel is gone
+    channel.reset();
+    calls_.Expire();
+}
+
+// a call through the generic-service entry point, done once the coro is resumed
+static RpcCoro GenericCall(RpcChannel *channel, RpcController *cntl, bool *done) {
+    cntl->SetCoroHandle(co_await GetHandleAwaiter{});
+    ::google::protobuf::StringValue req, rsp;
+    channel->CallMethod(RpcStatsService::GetStatsMethod(), cntl, &req, &rsp, nullptr);
+    co_await std::suspend_always{};
+    *done = true;
+}
+
+TEST_F(RpcChannelTest, GenericCallUnreachable) {
+    // a shared memory link that doesn't exist, and no address to dial
+    RpcChannel dead(&RpcConnMgr::GetInst(), RpcShmTransport::SESSION_BASE + (1 << 20));
+    auto cntl = RpcController::New(true);
+    bool done = false;
+    GenericCall(&dead, cntl.get(), &done);
+    EXPECT_FALSE(done);
+
+    auto &coroMgr = RpcCoroMgr::GetInst();
+    EXPECT_EQ(coroMgr.SuspendedCount(), 1);
+    EXPECT_EQ(coroMgr.NextTimeout(), 0);
+    coroMgr.HandleCoroTimeout();
+    EXPECT_TRUE(done);
+    EXPECT_EQ(cntl->ErrorText(), "send packet failed");
+    EXPECT_EQ(coroMgr.SuspendedCount(), 0);
+}
+
+TEST_F(RpcChannelTest, RedialAfterPeerRestart) {
+    auto path = SocketPath("redial");
+    auto peer = std::make_unique<ShmPeer>(path);
+    std::unique_ptr<RpcChannel> channel(
+        RpcConnMgr::GetInst().CreateRpcChannel(("unix:" + path).c_str(), 0));
+    ASSERT_NE(channel, nullptr);
+    EXPECT_FALSE(Call(channel.get())->Failed());
+
+    // once the link is seen closed and nobody listens, calls fail without waiting
+    peer.reset();
+    std::string reason;
+    for (int i = 0; i < 50 && reason != "send packet failed"; ++i) {
+        reason = Call(channel.get(), 20)->ErrorText();
+    }
+    EXPECT_EQ(reason, "send packet failed");
+
+    // the next call dials the restarted server
+    peer = std::make_unique<ShmPeer>(path);
+    EXPECT_FALSE(Call(channel.get())->Failed());
+    EXPECT_FALSE(Call(channel.get())->Failed());
+    EXPECT_EQ(peer->Seqs().size(), 2);
+    EXPECT_EQ(channel->SessionCount(), 1);
+}
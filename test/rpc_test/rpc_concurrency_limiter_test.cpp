@@ -0,0 +1,94 @@
+#include "rpc_concurrency_limiter.h"
+
+#include <gtest/gtest.h>
+
+// every release closes a window, and a window's estimate replaces the limit
+static RpcConcurrencyLimiter::Options Adaptive(std::uint32_t initial_limit) {
+    return {.initial_limit = initial_limit,
+            .smoothing = 1,
+            .window_us = 0,
+            .window_samples = 1};
+}
+
+// admit n requests
+static void Acquire(RpcConcurrencyLimiter &limiter, std::uint32_t n) {
+    for (std::uint32_t i = 0; i < n; ++i) ASSERT_TRUE(limiter.TryAcquire());
+}
+
+TEST(RpcConcurrencyLimiterTest, RejectsAtLimit) {
+    RpcConcurrencyLimiter limiter(RpcConcurrencyLimiter::Fixed(2));
+    Acquire(limiter, 2);
+    EXPECT_FALSE(limiter.TryAcquire());
+    EXPECT_EQ(limiter.InFlight(), 2u);
+    EXPECT_EQ(limiter.Rejected(), 1u);
+
+    limiter.Release(-1);
+    EXPECT_TRUE(limiter.TryAcquire());
+    EXPECT_FALSE(limiter.TryAcquire());
+    EXPECT_EQ(limiter.Rejected(), 2u);
+    EXPECT_EQ(limiter.Limit(), 2u);  // latencies leave a fixed limit alone
+    limiter.Release(1000000);
+    limiter.Release(1);
+    EXPECT_EQ(limiter.Limit(), 2u);
+}
+
+TEST(RpcConcurrencyLimiterTest, Grows) {
+    RpcConcurrencyLimiter limiter(Adaptive(16));
+    Acquire(limiter, 16);
+    EXPECT_FALSE(limiter.TryAcquire());
+
+    // at no-load latency the limit grows by its square root
+    limiter.Release(100);
+    EXPECT_EQ(limiter.Limit(), 20u);
+    Acquire(limiter, 5);
+    EXPECT_FALSE(limiter.TryAcquire());
+    // within the tolerance still
+    limiter.Release(150);
+    EXPECT_EQ(limiter.Limit(), 24u);
+}
+
+TEST(RpcConcurrencyLimiterTest, IdleDoesNotGrow) {
+    RpcConcurrencyLimiter limiter(Adaptive(16));
+    // a peak of a quarter of the limit says nothing about it
+    for (int i = 0; i < 10; ++i) {
+        Acquire(limiter, 4);
+        for (int j = 0; j < 4; ++j) limiter.Release(100);
+    }
+    EXPECT_EQ(limiter.Limit(), 16u);
+}
+
+TEST(RpcConcurrencyLimiterTest, Shrinks) {
+    RpcConcurrencyLimiter limiter(Adaptive(16));
+    Acquire(limiter, 16);
+    limiter.Release(100);
+    ASSERT_EQ(limiter.Limit(), 20u);
+
+    // 10x the no-load latency, by half and the square root: 20 / 2 + 4.5
+    limiter.Release(1000);
+    EXPECT_EQ(limiter.Limit(), 14u);
+    // and down to the least limit
+    for (int i = 0; i < 14; ++i) limiter.Release(1000);
+    EXPECT_EQ(limiter.Limit(), RpcConcurrencyLimiter::Options{}.min_limit);
+    EXPECT_EQ(limiter.InFlight(), 0u);
+}
+
+TEST(RpcConcurrencyLimiterTest, ProbesNoLoadLatency) {
+    RpcConcurrencyLimiter limiter(Adaptive(4));
+    // 3 held, one more in every window keeps the peak at the limit
+    Acquire(limiter, 3);
+    auto window = [&limiter](llbc::sint64 latency_us) {
+        ASSERT_TRUE(limiter.TryAcquire());
+        limiter.Release(latency_us);
+    };
+
+    window(100);
+    // the service got 10x slower for good, the limit is held down until the probe
+    for (std::uint64_t i = 2; i < RpcConcurrencyLimiter::PROBE_WINDOWS; ++i) {
+        window(1000);
+    }
+    EXPECT_EQ(limiter.Limit(), 4u);
+    window(1000);
+    EXPECT_EQ(limiter.Limit(), 6u);
+    window(1000);
+    EXPECT_GT(limiter.Limit(), 6u);
+}
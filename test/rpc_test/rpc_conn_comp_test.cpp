@@ -0,0 +1,122 @@
+#include "rpc_conn_comp.h"
+
+#include <gtest/gtest.h>
+
+#include "rpc_channel.h"
+
+// a response to a coroutine call, which goes to a reactor's recv queue
+static llbc::LLBC_Packet *NewResponse(std::uint64_t seq) {
+    auto *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    packet->SetHeader(1, RpcChannel::RpcRsp, LLBC_OK);
+    RpcChannel::PkgHead head;
+    head.seq = seq;
+    head.ToPacket(*packet);
+    return packet;
+}
+
+static void Receive(RpcConnComp &comp, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        auto *packet = NewResponse(i + 1);
+        comp.OnRecvPacket(*packet);
+        LLBC_Recycle(packet);
+    }
+}
+
+static std::size_t Pop(RpcConnComp &comp, std::size_t n) {
+    llbc::LLBC_Packet *packets[16];
+    auto popped = comp.PopRecvPackets(0, packets, std::min<std::size_t>(n, 16));
+    for (std::size_t i = 0; i < popped; ++i) LLBC_Recycle(packets[i]);
+    return popped;
+}
+
+TEST(RpcConnCompTest, RecvWatermarks) {
+    RpcConnComp::QueueConfig config;
+    config.recvCapacity = 8;
+    config.recvHighWatermark = 6;
+    config.recvLowWatermark = 2;
+    config.maxBacklog = 4;
+    RpcConnComp comp(1, config);
+
+    Receive(comp, 6);
+    auto stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.recvDepth, 6);
+    EXPECT_EQ(stats.recvBacklog, 0);
+    EXPECT_EQ(stats.recvStalls, 0);
+
+    // at the high watermark packets are held back, up to maxBacklog, then shed
+    Receive(comp, 6);
+    stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.recvDepth, 6);
+    EXPECT_EQ(stats.recvBacklog, 4);
+    EXPECT_EQ(stats.recvStalls, 1);
+    EXPECT_EQ(stats.recvShed, 2);
+
+    // not fed above the low watermark
+    EXPECT_EQ(Pop(comp, 3), 3);
+    comp.OnUpdate();
+    stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.recvDepth, 3);
+    EXPECT_EQ(stats.recvBacklog, 4);
+
+    // fed again at the low watermark
+    EXPECT_EQ(Pop(comp, 1), 1);
+    comp.OnUpdate();
+    stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.recvDepth, 6);
+    EXPECT_EQ(stats.recvBacklog, 0);
+
+    // and stalled again once it reaches the high one
+    Receive(comp, 1);
+    stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.recvBacklog, 1);
+    EXPECT_EQ(stats.recvStalls, 2);
+    EXPECT_EQ(stats.recvShed, 2);
+}
+
+TEST(RpcConnCompTest, RecvKeepsOrder) {
+    RpcConnComp::QueueConfig config;
+    config.recvCapacity = 4;
+    config.recvHighWatermark = 2;
+    config.recvLowWatermark = 0;
+    RpcConnComp comp(1, config);
+
+    Receive(comp, 5);
+    std::uint64_t expected = 1;
+    for (int round = 0; round < 3; ++round) {
+        llbc::LLBC_Packet *packet = nullptr;
+        while (comp.PopRecvPacket(0, packet) == LLBC_OK) {
+            std::uint64_t seq = 0;
+            EXPECT_EQ(RpcChannel::PkgHead::PeekSeq(*packet, seq), LLBC_OK);
+            EXPECT_EQ(seq, expected++);
+            LLBC_Recycle(packet);
+        }
+        comp.OnUpdate();
+    }
+    EXPECT_EQ(expected, 6);
+}
+
+TEST(RpcConnCompTest, SendBacklogFull) {
+    RpcConnComp::QueueConfig config;
+    config.sendCapacity = 2;
+    config.maxBacklog = 2;
+    RpcConnComp comp(1, config);
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(comp.PushSendPacket(0, NewResponse(i + 1)), LLBC_OK);
+    }
+    auto stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.sendDepth, 2);
+    EXPECT_EQ(stats.sendBacklog, 2);
+    EXPECT_EQ(stats.sendStalls, 1);
+    EXPECT_EQ(stats.sendRejected, 0);
+
+    // the rejected packet is still the caller's
+    auto *packet = NewResponse(5);
+    EXPECT_EQ(comp.PushSendPacket(0, packet), RpcChannel::RpcOverloaded);
+    EXPECT_EQ(packet->GetPayloadLength(), RpcChannel::PkgHead::SIZE);
+    LLBC_Recycle(packet);
+    stats = comp.GetQueueStats(0);
+    EXPECT_EQ(stats.sendBacklog, 2);
+    EXPECT_EQ(stats.sendRejected, 1);
+    EXPECT_EQ(comp.FlushSendBacklog(0), 2);
+}
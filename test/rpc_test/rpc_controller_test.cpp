@@ -0,0 +1,18 @@
+#include "rpc_controller.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(RpcControllerTest, Reused) {
+    auto *first = RpcController::New(true).get();
+    auto cntl = RpcController::New(false);
+    EXPECT_EQ(cntl.get(), first);
+    EXPECT_FALSE(cntl->UseCoro());
+}
+
+TEST(RpcControllerDeathTest, ReleasedOnAnotherThread) {
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    auto cntl = RpcController::New(true);
+    EXPECT_DEBUG_DEATH(std::thread([&] { cntl.reset(); }).join(), "another thread");
+}
@@ -0,0 +1,159 @@
+#include "rpc_fake_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <thread>
+
+#include "rpc_macros.h"
+
+class RpcFakeRegistry::client : public RpcRegistryClient {
+   public:
+    explicit client(RpcFakeRegistry &registry)
+        : registry_(registry), alive_(registry.alive_) {}
+    ~client() override {
+        if (!alive_.expired()) registry_.Disconnect(this);
+    }
+
+    int Connect(const std::string &) override {
+        COND_RET(alive_.expired(), LLBC_FAILED);
+        registry_.RoundTrip();
+        return LLBC_OK;
+    }
+
+    int CreateNodes(const std::vector<node> &nodes) override {
+        COND_RET(alive_.expired(), LLBC_FAILED);
+        return registry_.CreateNodes(this, nodes);
+    }
+
+    int WatchChildren(const std::string &path, children_handler handler,
+                      std::vector<std::string> &children) override {
+        COND_RET(alive_.expired(), LLBC_FAILED);
+        return registry_.WatchChildren(this, path, std::move(handler), children);
+    }
+
+   private:
+    RpcFakeRegistry &registry_;
+    std::weak_ptr<void> alive_;  // of registry_
+};
+
+namespace {
+
+// "/a/b" -> "/a", "/a" -> ""
+std::string Parent(const std::string &path) {
+    auto slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+}  // namespace
+
+std::unique_ptr<RpcRegistryClient> RpcFakeRegistry::NewClient() {
+    return std::make_unique<client>(*this);
+}
+
+std::vector<std::string> RpcFakeRegistry::Children(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ChildrenLocked(path);
+}
+
+void RpcFakeRegistry::RoundTrip() {
+    round_trips_.fetch_add(1, std::memory_order_relaxed);
+    if (round_trip_us_) {
+        std::this_thread::sleep_for(std::chrono::microseconds(round_trip_us_));
+    }
+}
+
+int RpcFakeRegistry::CreateNodes(const client *owner,
+                                 const std::vector<RpcRegistryClient::node> &nodes) {
+    RoundTrip();
+
+    int ret = LLBC_OK;
+    std::vector<std::string> parents;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &n : nodes) {
+            auto parent = Parent(n.path);
+            if (n.path.empty() || n.path[0] != '/' ||
+                (!parent.empty() && !nodes_.count(parent))) {
+                LLOG_ERROR("CreateNodes failed, no parent, path: %s", n.path.c_str());
+                ret = LLBC_FAILED;
+                continue;
+            }
+            if (nodes_.emplace(n.path, znode{n.ephemeral ? owner : nullptr}).second) {
+                parents.push_back(parent);
+            }
+        }
+    }
+
+    Notify(parents);
+    return ret;
+}
+
+int RpcFakeRegistry::WatchChildren(const client *owner, const std::string &path,
+                                   RpcRegistryClient::children_handler handler,
+                                   std::vector<std::string> &children) {
+    RoundTrip();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    COND_RET_ELOG(!nodes_.count(path), LLBC_FAILED, "WatchChildren failed, no node: %s",
+                  path.c_str());
+    children = ChildrenLocked(path);
+    watches_.emplace(path, watch{owner, std::move(handler)});
+    return LLBC_OK;
+}
+
+void RpcFakeRegistry::Disconnect(const client *owner) {
+    std::vector<std::string> parents;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::erase_if(watches_,
+                      [owner](const auto &w) { return w.second.owner == owner; });
+        for (auto it = nodes_.begin(); it != nodes_.end();) {
+            if (it->second.owner == owner) {
+                parents.push_back(Parent(it->first));
+                it = nodes_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    Notify(parents);
+}
+
+std::vector<std::string> RpcFakeRegistry::ChildrenLocked(const std::string &path) const {
+    std::vector<std::string> children;
+    auto prefix = path + "/";
+    for (auto it = nodes_.lower_bound(prefix);
+         it != nodes_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        auto name = it->first.substr(prefix.size());
+        if (name.find('/') == std::string::npos) {
+            children.push_back(std::move(name));
+        }
+    }
+    return children;
+}
+
+void RpcFakeRegistry::Notify(const std::vector<std::string> &parents) {
+    std::vector<std::pair<RpcRegistryClient::children_handler, std::vector<std::string>>>
+        calls;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::string_view> done;
+        for (const auto &parent : parents) {
+            // a batch often adds many children to one parent, notify it once
+            if (std::find(done.begin(), done.end(), parent) != done.end()) {
+                continue;
+            }
+            done.push_back(parent);
+            auto [begin, end] = watches_.equal_range(parent);
+            for (auto it = begin; it != end; ++it) {
+                calls.emplace_back(it->second.handler, ChildrenLocked(parent));
+            }
+        }
+    }
+
+    for (const auto &[handler, children] : calls) {
+        handler(children);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef _RPC_FAKE_REGISTRY_H_
+#define _RPC_FAKE_REGISTRY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "rpc_registry_client.h"
+
+/**
+ * In-process stand-in for zookeeper, for tests and benchmarks of RpcRegistry. Clients
+ * from NewClient() share one node store, each request or batch of them sleeps one
+ * simulated round trip. A client's ephemeral nodes and watches go away when it is
+ * destroyed, like those of a zookeeper session, and watches fire synchronously on the
+ * thread that changed the children. A client that outlives the registry fails every
+ * request.
+ */
+class RpcFakeRegistry {
+   public:
+    explicit RpcFakeRegistry(std::uint32_t round_trip_us = 0)
+        : round_trip_us_(round_trip_us) {}
+
+    std::unique_ptr<RpcRegistryClient> NewClient();
+
+    // children of path, sorted
+    std::vector<std::string> Children(const std::string &path);
+
+    // requests served so far, a batch counts once
+    std::uint64_t RoundTrips() const noexcept {
+        return round_trips_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    class client;
+
+    struct znode {
+        const client *owner = nullptr;  // set for ephemeral nodes
+    };
+
+    struct watch {
+        const client *owner = nullptr;
+        RpcRegistryClient::children_handler handler;
+    };
+
+    void RoundTrip();
+    int CreateNodes(const client *owner,
+                    const std::vector<RpcRegistryClient::node> &nodes);
+    int WatchChildren(const client *owner, const std::string &path,
+                      RpcRegistryClient::children_handler handler,
+                      std::vector<std::string> &children);
+    // end the session of owner, removing its ephemeral nodes and watches
+    void Disconnect(const client *owner);
+    // children of path, mutex_ must be held
+    std::vector<std::string> ChildrenLocked(const std::string &path) const;
+    // call the watches of parents with their new children, without holding mutex_
+    void Notify(const std::vector<std::string> &parents);
+
+    const std::uint32_t round_trip_us_;
+    std::atomic<std::uint64_t> round_trips_{0};
+    std::mutex mutex_;
+    std::map<std::string, znode> nodes_;  // path -> node, sorted so children are adjacent
+    std::unordered_multimap<std::string, watch> watches_;  // path -> watch
+    // clients hold it weakly, it expires with the registry
+    std::shared_ptr<void> alive_ = std::make_shared<char>();
+};
+
+#endif  // _RPC_FAKE_REGISTRY_H_
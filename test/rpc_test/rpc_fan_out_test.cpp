@@ -0,0 +1,149 @@
+#include "rpc_fan_out.h"
+
+#include <gtest/gtest.h>
+
+#include <google/protobuf/wrappers.pb.h>
+
+#include <memory>
+#include <vector>
+
+#include "rpc_conn_mgr.h"
+#include "rpc_controller.h"
+#include "rpc_coro_mgr.h"
+#include "rpc_stats_service.h"
+#include "rpc_test_util.h"
+
+// Calls to a peer that never answers; the test completes them by hand, as a response
+// would, see Succeed() and Fail().
+class RpcFanOutTest : public ::testing::Test {
+   protected:
+    static constexpr std::size_t CALLS = 3;
+
+    void SetUp() override {
+        ASSERT_EQ(RpcConnMgr::GetInst().Init(), LLBC_OK);
+        auto path = SocketPath("fan_out");
+        peer_ = std::make_unique<ShmPeer>(path, false);
+        auto &mgr = RpcConnMgr::GetInst();
+        channel_.reset(mgr.CreateRpcChannel(("unix:" + path).c_str(), 0));
+        ASSERT_NE(channel_, nullptr);
+        for (std::size_t i = 0; i < CALLS; ++i) {
+            cntls_.push_back(RpcController::New(true));
+        }
+    }
+
+    void TearDown() override {
+        EXPECT_EQ(RpcCoroMgr::GetInst().SuspendedCount(), 0);
+        cntls_.clear();
+        channel_.reset();
+        peer_.reset();
+        RpcConnMgr::GetInst().Destroy();
+    }
+
+    std::vector<RpcChannel::CallAwaiter> Calls(RpcChannel *channel) {
+        std::vector<RpcChannel::CallAwaiter> calls;
+        for (std::size_t i = 0; i < CALLS; ++i) {
+            calls.push_back(channel->Call(RpcStatsService::GetStatsMethod(),
+                                          cntls_[i].get(), &req_, &rsps_[i]));
+        }
+        return calls;
+    }
+
+    // seqs of the calls, in the order they were sent
+    std::vector<std::uint64_t> Sent() {
+        EXPECT_TRUE(peer_->WaitRequests(CALLS));
+        return peer_->Seqs();
+    }
+
+    static void Succeed(std::uint64_t seq) {
+        auto ctx = RpcCoroMgr::GetInst().PopCoroContext(seq);
+        ASSERT_NE(ctx.handle, nullptr);
+        RpcCoroMgr::Resume(ctx);
+    }
+    static void Fail(std::uint64_t seq) { RpcCoroMgr::GetInst().KillCoro(seq, "failed"); }
+
+    std::unique_ptr<ShmPeer> peer_;
+    std::unique_ptr<RpcChannel> channel_;
+    std::vector<RpcController::Ptr> cntls_;
+    ::google::protobuf::StringValue req_;
+    ::google::protobuf::StringValue rsps_[CALLS];
+};
+
+static RpcCoro Await(RpcFanOut fan_out, std::ptrdiff_t *result) {
+    *result = co_await fan_out;
+}
+
+TEST_F(RpcFanOutTest, AnyCancelsTheOthers) {
+    std::ptrdiff_t result = -2;
+    Await(WhenAny(Calls(channel_.get())), &result);
+    auto seqs = Sent();
+    EXPECT_EQ(result, -2);
+
+    Succeed(seqs[1]);
+    EXPECT_EQ(result, 1);
+    EXPECT_FALSE(cntls_[1]->Failed());
+    EXPECT_EQ(cntls_[0]->ErrorText(), "cancelled");
+    EXPECT_EQ(cntls_[2]->ErrorText(), "cancelled");
+}
+
+TEST_F(RpcFanOutTest, AnyAfterFailures) {
+    std::ptrdiff_t result = -2;
+    Await(WhenAny(Calls(channel_.get())), &result);
+    auto seqs = Sent();
+
+    Fail(seqs[0]);
+    Fail(seqs[2]);
+    EXPECT_EQ(result, -2);
+    Succeed(seqs[1]);
+    EXPECT_EQ(result, 1);
+}
+
+TEST_F(RpcFanOutTest, NCancelsTheRest) {
+    std::ptrdiff_t result = -2;
+    Await(WhenN(Calls(channel_.get()), 2), &result);
+    auto seqs = Sent();
+
+    Succeed(seqs[2]);
+    EXPECT_EQ(result, -2);
+    Succeed(seqs[0]);
+    EXPECT_EQ(result, 2);
+    EXPECT_EQ(cntls_[1]->ErrorText(), "cancelled");
+}
+
+TEST_F(RpcFanOutTest, NOutOfReach) {
+    std::ptrdiff_t result = -2;
+    Await(WhenN(Calls(channel_.get()), 2), &result);
+    auto seqs = Sent();
+
+    // two failures leave too few calls to get two successes
+    Fail(seqs[1]);
+    EXPECT_EQ(result, -2);
+    Fail(seqs[0]);
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(cntls_[2]->ErrorText(), "cancelled");
+}
+
+TEST_F(RpcFanOutTest, AllWaitsForEveryCall) {
+    std::ptrdiff_t result = -2;
+    Await(WhenAll(Calls(channel_.get())), &result);
+    auto seqs = Sent();
+
+    Succeed(seqs[0]);
+    Fail(seqs[1]);
+    EXPECT_EQ(result, -2);
+    Succeed(seqs[2]);
+    EXPECT_EQ(result, 2);
+}
+
+TEST_F(RpcFanOutTest, AllCallsFailToSend) {
+    // a shared memory link that doesn't exist, and no address to dial
+    RpcChannel dead(&RpcConnMgr::GetInst(), RpcShmTransport::SESSION_BASE + (1 << 20));
+    std::ptrdiff_t result = -2;
+    Await(WhenAny(Calls(&dead)), &result);
+    EXPECT_EQ(result, -1);
+    for (auto &cntl : cntls_) EXPECT_EQ(cntl->ErrorText(), "send packet failed");
+
+    Await(WhenN(Calls(&dead), 2), &result);
+    EXPECT_EQ(result, 0);
+    Await(WhenAll(Calls(&dead)), &result);
+    EXPECT_EQ(result, 0);
+}
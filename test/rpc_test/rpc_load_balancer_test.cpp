@@ -0,0 +1,196 @@
+#include "rpc_load_balancer.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rpc_conn_mgr.h"
+#include "rpc_test_util.h"
+
+// endpoints named a, b, c... on ports 1, 2, 3...
+class Endpoints {
+   public:
+    explicit Endpoints(const std::vector<std::uint32_t> &weights) {
+        for (auto weight : weights) Add(weight);
+    }
+
+    RpcEndpoint &Add(std::uint32_t weight = 1) {
+        auto endpoint = std::make_unique<RpcEndpoint>();
+        endpoint->name = std::string(1, static_cast<char>('a' + owned_.size()));
+        endpoint->ip = "10.0.0.1";
+        endpoint->port = static_cast<int>(owned_.size()) + 1;
+        endpoint->weight = weight;
+        owned_.push_back(std::move(endpoint));
+        return *owned_.back();
+    }
+    void Remove(std::size_t i) { owned_.erase(owned_.begin() + i); }
+
+    std::vector<RpcEndpoint *> Get() const {
+        std::vector<RpcEndpoint *> endpoints;
+        for (const auto &endpoint : owned_) endpoints.push_back(endpoint.get());
+        return endpoints;
+    }
+    RpcEndpoint &operator[](std::size_t i) { return *owned_[i]; }
+
+   private:
+    std::vector<std::unique_ptr<RpcEndpoint>> owned_;
+};
+
+static std::string Picks(const RpcLoadBalancer &balancer, std::size_t n) {
+    std::string picks;
+    for (std::size_t i = 0; i < n; ++i) picks += balancer.Select({})->name;
+    return picks;
+}
+
+TEST(RpcLoadBalancerTest, Empty) {
+    for (auto policy : {RpcLoadBalancer::Policy::RoundRobin, RpcLoadBalancer::Policy::P2C,
+                        RpcLoadBalancer::Policy::ConsistentHash}) {
+        auto balancer = RpcLoadBalancer::New(policy);
+        balancer->Update({});
+        EXPECT_EQ(balancer->Select({}), nullptr);
+    }
+}
+
+TEST(RpcLoadBalancerTest, SmoothRoundRobin) {
+    struct Case {
+        std::vector<std::uint32_t> weights;
+        std::string round;  // picks of one round, repeated
+    };
+    const Case cases[] = {
+        {{1}, "a"},
+        {{1, 1, 1}, "abc"},
+        {{5, 1, 1}, "aabacaa"},  // nginx's example, the light ones interleaved
+        {{3, 2}, "ababa"},
+        {{2, 4}, "bab"},  // reduced to 1:2
+        {{4, 4, 2}, "abcab"},
+    };
+    for (const auto &c : cases) {
+        Endpoints endpoints(c.weights);
+        auto balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::RoundRobin);
+        balancer->Update(endpoints.Get());
+        EXPECT_EQ(Picks(*balancer, c.round.size() * 3), c.round + c.round + c.round)
+            << "weights: " << ::testing::PrintToString(c.weights);
+    }
+}
+
+TEST(RpcLoadBalancerTest, P2CSpreadsIdleBackends) {
+    Endpoints endpoints({1, 1, 1});
+    auto balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::P2C);
+    balancer->Update(endpoints.Get());
+    std::map<char, int> picks;
+    for (char name : Picks(*balancer, 3000)) ++picks[name];
+    for (char name : {'a', 'b', 'c'}) {
+        EXPECT_GT(picks[name], 700) << name;
+    }
+
+    Endpoints one({1});
+    balancer->Update(one.Get());
+    EXPECT_EQ(Picks(*balancer, 10), "aaaaaaaaaa");
+}
+
+class RpcP2CTest : public ::testing::Test {
+   protected:
+    void SetUp() override { ASSERT_EQ(RpcConnMgr::GetInst().Init(), LLBC_OK); }
+    void TearDown() override { RpcConnMgr::GetInst().Destroy(); }
+};
+
+TEST_F(RpcP2CTest, LoadPerWeight) {
+    // backends with calls in flight, over channels to peers that never answer
+    struct Case {
+        std::uint32_t weight_a, weight_b;
+        int inflight_a, inflight_b;
+        char pick;
+    };
+    const Case cases[] = {
+        {1, 1, 0, 0, 0},  // a tie, either
+        {1, 1, 2, 0, 'b'},
+        {1, 1, 1, 2, 'a'},
+        {4, 1, 2, 1, 'a'},  // 2 / 4 < 1 / 1
+        {4, 1, 5, 1, 'b'},
+        {2, 1, 2, 1, 0},  // 2 / 2 == 1 / 1
+    };
+    auto &mgr = RpcConnMgr::GetInst();
+    ShmPeer peer_a(SocketPath("p2c_a"), false), peer_b(SocketPath("p2c_b"), false);
+    for (const auto &c : cases) {
+        std::unique_ptr<RpcChannel> a(
+            mgr.CreateRpcChannel(("unix:" + SocketPath("p2c_a")).c_str(), 0));
+        std::unique_ptr<RpcChannel> b(
+            mgr.CreateRpcChannel(("unix:" + SocketPath("p2c_b")).c_str(), 0));
+        ASSERT_TRUE(a && b);
+        PendingCalls calls;
+        for (int i = 0; i < c.inflight_a; ++i) calls.Start(a.get());
+        for (int i = 0; i < c.inflight_b; ++i) calls.Start(b.get());
+
+        Endpoints endpoints({c.weight_a, c.weight_b});
+        endpoints[0].channel = a.get();
+        endpoints[1].channel = b.get();
+        auto balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::P2C);
+        balancer->Update(endpoints.Get());
+        auto picks = Picks(*balancer, 100);
+        if (c.pick) {
+            EXPECT_EQ(picks, std::string(100, c.pick))
+                << c.weight_a << ":" << c.weight_b << " " << c.inflight_a << ":"
+                << c.inflight_b;
+        }
+        calls.Expire();
+    }
+}
+
+TEST(RpcLoadBalancerTest, KetamaRingStability) {
+    constexpr std::uint64_t KEYS = 10000;
+    auto assign = [](const std::vector<RpcEndpoint *> &endpoints) {
+        auto balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::ConsistentHash);
+        balancer->Update(endpoints);
+        std::vector<std::string> owners;
+        for (std::uint64_t key = 0; key < KEYS; ++key) {
+            owners.push_back(balancer->Select({.hash_key = key})->name);
+        }
+        return owners;
+    };
+
+    Endpoints endpoints({1, 1, 1});
+    auto before = assign(endpoints.Get());
+    // equal keys stick to one backend, and the keys spread
+    EXPECT_EQ(assign(endpoints.Get()), before);
+    std::map<std::string, std::size_t> counts;
+    for (const auto &owner : before) ++counts[owner];
+    for (const auto &[name, count] : counts) {
+        EXPECT_GT(count, KEYS / 4) << name;
+    }
+
+    // a new backend only takes keys, about its share of them
+    endpoints.Add();
+    auto added = assign(endpoints.Get());
+    std::size_t moved = 0;
+    for (std::uint64_t key = 0; key < KEYS; ++key) {
+        if (added[key] == before[key]) continue;
+        EXPECT_EQ(added[key], "d");
+        ++moved;
+    }
+    EXPECT_GT(moved, KEYS / 8);
+    EXPECT_LT(moved, KEYS / 2);
+
+    // a removed one only gives its keys away
+    endpoints.Remove(0);
+    auto removed = assign(endpoints.Get());
+    for (std::uint64_t key = 0; key < KEYS; ++key) {
+        if (added[key] != "a") {
+            EXPECT_EQ(removed[key], added[key]);
+        }
+    }
+}
+
+TEST(RpcLoadBalancerTest, KetamaWeight) {
+    Endpoints endpoints({3, 1});
+    auto balancer = RpcLoadBalancer::New(RpcLoadBalancer::Policy::ConsistentHash);
+    balancer->Update(endpoints.Get());
+    std::size_t heavy = 0;
+    for (std::uint64_t key = 0; key < 10000; ++key) {
+        heavy += balancer->Select({.hash_key = key})->name == "a";
+    }
+    EXPECT_GT(heavy, 6500);
+    EXPECT_LT(heavy, 8500);
+}
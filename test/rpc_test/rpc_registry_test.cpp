@@ -0,0 +1,216 @@
+#include "rpc_registry.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rpc_fake_registry.h"
+
+TEST(RpcRegistryTest, ParseWeight) {
+    struct Case {
+        std::string name;
+        bool ok;
+        std::uint32_t weight;
+    };
+    const Case cases[] = {
+        {"10.0.0.1:80", true, 1},
+        {"10.0.0.1:80@3", true, 3},
+        {"10.0.0.1:80@100", true, RpcRegistry::MAX_WEIGHT},
+        {"10.0.0.1:80@101", true, RpcRegistry::MAX_WEIGHT},
+        {"10.0.0.1:80@999999999", true, RpcRegistry::MAX_WEIGHT},
+        {"10.0.0.1:80@3+host", true, 3},
+        {"10.0.0.1:80@0", false, 0},
+        {"10.0.0.1:80@", false, 0},
+        {"10.0.0.1:80@x", false, 0},
+        {"10.0.0.1:80@-1", false, 0},
+        {"10.0.0.1:80@1000000000", false, 0},  // too many digits to parse
+        {"10.0.0.1:0", false, 0},
+        {"10.0.0.1:65536", false, 0},
+        {"10.0.0.1:", false, 0},
+        {"10.0.0.1", false, 0},
+    };
+    for (const auto &c : cases) {
+        auto endpoint = RpcRegistry::ParseEndpoint(c.name);
+        ASSERT_EQ(endpoint != nullptr, c.ok) << c.name;
+        if (!endpoint) continue;
+        EXPECT_EQ(endpoint->name, c.name);
+        EXPECT_EQ(endpoint->ip, "10.0.0.1") << c.name;
+        EXPECT_EQ(endpoint->weight, c.weight) << c.name;
+    }
+}
+
+TEST(RpcRegistryTest, RebalanceReusesEndpoints) {
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    ASSERT_EQ(registry.RegisterService("Svc.Md", "10.0.0.1:80"), LLBC_OK);
+    ASSERT_EQ(registry.RegisterService("Svc.Md", "10.0.0.2:80"), LLBC_OK);
+
+    std::set<RpcEndpoint *> before;
+    for (int i = 0; i < 2; ++i) before.insert(registry.SelectEndpoint("Svc.Md").get());
+    ASSERT_EQ(before.size(), 2u);
+
+    registry.SetLoadBalancer("Svc.Md", [] {
+        return RpcLoadBalancer::New(RpcLoadBalancer::Policy::ConsistentHash);
+    });
+    std::set<RpcEndpoint *> after;
+    for (std::uint64_t key = 0; key < 100; ++key) {
+        after.insert(registry.SelectEndpoint("Svc.Md", {.hash_key = key}).get());
+    }
+    EXPECT_EQ(after, before);
+}
+
+TEST(RpcRegistryTest, SelectedEndpointOutlivesSnapshot) {
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    auto server = std::make_unique<RpcRegistry>(fake.NewClient());
+    ASSERT_EQ(server->RegisterService("Svc.Md", "10.0.0.1:80"), LLBC_OK);
+    auto endpoint = registry.SelectEndpoint("Svc.Md");
+    ASSERT_TRUE(endpoint);
+
+    // the backend's node goes with its session, the endpoint held stays valid
+    server.reset();
+    EXPECT_EQ(registry.SelectEndpoint("Svc.Md"), nullptr);
+    EXPECT_EQ(endpoint->ip, "10.0.0.1");
+    EXPECT_EQ(endpoint->port, 80);
+}
+
+TEST(RpcRegistryTest, RegisterServicesLayout) {
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    ASSERT_EQ(registry.RegisterServices({"Svc.A", "Svc.B"}, "10.0.0.1:80", 3, "host"),
+              LLBC_OK);
+    EXPECT_EQ(fake.RoundTrips(), 1u);
+    using Nodes = std::vector<std::string>;
+    EXPECT_EQ(fake.Children(""), (Nodes{"Svc.A", "Svc.B"}));
+    EXPECT_EQ(fake.Children("/Svc.A"), Nodes{"10.0.0.1:80@3+host"});
+    EXPECT_EQ(fake.Children("/Svc.B"), Nodes{"10.0.0.1:80@3+host"});
+
+    // a second backend joins the existing method nodes
+    ASSERT_EQ(registry.RegisterServices({"Svc.A"}, "10.0.0.2:80"), LLBC_OK);
+    EXPECT_EQ(fake.Children("/Svc.A"), (Nodes{"10.0.0.1:80@3+host", "10.0.0.2:80"}));
+}
+
+TEST(RpcRegistryTest, WatchReusesEndpoints) {
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    RpcRegistry first(fake.NewClient());
+    ASSERT_EQ(first.RegisterService("Svc.Md", "10.0.0.1:80"), LLBC_OK);
+    auto endpoint = registry.SelectEndpoint("Svc.Md");
+    ASSERT_TRUE(endpoint);
+
+    // the watch publishes a snapshot with both, keeping the endpoint known
+    RpcRegistry second(fake.NewClient());
+    ASSERT_EQ(second.RegisterService("Svc.Md", "10.0.0.2:80"), LLBC_OK);
+    std::set<RpcEndpoint *> selected;
+    for (int i = 0; i < 2; ++i) selected.insert(registry.SelectEndpoint("Svc.Md").get());
+    ASSERT_EQ(selected.size(), 2u);
+    EXPECT_TRUE(selected.count(endpoint.get()));
+}
+
+TEST(RpcRegistryTest, EphemeralsRemovedOnDisconnect) {
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    RpcRegistry stays(fake.NewClient());
+    ASSERT_EQ(stays.RegisterService("Svc.Md", "10.0.0.1:80"), LLBC_OK);
+    auto leaves = std::make_unique<RpcRegistry>(fake.NewClient());
+    ASSERT_EQ(leaves->RegisterServices({"Svc.Md", "Svc.Other"}, "10.0.0.2:80"), LLBC_OK);
+    auto endpoint = registry.SelectEndpoint("Svc.Md");
+    ASSERT_TRUE(endpoint);
+
+    // its backends go with the session, the method nodes stay
+    leaves.reset();
+    using Nodes = std::vector<std::string>;
+    EXPECT_EQ(fake.Children("/Svc.Md"), Nodes{"10.0.0.1:80"});
+    EXPECT_EQ(fake.Children("/Svc.Other"), Nodes{});
+    EXPECT_EQ(fake.Children(""), (Nodes{"Svc.Md", "Svc.Other"}));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(registry.SelectEndpoint("Svc.Md")->ip, "10.0.0.1");
+    }
+}
+
+TEST(RpcRegistryTest, UnixPathRoundTrip) {
+    const std::string paths[] = {
+        "/tmp/rpc.sock",
+        "/tmp/a%b@c+d:e.sock",  // every delimiter of a node name
+        "relative/%41",         // an escape in the path stays as it is
+    };
+    RpcFakeRegistry fake;
+    RpcRegistry registry(fake.NewClient());
+    for (const auto &path : paths) {
+        auto addr = "unix:" + path;
+        auto svc_md = "Svc.Unix" + std::to_string(&path - paths);
+        ASSERT_EQ(registry.RegisterService(svc_md, addr, 2, "host"), LLBC_OK) << path;
+        auto children = fake.Children("/" + svc_md);
+        ASSERT_EQ(children.size(), 1u);
+        EXPECT_EQ(children[0].find('/'), std::string::npos) << children[0];
+        auto endpoint = RpcRegistry::ParseEndpoint(children[0]);
+        ASSERT_TRUE(endpoint) << children[0];
+        EXPECT_EQ(endpoint->ip, addr);
+        EXPECT_EQ(endpoint->weight, 2u);
+        EXPECT_EQ(endpoint->host, "host");
+    }
+}
+
+TEST(RpcRegistryTest, ParseUnix) {
+    struct Case {
+        std::string name;
+        std::string ip;  // empty if the name is malformed
+        std::uint32_t weight;
+        std::string host;
+    };
+    const Case cases[] = {
+        {"unix:%2Ftmp%2Fs", "unix:/tmp/s", 1, ""},
+        {"unix:%2Ftmp%2Fs@3", "unix:/tmp/s", 3, ""},
+        {"unix:%2Ftmp%2Fs+host", "unix:/tmp/s", 1, "host"},
+        {"unix:%2Ftmp%2Fs@3+host", "unix:/tmp/s", 3, "host"},
+        {"unix:%2Ftmp%2Fs@500+host", "unix:/tmp/s", RpcRegistry::MAX_WEIGHT, "host"},
+        {"unix:s%40%2B%3A%25", "unix:s@+:%", 1, ""},
+        {"unix:%2Ftmp%2Fs@0", "", 0, ""},
+        {"unix:%2Ftmp%2Fs+", "", 0, ""},
+        {"unix:", "", 0, ""},
+        {"unix:@3", "", 0, ""},
+        {"unix:%", "", 0, ""},
+        {"unix:s%2", "", 0, ""},   // cut short
+        {"unix:s%2f", "", 0, ""},  // lower case
+        {"unix:s%G0", "", 0, ""},
+        {"unix:s%0G", "", 0, ""},
+    };
+    for (const auto &c : cases) {
+        auto endpoint = RpcRegistry::ParseEndpoint(c.name);
+        ASSERT_EQ(endpoint != nullptr, !c.ip.empty()) << c.name;
+        if (!endpoint) continue;
+        EXPECT_EQ(endpoint->ip, c.ip) << c.name;
+        EXPECT_EQ(endpoint->port, 0) << c.name;
+        EXPECT_EQ(endpoint->weight, c.weight) << c.name;
+        EXPECT_EQ(endpoint->host, c.host) << c.name;
+    }
+}
+
+TEST(RpcRegistryTest, FakeSessionEnds) {
+    auto fake = std::make_unique<RpcFakeRegistry>();
+    auto writer = fake->NewClient();
+    int calls = 0;
+    {
+        auto watcher = fake->NewClient();
+        std::vector<std::string> children;
+        ASSERT_EQ(writer->CreateNodes({{"/Svc.Md", false}}), LLBC_OK);
+        ASSERT_EQ(watcher->WatchChildren(
+                      "/Svc.Md", [&calls](const auto &) { ++calls; }, children),
+                  LLBC_OK);
+        ASSERT_EQ(writer->CreateNodes({{"/Svc.Md/10.0.0.1:80", true}}), LLBC_OK);
+        EXPECT_EQ(calls, 1);
+    }
+    // the watch went with its client
+    ASSERT_EQ(writer->CreateNodes({{"/Svc.Md/10.0.0.2:80", true}}), LLBC_OK);
+    EXPECT_EQ(calls, 1);
+
+    // a client outliving its registry fails instead of touching it
+    fake.reset();
+    std::vector<std::string> children;
+    EXPECT_EQ(writer->CreateNodes({{"/Svc.Md/10.0.0.3:80", true}}), LLBC_FAILED);
+    EXPECT_EQ(writer->WatchChildren("/Svc.Md", [](const auto &) {}, children),
+              LLBC_FAILED);
+}
@@ -0,0 +1,60 @@
+#include "rpc_service_mgr.h"
+
+#include <gtest/gtest.h>
+
+#include "rpc_conn_mgr.h"
+#include "rpc_fake_registry.h"
+#include "rpc_shm_transport.h"
+#include "rpc_stats_service.h"
+#include "rpc_test_util.h"
+
+// RpcServiceMgr is a singleton holding its registry client until the next Init(), so the
+// fake registry outlives every test
+static RpcFakeRegistry &Registry() {
+    static auto *registry = new RpcFakeRegistry;
+    return *registry;
+}
+
+class RpcServiceMgrTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        ASSERT_EQ(RpcConnMgr::GetInst().Init(), LLBC_OK);
+        ASSERT_EQ(RpcServiceMgr::GetInst().Init(&RpcConnMgr::GetInst(), 1,
+                                                Registry().NewClient()),
+                  LLBC_OK);
+    }
+    void TearDown() override { RpcConnMgr::GetInst().Destroy(); }
+};
+
+TEST_F(RpcServiceMgrTest, RegistersWithWeight) {
+    auto addr = "unix:" + SocketPath("weight");
+    ASSERT_EQ(RpcConnMgr::GetInst().StartRpcService(addr.c_str(), 0), LLBC_OK);
+    auto &mgr = RpcServiceMgr::GetInst();
+    mgr.SetWeight(7);
+    ASSERT_EQ(mgr.AddService(&RpcStatsService::GetInst()), LLBC_OK);
+    mgr.SetWeight(1);
+
+    auto children = Registry().Children("/RpcStatsService.GetStats");
+    ASSERT_EQ(children.size(), 1);
+    auto endpoint = RpcRegistry::ParseEndpoint(children[0]);
+    ASSERT_NE(endpoint, nullptr);
+    EXPECT_EQ(endpoint->ip, addr);
+    EXPECT_EQ(endpoint->weight, 7);
+    EXPECT_EQ(endpoint->host, RpcShmTransport::HostID());
+}
+
+TEST_F(RpcServiceMgrTest, UnixSocketOfAnotherHost) {
+    ShmPeer peer(SocketPath("cross"));
+    auto addr = "unix:" + SocketPath("cross");
+    RpcRegistry backends(Registry().NewClient());
+    ASSERT_EQ(backends.RegisterService("Cross.Other", addr, 1, "other-host"), LLBC_OK);
+    ASSERT_EQ(backends.RegisterService("Cross.Unknown", addr), LLBC_OK);
+    ASSERT_EQ(backends.RegisterService("Cross.Local", addr, 1, RpcShmTransport::HostID()),
+              LLBC_OK);
+
+    // the path names a socket on the backend's host, which is not this one
+    auto &mgr = RpcServiceMgr::GetInst();
+    EXPECT_EQ(mgr.RegisterRpcChannel("Cross.Other"), nullptr);
+    EXPECT_EQ(mgr.RegisterRpcChannel("Cross.Unknown"), nullptr);
+    EXPECT_NE(mgr.RegisterRpcChannel("Cross.Local"), nullptr);
+}
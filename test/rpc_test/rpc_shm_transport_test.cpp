@@ -0,0 +1,94 @@
+#include "rpc_shm_transport.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "rpc_channel.h"
+#include "rpc_test_util.h"
+
+// wait for the poller to see the link closed, for at most a second
+static bool WaitClosed(RpcShmTransport &transport, int sessionID) {
+    for (int i = 0; i < 1000 && transport.IsOpen(sessionID); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return !transport.IsOpen(sessionID);
+}
+
+static llbc::LLBC_Packet *NewRequest(int sessionID, std::uint64_t seq) {
+    auto *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    packet->SetHeader(sessionID, RpcChannel::RpcReq, LLBC_OK);
+    RpcChannel::PkgHead head;
+    head.seq = seq;
+    head.ToPacket(*packet);
+    return packet;
+}
+
+TEST(RpcShmTransportTest, SendToKilledPeer) {
+    auto path = SocketPath("killed");
+    auto peer = std::make_unique<ShmPeer>(path, false);
+    RpcShmTransport client([](llbc::LLBC_Packet *packet) {
+        LLBC_Recycle(packet);
+        return true;
+    });
+    auto sessionID = client.ConnectPath(path);
+    ASSERT_NE(sessionID, 0);
+    EXPECT_TRUE(client.IsOpen(sessionID));
+    ASSERT_EQ(client.Send(NewRequest(sessionID, 1)), LLBC_OK);
+    ASSERT_TRUE(peer->WaitRequests(1));
+
+    peer.reset();
+    ASSERT_TRUE(WaitClosed(client, sessionID));
+
+    // the failed send leaves the packet to the caller, untouched
+    auto *packet = NewRequest(sessionID, 2);
+    EXPECT_EQ(client.Send(packet), LLBC_FAILED);
+    EXPECT_EQ(packet->GetSessionId(), sessionID);
+    EXPECT_EQ(packet->GetPayloadLength(), RpcChannel::PkgHead::SIZE);
+    LLBC_Recycle(packet);
+}
+
+TEST(RpcShmTransportTest, SendTooLarge) {
+    auto path = SocketPath("large");
+    ShmPeer peer(path, false);
+    RpcShmTransport client([](llbc::LLBC_Packet *packet) {
+        LLBC_Recycle(packet);
+        return true;
+    });
+    auto sessionID = client.ConnectPath(path);
+    ASSERT_NE(sessionID, 0);
+
+    auto *packet = NewRequest(sessionID, 1);
+    std::string body(RpcShmTransport::RING_BYTES, 'x');
+    packet->Write(body.data(), body.size());
+    EXPECT_EQ(client.Send(packet), LLBC_FAILED);
+    EXPECT_EQ(packet->GetSessionId(), sessionID);
+    LLBC_Recycle(packet);
+    EXPECT_TRUE(client.IsOpen(sessionID));
+}
+
+TEST(RpcShmTransportTest, BacklogFull) {
+    // a server that takes no packet, so its ring fills and then the backlog
+    auto path = SocketPath("backlog");
+    RpcShmTransport server([](llbc::LLBC_Packet *) { return false; });
+    ASSERT_EQ(server.ListenPath(path), LLBC_OK);
+    RpcShmTransport client([](llbc::LLBC_Packet *packet) {
+        LLBC_Recycle(packet);
+        return true;
+    });
+    auto sessionID = client.ConnectPath(path);
+    ASSERT_NE(sessionID, 0);
+
+    std::size_t sent = 0;
+    int ret = LLBC_OK;
+    auto *packet = NewRequest(sessionID, 1);
+    for (; (ret = client.Send(packet)) == LLBC_OK; ++sent) {
+        packet = NewRequest(sessionID, sent + 2);
+    }
+    EXPECT_EQ(ret, RpcChannel::RpcOverloaded);
+    EXPECT_GT(sent, RpcShmTransport::MAX_BACKLOG);
+    EXPECT_EQ(packet->GetSessionId(), sessionID);
+    LLBC_Recycle(packet);
+    EXPECT_TRUE(client.IsOpen(sessionID));
+}
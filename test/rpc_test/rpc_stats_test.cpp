@@ -0,0 +1,117 @@
+#include "rpc_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+TEST(RpcHistogramTest, Buckets) {
+    struct Case {
+        std::uint64_t value;
+        std::size_t bucket;
+        std::uint64_t upper_bound;
+    };
+    const Case cases[] = {
+        {0, 0, 0},
+        {15, 15, 15},  // exact below 2^SUB_BITS
+        {16, 16, 16},
+        {31, 31, 31},  // and in the first octave
+        {32, 32, 33},  // then 2 values a bucket
+        {33, 32, 33},
+        {34, 33, 35},
+        {63, 47, 63},
+        {64, 48, 67},  // 4 values a bucket
+        {100, 57, 103},
+        {1000, 111, 1023},
+        {1024, 112, 1087},
+        {(1ULL << 32) - 1, RpcHistogram::BUCKETS - 1, (1ULL << 32) - 1},
+        {1ULL << 32, RpcHistogram::BUCKETS - 1, (1ULL << 32) - 1},  // clamped
+        {~0ULL, RpcHistogram::BUCKETS - 1, (1ULL << 32) - 1},
+    };
+    for (const auto &c : cases) {
+        EXPECT_EQ(RpcHistogram::BucketOf(c.value), c.bucket) << c.value;
+        EXPECT_EQ(RpcHistogram::UpperBoundOf(c.bucket), c.upper_bound) << c.value;
+    }
+}
+
+TEST(RpcHistogramTest, BucketsTileTheRange) {
+    // every bucket starts right after the one below, and is at most 1/16 of its values
+    std::uint64_t lower = 0;
+    for (std::size_t bucket = 0; bucket < RpcHistogram::BUCKETS; ++bucket) {
+        auto upper = RpcHistogram::UpperBoundOf(bucket);
+        ASSERT_GE(upper, lower) << bucket;
+        EXPECT_EQ(RpcHistogram::BucketOf(lower), bucket);
+        EXPECT_EQ(RpcHistogram::BucketOf(upper), bucket);
+        EXPECT_LE((upper - lower) << RpcHistogram::SUB_BITS, lower) << bucket;
+        lower = upper + 1;
+    }
+    EXPECT_EQ(lower, 1ULL << RpcHistogram::MAX_BITS);
+}
+
+TEST(RpcHistogramTest, Quantile) {
+    RpcHistogram histogram;
+    EXPECT_EQ(histogram.Quantile(0.5), 0u);
+    for (std::uint64_t value = 1; value <= 100; ++value) histogram.Record(value);
+    EXPECT_EQ(histogram.Count(), 100u);
+    EXPECT_EQ(histogram.Quantile(0), 1u);
+    EXPECT_EQ(histogram.Quantile(0.5), 51u);  // 50's bucket is [50, 51]
+    EXPECT_EQ(histogram.Quantile(0.99), 99u);
+    EXPECT_EQ(histogram.Quantile(1), 103u);  // 100's bucket is [100, 103]
+
+    RpcHistogram one;
+    one.Record(7);
+    for (double q : {0.0, 0.5, 1.0}) EXPECT_EQ(one.Quantile(q), 7u) << q;
+}
+
+TEST(RpcHistogramTest, Merge) {
+    RpcHistogram low, high, all;
+    for (std::uint64_t value = 0; value < 50; ++value) low.Record(value);
+    for (std::uint64_t value = 1000; value < 1050; ++value) high.Record(value);
+    all.Merge(low);
+    all.Merge(high);
+    EXPECT_EQ(all.Count(), 100u);
+    EXPECT_EQ(all.Quantile(0.5), low.Quantile(1));
+    EXPECT_EQ(all.Quantile(1), high.Quantile(1));
+}
+
+TEST(RpcMethodStatsTest, MergesShards) {
+    constexpr int THREADS = 4, CALLS = 1000;
+    RpcMethodStats stats(1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        // thread t takes t * 1000us, every 10th call fails
+        threads.emplace_back([&stats, t] {
+            for (int i = 0; i < CALLS; ++i) {
+                stats.Begin(t);
+                stats.End(t * 1000, i % 10 == 0);
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    stats.Begin();  // one still in flight
+
+    RpcMethodStats::Snapshot snap;
+    stats.Collect(snap);
+    EXPECT_EQ(snap.requests, THREADS * CALLS + 1u);
+    EXPECT_EQ(snap.errors, THREADS * CALLS / 10u);
+    EXPECT_EQ(snap.inflight, 1u);
+    EXPECT_EQ(snap.queue_us.Count(), THREADS * CALLS + 0u);
+    EXPECT_EQ(snap.time_us.Count(), THREADS * CALLS + 0u);
+    EXPECT_EQ(snap.time_us.Quantile(0), 0u);
+    EXPECT_EQ(snap.time_us.Quantile(0.5), RpcHistogram::UpperBoundOf(
+                                              RpcHistogram::BucketOf(1000)));
+    EXPECT_EQ(snap.time_us.Quantile(1), RpcHistogram::UpperBoundOf(
+                                            RpcHistogram::BucketOf(3000)));
+    EXPECT_EQ(snap.queue_us.Quantile(1), 3u);
+}
+
+TEST(RpcMethodStatsTest, EndOnAnotherThread) {
+    RpcMethodStats stats(1);
+    stats.Begin();
+    std::thread([&stats] { stats.End(5, false); }).join();
+    RpcMethodStats::Snapshot snap;
+    stats.Collect(snap);
+    EXPECT_EQ(snap.requests, 1u);
+    EXPECT_EQ(snap.inflight, 0u);
+    EXPECT_EQ(snap.time_us.Quantile(1), 5u);
+}
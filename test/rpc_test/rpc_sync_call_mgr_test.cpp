@@ -0,0 +1,108 @@
+#include "rpc_sync_call_mgr.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "rpc_channel.h"
+#include "rpc_conn_comp.h"
+
+// slot index of a seq, without its generation
+static std::uint32_t SlotOf(RpcSyncCallMgr::seq_type seq) {
+    return static_cast<std::uint32_t>(seq);
+}
+
+static llbc::LLBC_Packet *NewResponse(RpcSyncCallMgr::seq_type seq) {
+    auto *packet = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+    packet->SetHeader(1, RpcChannel::RpcRsp, LLBC_OK);
+    RpcChannel::PkgHead head;
+    head.seq = seq;
+    head.ToPacket(*packet);
+    return packet;
+}
+
+TEST(RpcSyncCallMgrTest, Complete) {
+    auto &mgr = RpcSyncCallMgr::GetInst();
+    auto seq = mgr.Acquire();
+    ASSERT_NE(seq, 0);
+    EXPECT_TRUE(RpcSyncCallMgr::IsSyncSeq(seq));
+
+    auto *packet = NewResponse(seq);
+    EXPECT_TRUE(mgr.Complete(seq, packet));
+    // a duplicate response is refused
+    auto *duplicate = NewResponse(seq);
+    EXPECT_FALSE(mgr.Complete(seq, duplicate));
+    LLBC_Recycle(duplicate);
+
+    EXPECT_EQ(mgr.Wait(seq, 0), packet);
+    LLBC_Recycle(packet);
+}
+
+TEST(RpcSyncCallMgrTest, SlotReusedAfterTimeout) {
+    auto &mgr = RpcSyncCallMgr::GetInst();
+    auto seq = mgr.Acquire();
+    ASSERT_NE(seq, 0);
+    EXPECT_EQ(mgr.Wait(seq, 1), nullptr);
+
+    // the slot is taken again under a new generation
+    auto next = mgr.Acquire();
+    EXPECT_EQ(SlotOf(next), SlotOf(seq));
+    EXPECT_NE(next, seq);
+    mgr.Release(next);
+}
+
+TEST(RpcSyncCallMgrTest, StaleSeq) {
+    auto &mgr = RpcSyncCallMgr::GetInst();
+    auto seq = mgr.Acquire();
+    ASSERT_NE(seq, 0);
+    EXPECT_EQ(mgr.Wait(seq, 1), nullptr);
+    auto next = mgr.Acquire();
+    ASSERT_EQ(SlotOf(next), SlotOf(seq));
+
+    // the timed-out call neither gets the slot's response nor frees the slot
+    auto *late = NewResponse(seq);
+    EXPECT_FALSE(mgr.Complete(seq, late));
+    LLBC_Recycle(late);
+    mgr.Release(seq);
+    EXPECT_EQ(mgr.Wait(seq, 0), nullptr);
+
+    auto *packet = NewResponse(next);
+    EXPECT_TRUE(mgr.Complete(next, packet));
+    EXPECT_EQ(mgr.Wait(next, 0), packet);
+    LLBC_Recycle(packet);
+}
+
+TEST(RpcSyncCallMgrTest, LateResponseRecycled) {
+    auto &mgr = RpcSyncCallMgr::GetInst();
+    RpcConnComp comp(1);
+    auto seq = mgr.Acquire();
+    ASSERT_NE(seq, 0);
+    EXPECT_EQ(mgr.Wait(seq, 1), nullptr);
+    auto next = mgr.Acquire();
+    ASSERT_EQ(SlotOf(next), SlotOf(seq));
+
+    // taken and dropped, neither queued to a reactor nor handed to the slot's new call
+    EXPECT_TRUE(comp.DeliverShm(NewResponse(seq)));
+    EXPECT_EQ(comp.GetQueueStats(0).recvDepth, 0);
+    EXPECT_EQ(mgr.Wait(next, 1), nullptr);
+}
+
+TEST(RpcSyncCallMgrTest, MaxPending) {
+    auto &mgr = RpcSyncCallMgr::GetInst();
+    std::vector<RpcSyncCallMgr::seq_type> seqs;
+    for (std::uint32_t i = 0; i < RpcSyncCallMgr::MAX_PENDING; ++i) {
+        seqs.push_back(mgr.Acquire());
+        ASSERT_NE(seqs.back(), 0);
+    }
+    EXPECT_EQ(mgr.Acquire(), 0);
+
+    mgr.Release(seqs.back());
+    seqs.back() = mgr.Acquire();
+    EXPECT_NE(seqs.back(), 0);
+    EXPECT_EQ(mgr.Acquire(), 0);
+
+    for (auto seq : seqs) mgr.Release(seq);
+    auto seq = mgr.Acquire();
+    EXPECT_NE(seq, 0);
+    mgr.Release(seq);
+}
@@ -0,0 +1,104 @@
+#ifndef _RPC_TEST_UTIL_H
+#define _RPC_TEST_UTIL_H
+
+#include <google/protobuf/wrappers.pb.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rpc_channel.h"
+#include "rpc_controller.h"
+#include "rpc_coro.h"
+#include "rpc_coro_mgr.h"
+#include "rpc_shm_transport.h"
+#include "rpc_stats_service.h"
+
+// socket path of a test, unique to the process
+inline std::string SocketPath(const std::string &name) {
+    return "/tmp/rpc_test_" + std::to_string(getpid()) + "_" + name + ".sock";
+}
+
+// Stands in for a server at a unix socket path: records the seq of every request and,
+// if echo is set, answers it with an empty response.
+class ShmPeer {
+   public:
+    explicit ShmPeer(const std::string &path, bool echo = true)
+        : echo_(echo),
+          transport_(std::make_unique<RpcShmTransport>(
+              [this](llbc::LLBC_Packet *packet) { return OnPacket(packet); })) {
+        transport_->ListenPath(path);
+    }
+
+    std::vector<std::uint64_t> Seqs() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return seqs_;
+    }
+
+    // wait until n requests arrived, for at most a second
+    bool WaitRequests(std::size_t n) {
+        for (int i = 0; i < 1000; ++i) {
+            if (Seqs().size() >= n) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+   private:
+    bool OnPacket(llbc::LLBC_Packet *packet) {
+        RpcChannel::PkgHead head;
+        if (head.FromPacket(*packet) == LLBC_OK) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            seqs_.push_back(head.seq);
+        }
+        if (echo_) {
+            auto *rsp = llbc::LLBC_GetObjectFromSafetyPool<llbc::LLBC_Packet>();
+            rsp->SetHeader(packet->GetSessionId(), RpcChannel::RpcRsp, LLBC_OK);
+            head.body_len = 0;
+            head.ToPacket(*rsp);
+            if (transport_->Send(rsp) != LLBC_OK) LLBC_Recycle(rsp);
+        }
+        LLBC_Recycle(packet);
+        return true;
+    }
+
+    bool echo_;
+    std::mutex mutex_;
+    std::vector<std::uint64_t> seqs_;
+    std::unique_ptr<RpcShmTransport> transport_;
+};
+
+// Coroutine calls nobody answers, in flight until Expire().
+class PendingCalls {
+   public:
+    void Start(RpcChannel *channel) {
+        auto cntl = RpcController::New(true);
+        cntl->SetTimeout(100);
+        Hold(channel->Call(RpcStatsService::GetStatsMethod(), cntl.get(), &req_, &rsp_));
+        cntls_.push_back(std::move(cntl));
+    }
+
+    // time the calls out
+    void Expire() {
+        auto &coroMgr = RpcCoroMgr::GetInst();
+        for (int i = 0; i < 100 && coroMgr.SuspendedCount() > 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            coroMgr.HandleCoroTimeout();
+        }
+        EXPECT_EQ(coroMgr.SuspendedCount(), 0);
+        cntls_.clear();
+    }
+
+   private:
+    static RpcCoro Hold(RpcChannel::CallAwaiter call) { co_await call; }
+
+    std::vector<RpcController::Ptr> cntls_;
+    ::google::protobuf::StringValue req_, rsp_;
+};
+
+#endif  // _RPC_TEST_UTIL_H